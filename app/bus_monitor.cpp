@@ -0,0 +1,159 @@
+// Copyright 2024 Khalil Estell
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <algorithm>
+
+#include <app/bus_monitor.hpp>
+
+namespace {
+controller_state state_of(can_error_state const& p_counters)
+{
+  auto const highest =
+    std::max(p_counters.transmit_errors, p_counters.receive_errors);
+  if (p_counters.bus_off) {
+    return controller_state::bus_off;
+  }
+  if (highest >= bus_monitor::passive_limit) {
+    return controller_state::error_passive;
+  }
+  if (highest >= bus_monitor::warning_limit) {
+    return controller_state::error_warning;
+  }
+  return controller_state::error_active;
+}
+}  // namespace
+
+bool bus_monitor::update(std::optional<can_error_state> const& p_state)
+{
+  bool entered_bus_off = false;
+
+  if (p_state) {
+    // The first reading has nothing to compare the counters with
+    if (m_readable and
+        p_state->arbitration_losses != m_counters.arbitration_losses) {
+      m_flags |= arbitration_lost_flag;
+    }
+    if (m_readable and p_state->bus_errors != m_counters.bus_errors) {
+      m_flags |= bus_error_flag;
+    }
+    if (not m_readable) {
+      m_reported = *p_state;
+    }
+    m_counters = *p_state;
+    m_readable = true;
+    entered_bus_off = enter(state_of(*p_state)) and
+                      m_state == controller_state::bus_off;
+  }
+
+  // The interrupt catches a bus off that came and went between two readings
+  auto const bus_off_count = m_bus_off_count.value();
+  if (bus_off_count != m_bus_off_seen) {
+    m_bus_off_seen = bus_off_count;
+    enter(controller_state::bus_off);
+    entered_bus_off = true;
+  }
+
+  return entered_bus_off;
+}
+
+void bus_monitor::recovering()
+{
+  if (not m_readable) {
+    enter(controller_state::error_active);
+  }
+}
+
+hal::u8 bus_monitor::take_flags()
+{
+  auto const flags = m_flags;
+  m_flags = 0;
+  return flags;
+}
+
+void bus_monitor::restart_events(hal::u32 p_milliseconds)
+{
+  m_reported = m_counters;
+  m_last_event = p_milliseconds;
+  m_state_changed = false;
+  m_bus_off_unreported = false;
+}
+
+std::optional<error_event> bus_monitor::take_event(hal::u32 p_milliseconds,
+                                                   hal::u32 p_interval)
+{
+  // Unsigned subtraction keeps working when the counters wrap around
+  auto const arbitration_losses =
+    m_counters.arbitration_losses - m_reported.arbitration_losses;
+  auto const bus_errors = m_counters.bus_errors - m_reported.bus_errors;
+  bool const counters_moved =
+    arbitration_losses != 0 or bus_errors != 0 or
+    m_counters.transmit_errors != m_reported.transmit_errors or
+    m_counters.receive_errors != m_reported.receive_errors;
+  bool const interval_passed = (p_milliseconds - m_last_event) >= p_interval;
+
+  if (not m_state_changed and not(counters_moved and interval_passed)) {
+    return std::nullopt;
+  }
+
+  auto state = m_state;
+  m_state_changed = false;
+  if (m_bus_off_unreported) {
+    // Report the bus off first, a state it has left since is reported next
+    state = controller_state::bus_off;
+    m_state_changed = m_state != controller_state::bus_off;
+    m_bus_off_unreported = false;
+  }
+  m_reported = m_counters;
+  m_last_event = p_milliseconds;
+  return error_event{
+    .state = state,
+    .transmit_errors = m_counters.transmit_errors,
+    .receive_errors = m_counters.receive_errors,
+    .arbitration_losses = arbitration_losses,
+    .bus_errors = bus_errors,
+  };
+}
+
+bool bus_monitor::enter(controller_state p_state)
+{
+  if (p_state == m_state) {
+    return false;
+  }
+
+  // The SJA1000 error status bit is set from error warning on, its bus status
+  // bit only while bus off
+  auto const error_status = [](controller_state p_of) {
+    return p_of != controller_state::error_active;
+  };
+  auto const bus_status = [](controller_state p_of) {
+    return p_of == controller_state::bus_off;
+  };
+
+  if (error_status(p_state) != error_status(m_state) or
+      bus_status(p_state) != bus_status(m_state)) {
+    m_flags |= error_warning_flag;
+  }
+  if (p_state == controller_state::error_passive or
+      (m_state == controller_state::error_passive and
+       p_state != controller_state::bus_off)) {
+    m_flags |= error_passive_flag;
+  }
+
+  m_state = p_state;
+  m_state_changed = true;
+  if (p_state == controller_state::bus_off) {
+    m_bus_off_unreported = true;
+  }
+  return true;
+}
@@ -0,0 +1,87 @@
+// Copyright 2024 Khalil Estell
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <algorithm>
+#include <bit>
+
+#include <app/change_filter.hpp>
+
+namespace {
+constexpr hal::u32 extended_key_bit = 1U << 31;
+}  // namespace
+
+bool change_filter::should_forward(hal::can_message const& p_message,
+                                   hal::u32 p_milliseconds)
+{
+  if (p_message.remote_request()) {
+    return true;
+  }
+
+  // Standard and extended frames with the same ID are different frames
+  auto const key =
+    p_message.id() | (p_message.extended() ? extended_key_bit : 0);
+  auto const length =
+    std::min<std::size_t>(p_message.length, p_message.payload.size());
+
+  // Fibonacci hashing, the top bits of the product are the best mixed
+  constexpr auto slot_bits = std::countr_zero(capacity);
+  std::size_t slot = (key * 0x9E37'79B1U) >> (32 - slot_bits);
+
+  for (std::size_t i = 0; i < max_probes; i++) {
+    auto& entry = m_entries[slot];
+
+    if (entry.key == empty_key) {
+      entry.key = key;
+      entry.forwarded_at = p_milliseconds;
+      entry.length = length;
+      std::copy_n(p_message.payload.begin(), length, entry.payload.begin());
+      return true;
+    }
+
+    if (entry.key == key) {
+      bool const changed =
+        entry.length != length or
+        not std::equal(p_message.payload.begin(),
+                       p_message.payload.begin() + length,
+                       entry.payload.begin());
+      // Unsigned subtraction keeps working when the time wraps around
+      bool const expired =
+        m_keep_alive != 0 and
+        (p_milliseconds - entry.forwarded_at) >= m_keep_alive;
+
+      if (not changed and not expired) {
+        m_suppressed++;
+        return false;
+      }
+
+      entry.forwarded_at = p_milliseconds;
+      entry.length = length;
+      std::copy_n(p_message.payload.begin(), length, entry.payload.begin());
+      return true;
+    }
+
+    slot = (slot + 1) % capacity;
+  }
+
+  m_untracked++;
+  return true;
+}
+
+void change_filter::reset(hal::u32 p_keep_alive)
+{
+  m_entries.fill(entry{});
+  m_keep_alive = p_keep_alive;
+  m_suppressed = 0;
+  m_untracked = 0;
+}
@@ -0,0 +1,98 @@
+// Copyright 2024 Khalil Estell
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <algorithm>
+#include <cstring>
+
+#include <app/command_parser.hpp>
+
+command_parser::command_parser(std::span<hal::byte> p_partial_buffer)
+  : m_buffer(p_partial_buffer)
+{
+}
+
+void command_parser::feed(std::span<hal::byte const> p_data)
+{
+  m_input = p_data;
+}
+
+bool command_parser::pending() const
+{
+  return not m_input.empty();
+}
+
+std::optional<std::span<hal::byte const>> command_parser::next()
+{
+  if (m_input.empty()) {
+    return std::nullopt;
+  }
+
+  auto const* terminator = static_cast<hal::byte const*>(
+    std::memchr(m_input.data(), '\r', m_input.size()));
+
+  if (terminator == nullptr) {
+    // Nothing complete left in this chunk, keep the start of the command for
+    // the next chunk.
+    store_partial(m_input);
+    m_input = {};
+    return std::nullopt;
+  }
+
+  // (+ 1) to include the '\r' character
+  std::size_t const length = (terminator - m_input.data()) + 1;
+  auto const tail = m_input.first(length);
+  m_input = m_input.subspan(length);
+
+  if (m_overflowed) {
+    m_overflowed = false;
+    m_length = 0;
+    return std::span<hal::byte const>{};
+  }
+
+  // Fast path, the whole command arrived in this chunk. Apply the same length
+  // limit as commands split across chunks.
+  if (m_length == 0) {
+    if (tail.size() > m_buffer.size()) {
+      return std::span<hal::byte const>{};
+    }
+    return tail;
+  }
+
+  store_partial(tail);
+  if (m_overflowed) {
+    m_overflowed = false;
+    m_length = 0;
+    return std::span<hal::byte const>{};
+  }
+
+  auto const command = std::span<hal::byte const>(m_buffer.first(m_length));
+  m_length = 0;
+  return command;
+}
+
+void command_parser::store_partial(std::span<hal::byte const> p_data)
+{
+  if (m_overflowed) {
+    return;
+  }
+
+  if (m_length + p_data.size() > m_buffer.size()) {
+    m_overflowed = true;
+    m_length = 0;
+    return;
+  }
+
+  std::ranges::copy(p_data, m_buffer.subspan(m_length).begin());
+  m_length += p_data.size();
+}
@@ -0,0 +1,116 @@
+// Copyright 2024 Khalil Estell
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <algorithm>
+#include <utility>
+
+#include <libhal-util/serial.hpp>
+#include <libhal-util/timeout.hpp>
+
+#include <app/console_writer.hpp>
+
+console_writer::console_writer(
+  hal::serial& p_console,
+  std::span<hal::byte> p_buffer,
+  std::optional<nonblocking_write> p_nonblocking_write)
+  : m_console(&p_console)
+  , m_buffer(p_buffer)
+  , m_nonblocking_write(std::move(p_nonblocking_write))
+{
+}
+
+bool console_writer::try_write(std::span<hal::byte const> p_data)
+{
+  if (p_data.size() > free_space()) {
+    return false;
+  }
+  push(p_data);
+  return true;
+}
+
+void console_writer::write(std::span<hal::byte const> p_data)
+{
+  // Too large to ever fit, keep ordering by emptying the buffer first
+  if (p_data.size() > m_buffer.size()) {
+    flush();
+    hal::write(*m_console, p_data, hal::never_timeout());
+    m_bytes_written += p_data.size();
+    return;
+  }
+
+  while (p_data.size() > free_space()) {
+    drain();
+  }
+
+  push(p_data);
+}
+
+void console_writer::drain()
+{
+  // Handle the wrap around by making up to two passes, one per contiguous
+  // region of the ring buffer.
+  for (int region = 0; region < 2 and not empty(); region++) {
+    auto const contiguous = std::min(m_size, m_buffer.size() - m_read_index);
+    auto const pending = m_buffer.subspan(m_read_index, contiguous);
+
+    if (m_nonblocking_write) {
+      auto const accepted = (*m_nonblocking_write)(pending);
+      consume(accepted);
+      if (accepted != pending.size()) {
+        return;
+      }
+    } else {
+      // Each blocking write has a fixed cost on top of the bytes it sends, so
+      // the whole region goes in one call
+      hal::write(*m_console, pending, hal::never_timeout());
+      consume(pending.size());
+    }
+  }
+}
+
+void console_writer::flush()
+{
+  while (not empty()) {
+    drain();
+  }
+}
+
+std::size_t console_writer::free_space() const
+{
+  return m_buffer.size() - m_size;
+}
+
+bool console_writer::empty() const
+{
+  return m_size == 0;
+}
+
+void console_writer::push(std::span<hal::byte const> p_data)
+{
+  auto const write_index = (m_read_index + m_size) % m_buffer.size();
+  auto const first_part =
+    std::min(p_data.size(), m_buffer.size() - write_index);
+
+  std::copy_n(p_data.begin(), first_part, m_buffer.begin() + write_index);
+  std::copy(p_data.begin() + first_part, p_data.end(), m_buffer.begin());
+
+  m_size += p_data.size();
+}
+
+void console_writer::consume(std::size_t p_amount)
+{
+  m_read_index = (m_read_index + p_amount) % m_buffer.size();
+  m_size -= p_amount;
+  m_bytes_written += p_amount;
+}
@@ -0,0 +1,213 @@
+// Copyright 2024 Khalil Estell
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <algorithm>
+
+#include <app/filter_allocator.hpp>
+
+namespace {
+constexpr hal::u32 standard_id_mask = 0x7FF;
+constexpr hal::u32 extended_id_mask = 0x1FFF'FFFF;
+
+bool is_exact(filter_rule const& p_rule)
+{
+  auto const full_mask = p_rule.extended ? extended_id_mask : standard_id_mask;
+  return (p_rule.mask & full_mask) == full_mask;
+}
+
+template<typename MaskFilter>
+void allow_pair(MaskFilter& p_filter, hal::u32 p_id, hal::u32 p_mask)
+{
+  using pair = typename MaskFilter::pair;
+  p_filter.allow(pair{
+    .id = static_cast<decltype(pair::id)>(p_id),
+    .mask = static_cast<decltype(pair::mask)>(p_mask),
+  });
+}
+
+struct width_result
+{
+  std::size_t hardware_rules = 0;
+  std::size_t spilled_rules = 0;
+  /// Spilled rules that could not be covered by a hardware bank
+  bool needs_open_hardware = false;
+};
+
+/**
+ * @brief Place the rules of one frame type onto that frame type's banks
+ *
+ * @tparam Id - ID type taken by the identifier filter
+ */
+template<typename Id, typename IdentifierFilter, typename MaskFilter>
+width_result allocate_width(std::span<filter_rule const> p_rules,
+                            bool p_extended,
+                            std::span<IdentifierFilter* const> p_identifier,
+                            std::span<MaskFilter* const> p_mask)
+{
+  std::size_t exact_count = 0;
+  std::size_t mask_count = 0;
+  for (auto const& rule : p_rules) {
+    if (rule.extended != p_extended) {
+      continue;
+    }
+    if (is_exact(rule)) {
+      exact_count++;
+    } else {
+      mask_count++;
+    }
+  }
+
+  // Decide from the counts alone whether a mask bank has to be kept back for
+  // the rule covering the spilled rules.
+  auto const spill_with = [&](std::size_t p_mask_banks) -> std::size_t {
+    auto const masks_placed = std::min(mask_count, p_mask_banks);
+    auto const exact_placed =
+      std::min(exact_count, p_identifier.size() + p_mask_banks - masks_placed);
+    return (mask_count - masks_placed) + (exact_count - exact_placed);
+  };
+
+  bool const reserve_cover =
+    spill_with(p_mask.size()) != 0 and not p_mask.empty();
+  auto const usable_mask_banks = p_mask.size() - (reserve_cover ? 1 : 0);
+
+  width_result result{};
+  std::size_t identifier_used = 0;
+  std::size_t mask_used = 0;
+  hal::u32 cover_id = 0;
+  hal::u32 cover_mask = p_extended ? extended_id_mask : standard_id_mask;
+  bool cover_started = false;
+
+  auto const spill = [&](filter_rule const& p_rule) {
+    result.spilled_rules++;
+    if (not cover_started) {
+      cover_id = p_rule.id;
+      cover_mask &= p_rule.mask;
+      cover_started = true;
+    } else {
+      // Only keep the bits every spilled rule agrees on
+      cover_mask &= p_rule.mask & ~(p_rule.id ^ cover_id);
+    }
+  };
+
+  for (auto const& rule : p_rules) {
+    if (rule.extended != p_extended or is_exact(rule)) {
+      continue;
+    }
+    if (mask_used < usable_mask_banks) {
+      allow_pair(*p_mask[mask_used++], rule.id, rule.mask);
+      result.hardware_rules++;
+    } else {
+      spill(rule);
+    }
+  }
+
+  for (auto const& rule : p_rules) {
+    if (rule.extended != p_extended or not is_exact(rule)) {
+      continue;
+    }
+    if (identifier_used < p_identifier.size()) {
+      p_identifier[identifier_used++]->allow(static_cast<Id>(rule.id));
+      result.hardware_rules++;
+    } else if (mask_used < usable_mask_banks) {
+      allow_pair(*p_mask[mask_used++], rule.id, rule.mask);
+      result.hardware_rules++;
+    } else {
+      spill(rule);
+    }
+  }
+
+  if (result.spilled_rules != 0) {
+    if (reserve_cover) {
+      allow_pair(*p_mask[mask_used++], cover_id & cover_mask, cover_mask);
+    } else {
+      result.needs_open_hardware = true;
+    }
+  }
+
+  for (auto i = identifier_used; i < p_identifier.size(); i++) {
+    p_identifier[i]->allow(std::nullopt);
+  }
+  for (auto i = mask_used; i < p_mask.size(); i++) {
+    p_mask[i]->allow(std::nullopt);
+  }
+
+  return result;
+}
+}  // namespace
+
+std::optional<filter_allocation> allocate_filters(
+  std::span<filter_rule const> p_rules,
+  filter_banks const& p_banks,
+  software_filter& p_software)
+{
+  auto const standard = allocate_width<hal::u16>(
+    p_rules, false, p_banks.identifier, p_banks.mask);
+  auto const extended = allocate_width<hal::u32>(
+    p_rules, true, p_banks.extended_identifier, p_banks.extended_mask);
+
+  filter_allocation allocation{
+    .hardware_rules = standard.hardware_rules + extended.hardware_rules,
+    .software_rules = standard.spilled_rules + extended.spilled_rules,
+  };
+
+  p_software.clear();
+  if (allocation.software_rules == 0) {
+    return allocation;
+  }
+
+  if (standard.needs_open_hardware or extended.needs_open_hardware) {
+    if (not p_banks.extended_mask.empty()) {
+      // Same configuration the Lawicel acceptance registers default to, which
+      // accepts standard frames as well
+      allow_pair(*p_banks.extended_mask[0], 0, 0);
+    } else if (not p_banks.identifier.empty() or
+               not p_banks.extended_identifier.empty() or
+               not p_banks.mask.empty()) {
+      // The enabled banks would drop frames matching the spilled rules
+      return std::nullopt;
+    }
+  }
+
+  for (auto const& rule : p_rules) {
+    bool added = false;
+    if (rule.extended) {
+      added = is_exact(rule)
+                ? p_software.allow_extended(rule.id)
+                : p_software.allow_extended_mask(rule.id, rule.mask);
+    } else {
+      added = p_software.allow_standard_mask(rule.id, rule.mask);
+    }
+    if (not added) {
+      return std::nullopt;
+    }
+  }
+
+  return allocation;
+}
+
+void disable_filters(filter_banks const& p_banks)
+{
+  for (auto* filter : p_banks.identifier) {
+    filter->allow(std::nullopt);
+  }
+  for (auto* filter : p_banks.extended_identifier) {
+    filter->allow(std::nullopt);
+  }
+  for (auto* filter : p_banks.mask) {
+    filter->allow(std::nullopt);
+  }
+  for (auto* filter : p_banks.extended_mask) {
+    filter->allow(std::nullopt);
+  }
+}
@@ -1,67 +1,144 @@
+#include <algorithm>
 #include <array>
-#include <charconv>
+#include <atomic>
+#include <chrono>
 #include <cstddef>
 #include <cstdlib>
+#include <limits>
 #include <optional>
 #include <span>
 #include <string_view>
+#include <utility>
 
 #include <libhal-exceptions/control.hpp>
 #include <libhal-util/as_bytes.hpp>
 #include <libhal-util/bit.hpp>
 #include <libhal-util/serial.hpp>
 #include <libhal-util/steady_clock.hpp>
-#include <libhal-util/streams.hpp>
 #include <libhal-util/timeout.hpp>
 #include <libhal/can.hpp>
 #include <libhal/error.hpp>
 #include <libhal/steady_clock.hpp>
 #include <libhal/timeout.hpp>
 #include <libhal/units.hpp>
-#include <nonstd/ring_span.hpp>
 
+#include <app/binary_frame.hpp>
+#include <app/bus_monitor.hpp>
+#include <app/capture_buffer.hpp>
+#include <app/change_filter.hpp>
+#include <app/command_parser.hpp>
+#include <app/config.hpp>
+#include <app/console_writer.hpp>
+#include <app/filter_allocator.hpp>
+#include <app/periodic_scheduler.hpp>
+#include <app/receive_reader.hpp>
 #include <app/resource_list.hpp>
+#include <app/slcan.hpp>
+#include <app/software_filter.hpp>
+#include <app/statistics.hpp>
+#include <app/trace.hpp>
+#include <app/transmit_queue.hpp>
 
 resource_list hardware_map{};
-std::array<hal::byte, 32> command_buffer{};
-std::array<hal::can_message, 32> receive_buffer{};
-std::array<hal::can_message, 32> transmit_buffer{};
-nonstd::ring_span<hal::can_message> receive_queue(receive_buffer.begin(),
-                                                  receive_buffer.end());
-nonstd::ring_span<hal::can_message> transmit_queue(transmit_buffer.begin(),
-                                                   transmit_buffer.end());
-bool open;
-hal::can_extended_mask_filter::pair global_filter{ .id = 0, .mask = 0 };
+// Large enough for a 'b' burst of 16 extended frames with full payloads
+std::array<hal::byte, 512> command_buffer{};
+std::array<hal::byte, 1024> console_output_buffer{};
 
-constexpr std::string_view version = "V0000";
-constexpr std::string_view serial_number = "N0000";
-
-std::span<char const> to_chars(std::span<hal::byte const> p_data)
-{
-  return { reinterpret_cast<char const*>(p_data.data()), p_data.size() };
-}
-
-std::optional<hal::u32> ascii_hex_bytes_to_u32(
-  std::span<hal::byte const> p_data)
+/**
+ * @brief State kept for each CAN channel
+ *
+ * Sized at compile time by CAN_OPENER_CHANNELS, so a build with one channel
+ * holds exactly one of each.
+ */
+struct can_channel
 {
-  auto const char_data = to_chars(p_data);
-  hal::u32 value = 0;
-  auto const status = std::from_chars(
-    char_data.data(), char_data.data() + char_data.size(), value, 16);
+  // Reads frames out of the transceiver's buffer, noted by the channel's
+  // receive interrupt and drained by the main loop
+  receive_reader<receive_depth> received_frames{};
+  // Messages from the host and the schedule, sent highest bus priority first
+  priority_transmit_queue<transmit_depth> transmit_queue{};
+  // Receive queue overflow count as of the last status flags report
+  hal::u32 reported_receive_overflows = 0;
+  // Reported by the 'I' command, written by the channel's receive interrupt
+  channel_statistics stats{};
+  change_filter changes{};
+  hal::can_extended_mask_filter::pair global_filter{ .id = 0, .mask = 0 };
+  // Applied to every received frame before it is queued
+  software_filter acceptance_filter{};
+  // Cleared while the filters are being programmed, the receive interrupt
+  // then rejects every frame rather than filter it against a half programmed
+  // software filter or filter banks
+  std::atomic<bool> filters_ready = false;
+  // Rules loaded with the 'K' command, compiled onto the filter banks
+  std::array<filter_rule, 64> filter_rules{};
+  std::size_t filter_rule_count = 0;
+  filter_banks hardware_filters{};
+  // Cyclic messages loaded with the 'Y' command, sent while the channel is
+  // open
+  periodic_scheduler schedule{};
+  // Controller error state behind the 'F' flags and the 'E' command
+  bus_monitor errors{};
+};
 
-  if (status.ec != std::errc{}) {
-    return std::nullopt;
-  }
+std::array<can_channel, channel_count> channels{};
+// Channel selected with the 'J' command, which channel specific commands
+// apply to
+std::size_t selected_channel = 0;
+// Channel the next received frame is forwarded from, taking turns
+std::size_t next_forward_channel = 0;
+// Whether the channels are open. Not named `open`, which would take the place
+// of the C library function when the application is built for a host.
+bool bus_open = false;
+// Forward received frames as binary records instead of slcan text
+bool binary_mode = false;
+// Number of frames forwarded to the host, used for binary record sequencing
+hal::u32 forwarded_frames = 0;
+timestamp_mode timestamps = timestamp_mode::off;
+// Only forward frames whose contents changed, see the 'D' command
+bool change_only = false;
+// Stream error events, see the 'E' command
+bool error_events = false;
+// Least milliseconds between error events that only report counter changes
+hal::u32 error_event_interval = 0;
+// Uptime clock frequency in Hz, used to convert receive times
+hal::u64 clock_frequency = 1;
+// Triggered capture set up with the 'G' command. capture_size bytes in .bss,
+// by far the largest user of RAM, so size it to what the board has free.
+capture_buffer<capture_size> capture{};
+// Channel whose received frames the capture records, the one selected when
+// it was armed. Only one receive interrupt ever writes to the capture.
+std::size_t capture_channel = 0;
+// Offset of the next capture byte to send while a 'g' dump is in progress
+std::optional<std::size_t> capture_dump_offset;
+// Reported by the 'I' command
+statistics stats{};
+// Per frame latency events dumped by the 'H' command, one ring per context.
+// Compiled out unless the build enables tracing.
+trace_buffer<trace_depth> interrupt_trace{};
+trace_buffer<trace_depth> loop_trace{};
+console_write_tracker<trace_depth> console_writes{};
+
+// Console baud rates selectable with the 'U' command. Entries 0 to 6 are the
+// rates defined by Lawicel, the remaining entries are extensions for host links
+// that can go faster.
+constexpr std::array<hal::u32, 11> console_baud_rates{
+  230'400, 115'200, 57'600,  38'400,    19'200,    9'600,
+  2'400,   460'800, 921'600, 1'000'000, 2'000'000,
+};
+// Must match the baud rate the platform initially configures the console to
+std::size_t console_baud_rate_index = 1;
+// Set by the 'U' command, applied once the acknowledgement has been sent
+std::optional<std::size_t> pending_console_baud_rate_index;
 
-  return value;
-}
+constexpr std::string_view version = "V0000";
+constexpr std::string_view serial_number = "N0000";
 
 bool setup_command(hal::can_bus_manager& p_can,
                    std::span<hal::byte const> p_command)
 {
   using namespace hal::literals;
 
-  if (p_command.size() != 3 or open) {
+  if (p_command.size() != 3 or bus_open) {
     return false;
   }
 
@@ -116,7 +193,7 @@ bool set_custom_baud_rate(hal::can_bus_manager& p_can,
   using namespace hal::literals;
 
   constexpr std::string_view format = "sxxyy\r";
-  if (open or p_command.size() != format.size()) {
+  if (bus_open or p_command.size() != format.size()) {
     return false;
   }
 
@@ -129,8 +206,9 @@ bool set_custom_baud_rate(hal::can_bus_manager& p_can,
   constexpr auto time_segment_2 = hal::bit_mask::from(4, 6);
   [[maybe_unused]] constexpr auto sampling = hal::bit_mask::from(7);
 
-  auto const byte1 = ascii_hex_bytes_to_u32(p_command.subspan(1, 1));
-  auto const byte2 = ascii_hex_bytes_to_u32(p_command.subspan(2, 1));
+  // Bus timing register 0 (xx) and 1 (yy) of the SJA1000
+  auto const byte1 = decode_hex<2>(&p_command[1]);
+  auto const byte2 = decode_hex<2>(&p_command[3]);
 
   if (not byte1 or not byte2) {
     return false;
@@ -157,180 +235,879 @@ bool set_custom_baud_rate(hal::can_bus_manager& p_can,
   return true;
 }
 
+bool console_baud_rate_command(console_writer& p_console,
+                               std::span<hal::byte const> p_command)
+{
+  // U[CR] reports the current setting so a host can check that it is in sync
+  if (p_command.size() == 2) {
+    std::array<hal::byte, 2> response{ 'U', 0 };
+    encode_hex<1>(&response[1], console_baud_rate_index);
+    p_console.write(response);
+    return true;
+  }
+
+  constexpr std::string_view format = "Un\r";
+  if (bus_open or p_command.size() != format.size()) {
+    return false;
+  }
+
+  auto const index = decode_hex<1>(&p_command[1]);
+  if (not index or *index >= console_baud_rates.size()) {
+    return false;
+  }
+
+  // The change can only be made after the acknowledgement has gone out at the
+  // current baud rate.
+  pending_console_baud_rate_index = *index;
+  return true;
+}
+
+/**
+ * @brief Switch the console to the baud rate requested by the 'U' command
+ *
+ * Flushes all pending output at the current baud rate first, so the host
+ * receives the acknowledgement before the rate changes. If the console cannot
+ * run at the requested rate, it stays at the current rate.
+ *
+ * @param p_console - buffered console output
+ * @param p_serial - the console serial port to reconfigure
+ * @param p_clock - clock used to wait for the final characters to go out
+ */
+void apply_console_baud_rate(console_writer& p_console,
+                             hal::serial& p_serial,
+                             hal::steady_clock& p_clock)
+{
+  if (not pending_console_baud_rate_index) {
+    return;
+  }
+
+  auto const new_index = *pending_console_baud_rate_index;
+  pending_console_baud_rate_index.reset();
+
+  p_console.flush();
+
+  // Flushing only hands the bytes to the UART, give the last couple of
+  // characters (10 bits each) time to leave the shift register.
+  auto const current_rate = console_baud_rates[console_baud_rate_index];
+  hal::delay(p_clock, std::chrono::microseconds(20'000'000 / current_rate));
+
+  hal::serial::settings settings{
+    .stop = hal::serial::settings::stop_bits::one,
+    .parity = hal::serial::settings::parity::none,
+  };
+
+  try {
+    settings.baud_rate = console_baud_rates[new_index];
+    p_serial.configure(settings);
+    console_baud_rate_index = new_index;
+  } catch (hal::operation_not_supported const&) {
+    settings.baud_rate = current_rate;
+    p_serial.configure(settings);
+  }
+}
+
+bool binary_mode_command(std::span<hal::byte const> p_command)
+{
+  constexpr std::string_view format = "Bn\r";
+  if (bus_open or p_command.size() != format.size()) {
+    return false;
+  }
+
+  switch (p_command[1]) {
+    case '0': {
+      binary_mode = false;
+      break;
+    }
+    case '1': {
+      binary_mode = true;
+      break;
+    }
+    default: {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool timestamp_command(std::span<hal::byte const> p_command)
+{
+  constexpr std::string_view format = "Zn\r";
+  if (bus_open or p_command.size() != format.size()) {
+    return false;
+  }
+
+  switch (p_command[1]) {
+    case '0': {
+      timestamps = timestamp_mode::off;
+      break;
+    }
+    case '1': {
+      timestamps = timestamp_mode::milliseconds;
+      break;
+    }
+    case '2': {
+      timestamps = timestamp_mode::microseconds;
+      break;
+    }
+    default: {
+      return false;
+    }
+  }
+  return true;
+}
+
+/// Frames dropped because a channel's receive queue overflowed
+hal::u32 receive_overflows()
+{
+  hal::u32 total = 0;
+  for (auto const& channel : channels) {
+    total += channel.received_frames.overflow_count();
+  }
+  return total;
+}
+
+/// Frames received on every channel
+hal::u32 frames_received()
+{
+  hal::u32 total = 0;
+  for (auto const& channel : channels) {
+    total += channel.stats.frames_received.value();
+  }
+  return total;
+}
+
+/// Frames the acceptance filters rejected on every channel
+hal::u32 frames_filtered()
+{
+  hal::u32 total = 0;
+  for (auto const& channel : channels) {
+    total += channel.stats.frames_filtered.value();
+  }
+  return total;
+}
+
+/// Times a controller went bus off, on every channel
+hal::u32 bus_off_events()
+{
+  hal::u32 total = 0;
+  for (auto const& channel : channels) {
+    total += channel.errors.bus_off_count();
+  }
+  return total;
+}
+
+/// Frames the change only mode kept from the console on every channel
+hal::u32 suppressed_frames()
+{
+  hal::u32 total = 0;
+  for (auto const& channel : channels) {
+    total += channel.changes.suppressed();
+  }
+  return total;
+}
+
+/// Frames the change only mode forwarded because their ID did not fit into
+/// the table, on every channel
+hal::u32 untracked_frames()
+{
+  hal::u32 total = 0;
+  for (auto const& channel : channels) {
+    total += channel.changes.untracked();
+  }
+  return total;
+}
+
+bool change_only_command(console_writer& p_console,
+                         std::span<hal::byte const> p_command)
+{
+  // D[CR] reports how many frames have been suppressed
+  if (p_command.size() == 2) {
+    std::array<hal::byte, 9> response{ 'D' };
+    encode_hex<8>(&response[1], suppressed_frames());
+    p_console.write(response);
+    return true;
+  }
+
+  if (bus_open) {
+    return false;
+  }
+
+  constexpr std::string_view disable_format = "D0\r";
+  constexpr std::string_view enable_format = "D1kkkk\r";
+
+  if (p_command.size() == disable_format.size() and p_command[1] == '0') {
+    change_only = false;
+    return true;
+  }
+
+  if (p_command.size() == enable_format.size() and p_command[1] == '1') {
+    auto const keep_alive = decode_hex<4>(&p_command[2]);
+    if (not keep_alive) {
+      return false;
+    }
+    for (auto& channel : channels) {
+      channel.changes.reset(*keep_alive);
+    }
+    change_only = true;
+    return true;
+  }
+
+  return false;
+}
+
+/**
+ * @brief Convert uptime clock ticks into microseconds
+ *
+ * The whole seconds and the remainder are converted separately so the
+ * multiplication cannot overflow, however long the device has been running.
+ *
+ * @param p_ticks - uptime clock ticks
+ * @return hal::u64 - microseconds since the clock started
+ */
+hal::u64 ticks_to_microseconds(hal::u64 p_ticks)
+{
+  auto const seconds = p_ticks / clock_frequency;
+  auto const remainder = p_ticks % clock_frequency;
+  return (seconds * 1'000'000) + ((remainder * 1'000'000) / clock_frequency);
+}
+
+bool periodic_command(can_channel& p_channel,
+                      std::span<hal::byte const> p_command)
+{
+  auto& schedule = p_channel.schedule;
+
+  // y[CR] removes every message, yss[CR] removes the one in slot ss
+  if (p_command[0] == 'y') {
+    constexpr std::string_view clear_format = "y\r";
+    constexpr std::string_view remove_format = "yss\r";
+    if (p_command.size() == clear_format.size()) {
+      schedule.clear();
+      return true;
+    }
+    if (p_command.size() != remove_format.size()) {
+      return false;
+    }
+    auto const slot = decode_hex<2>(&p_command[1]);
+    return slot and schedule.remove(*slot);
+  }
+
+  // Yss pppppppp oooooooo followed by a t, T, r or R frame, without spaces.
+  // Period and offset are in microseconds.
+  constexpr std::string_view prefix_format = "Yssppppppppoooooooo";
+  if (p_command.size() <= prefix_format.size()) {
+    return false;
+  }
+
+  auto const slot = decode_hex<2>(&p_command[1]);
+  auto const period = decode_hex<8>(&p_command[3]);
+  auto const offset = decode_hex<8>(&p_command[11]);
+  auto const message =
+    decode_can_message(p_command.subspan(prefix_format.size()));
+
+  if (not slot or not period or not offset or not message) {
+    return false;
+  }
+
+  auto const now = ticks_to_microseconds((*hardware_map.clock)->uptime());
+  return schedule.set(*slot, *message, *period, *offset, now);
+}
+
+/**
+ * @brief Move the cyclic messages that are due onto their transmit queues
+ *
+ * Messages that are due while their channel's transmit queue is full stay due
+ * and go out on a later pass.
+ *
+ * @param p_clock - uptime clock the schedules run on
+ */
+void queue_periodic_messages(hal::steady_clock& p_clock)
+{
+  if (not bus_open) {
+    return;
+  }
+
+  for (auto& channel : channels) {
+    if (channel.schedule.empty()) {
+      continue;
+    }
+    auto const now = ticks_to_microseconds(p_clock.uptime());
+    while (not channel.transmit_queue.full()) {
+      auto const message = channel.schedule.poll(now);
+      if (not message) {
+        break;
+      }
+      channel.transmit_queue.push(*message);
+    }
+  }
+}
+
+bool capture_command(console_writer& p_console,
+                     std::span<hal::byte const> p_command)
+{
+  constexpr std::string_view status_format = "G\r";
+  constexpr std::string_view stop_format = "G0\r";
+  constexpr std::string_view id_format = "Gppppqqqqkkkkkkkkmmmmmmmm\r";
+  constexpr std::string_view payload_format =
+    "Gppppqqqqkkkkkkkkmmmmmmmmddddddddddddddddxxxxxxxxxxxxxxxx\r";
+
+  // G[CR] reports the state and the number of records as Gsnnnn
+  if (p_command.size() == status_format.size()) {
+    std::array<hal::byte, 6> response{ 'G' };
+    encode_hex<1>(&response[1], static_cast<hal::u32>(capture.state()));
+    encode_hex<4>(&response[2], std::min<hal::u32>(capture.records(), 0xFFFF));
+    p_console.write(response);
+    return true;
+  }
+
+  if (p_command.size() == stop_format.size() and p_command[1] == '0') {
+    capture.stop();
+    return true;
+  }
+
+  if (p_command.size() != id_format.size() and
+      p_command.size() != payload_format.size()) {
+    return false;
+  }
+
+  // A dump in progress would read the ring while it is being refilled
+  if (capture_dump_offset) {
+    return false;
+  }
+
+  auto const pre_trigger = decode_hex<4>(&p_command[1]);
+  auto const post_trigger = decode_hex<4>(&p_command[5]);
+  auto const key = decode_hex<8>(&p_command[9]);
+  auto const key_mask = decode_hex<8>(&p_command[17]);
+  if (not pre_trigger or not post_trigger or not key or not key_mask) {
+    return false;
+  }
+
+  capture_trigger trigger{ .key = *key, .key_mask = *key_mask };
+
+  if (p_command.size() == payload_format.size()) {
+    for (std::size_t i = 0; i < trigger.data.size(); i++) {
+      auto const data = decode_hex<2>(&p_command[25 + (i * 2)]);
+      auto const data_mask = decode_hex<2>(&p_command[41 + (i * 2)]);
+      if (not data or not data_mask) {
+        return false;
+      }
+      trigger.data[i] = *data;
+      trigger.data_mask[i] = *data_mask;
+    }
+  }
+
+  // Stop the running capture before its channel changes under the interrupt
+  capture.stop();
+  capture_channel = selected_channel;
+  capture.arm(trigger, *pre_trigger, *post_trigger);
+  return true;
+}
+
+bool capture_dump_command(console_writer& p_console,
+                          std::span<hal::byte const> p_command)
+{
+  constexpr std::string_view format = "g\r";
+  if (p_command.size() != format.size() or capture_dump_offset or
+      capture.state() != capture_state::done) {
+    return false;
+  }
+
+  // gbbbbbbbbttttttttiiii, the size in bytes, the time the first record's delta
+  // counts from and the index of the trigger record. The records follow as
+  // g<hex> lines from the main loop.
+  std::array<hal::byte, 21> response{ 'g' };
+  encode_hex<8>(&response[1], capture.size());
+  encode_hex<8>(&response[9], capture.base_time() & 0xFFFF'FFFF);
+  encode_hex<4>(&response[17],
+                std::min<hal::u32>(capture.trigger_index(), 0xFFFF));
+  p_console.write(response);
+
+  capture_dump_offset = 0;
+  return true;
+}
+
+/**
+ * @brief Send the next part of a capture dump started with the 'g' command
+ *
+ * Sends records as lines of up to 32 bytes in hex, as long as the console has
+ * room for them, so the dump goes at the pace of the host link without
+ * holding up the loop. The dump ends with an empty `g` line.
+ *
+ * @param p_console - console to send the dump to
+ */
+void dump_capture(console_writer& p_console)
+{
+  constexpr std::size_t bytes_per_line = 32;
+  std::array<hal::byte, 1 + (bytes_per_line * 2) + 1> line{ 'g' };
+  std::array<hal::byte, bytes_per_line> data{};
+
+  while (capture_dump_offset and p_console.free_space() >= line.size()) {
+    auto const count = capture.read(*capture_dump_offset, data);
+    for (std::size_t i = 0; i < count; i++) {
+      encode_hex<2>(&line[1 + (i * 2)], data[i]);
+    }
+    line[1 + (count * 2)] = '\r';
+    p_console.try_write(std::span(line).first(2 + (count * 2)));
+
+    if (count == 0) {
+      capture_dump_offset.reset();
+    } else {
+      *capture_dump_offset += count;
+    }
+  }
+}
+
 bool open_command()
 {
   // Check if open was issued while the device is already open
-  if (open) {
+  if (bus_open) {
     return false;
   }
-  open = true;
+  bus_open = true;
   return true;
 }
 
 bool close_command()
 {
   // Check if open was issued while the device is already open
-  if (not open) {
+  if (not bus_open) {
     return false;
   }
-  open = false;
+  bus_open = false;
   return true;
 }
 
-bool status_flags_command(hal::serial& p_serial)
+bool status_flags_command(console_writer& p_console, can_channel& p_channel)
 {
   std::uint8_t status = 0x0;
 
   // Bit 0 receive queue full
-  if (receive_queue.full()) {
+  if (p_channel.received_frames.full()) {
     status |= 1 << 0;
   }
 
   // Bit 1 transmit queue full
-  if (transmit_queue.full()) {
+  if (p_channel.transmit_queue.full()) {
     status |= 1 << 1;
   }
 
-  // TODO(#4): Bit 2 Error warning (EI), see SJA1000
-  // TODO(#5): Bit 3 Data Overrun (DOI), see SJA1000
-  // TODO(#6): Bit 5 Error Passive (EPI), see SJA1000
-  // TODO(#7): Bit 6 Arbitration Lost (ALI), see SJA1000
-  // TODO(#8): Bit 7 Bus Error (BEI), see SJA1000
+  // Bit 3 Data Overrun (DOI), latched until read like the SJA1000: set if any
+  // received frames were dropped since the last time the flags were read.
+  auto const overflows = p_channel.received_frames.overflow_count();
+  if (overflows != p_channel.reported_receive_overflows) {
+    status |= 1 << 3;
+    p_channel.reported_receive_overflows = overflows;
+  }
+
+  // Bit 2 Error Warning (EI), bit 5 Error Passive (EPI), bit 6 Arbitration
+  // Lost (ALI) and bit 7 Bus Error (BEI), latched until read like the SJA1000
+  status |= p_channel.errors.take_flags();
 
-  hal::print<6>(p_serial, "F%02X\r", status);
+  // Fxx[CR]
+  std::array<hal::byte, 4> response{ 'F', 0, 0, '\r' };
+  encode_hex<2>(&response[1], status);
+  p_console.write(response);
 
   return true;
 }
 
-std::optional<hal::can_message> string_to_can_message(
-  std::span<hal::byte const> p_command)
+bool statistics_command(console_writer& p_console,
+                        std::span<hal::byte const> p_command)
 {
-  hal::can_message message{};
-  std::size_t format_size = 0;
-  std::size_t id_byte_length = 0;
-  auto const command = p_command[0];
-  auto command_chars = to_chars(p_command);
-
-  if (command == 'r' or command == 't') {
-    constexpr std::string_view format = "tiiil\r";
-    format_size = format.size();
-    id_byte_length = 3;
-    message.extended(false);
-  } else if (command == 'R' or command == 'T') {
-    constexpr std::string_view format = "Tiiiiiiiil\r";
-    format_size = format.size();
-    id_byte_length = 8;
-    message.extended(true);
+  constexpr std::string_view format = "I\r";
+  if (p_command.size() != format.size()) {
+    return false;
   }
 
-  if (command_chars.size() < format_size) {
-    return std::nullopt;
-  }
+  auto const clamp = [](hal::u64 p_value) -> hal::u32 {
+    return std::min<hal::u64>(p_value, 0xFFFF'FFFF);
+  };
+  auto const pass_microseconds = [&clamp](hal::u64 p_ticks) -> hal::u32 {
+    if (p_ticks == std::numeric_limits<hal::u64>::max()) {
+      return 0;
+    }
+    return clamp(ticks_to_microseconds(p_ticks));
+  };
 
-  if (command == 'r' or command == 'R') {
-    message.remote_request(true);
-  } else {
-    message.remote_request(false);
+  std::array const fields{
+    frames_received(),
+    frames_filtered(),
+    receive_overflows(),
+    forwarded_frames,
+    suppressed_frames(),
+    stats.frames_transmitted.value(),
+    stats.transmit_failures.value(),
+    stats.commands_handled.value(),
+    stats.commands_rejected.value(),
+    p_console.bytes_written(),
+    stats.receive_high_water,
+    stats.transmit_high_water,
+    pass_microseconds(stats.shortest_pass),
+    pass_microseconds(stats.longest_pass),
+    bus_off_events(),
+    untracked_frames(),
+  };
+
+  // I followed by each field as 8 hex characters
+  std::array<hal::byte, 1 + (fields.size() * 8)> response{ 'I' };
+  for (std::size_t i = 0; i < fields.size(); i++) {
+    encode_hex<8>(&response[1 + (i * 8)], fields[i]);
   }
+  p_console.write(response);
+  return true;
+}
 
-  // Skip first character
-  command_chars = command_chars.subspan(1);
+/**
+ * @brief Record a trace event if tracing is enabled
+ *
+ * @param p_trace - ring of the calling context
+ * @param p_stage - point the frame has reached
+ * @param p_frame - the frame's position in the receive sequence
+ */
+void trace(trace_buffer<trace_depth>& p_trace,
+           trace_stage p_stage,
+           hal::u32 p_frame)
+{
+  p_trace.record(p_stage, p_frame, **hardware_map.clock);
+}
 
-  // Scope for status variable
-  {
-    hal::u32 id = 0;
-    auto const status = std::from_chars(
-      &command_chars[0], &command_chars[id_byte_length], id, 16);
+bool trace_command(console_writer& p_console,
+                   std::span<hal::byte const> p_command)
+{
+  constexpr std::string_view format = "H\r";
+  if (not trace_buffer<trace_depth>::enabled or
+      p_command.size() != format.size()) {
+    return false;
+  }
 
-    if (status.ec != std::errc{}) {
-      return std::nullopt;
+  interrupt_trace.pause();
+  loop_trace.pause();
+
+  // Hiiiillllffffffff, the interrupt and main loop event counts and the clock
+  // frequency in Hz, followed by the events as binary.
+  std::array<hal::byte, 17> header{ 'H' };
+  encode_hex<4>(&header[1], interrupt_trace.size());
+  encode_hex<4>(&header[5], loop_trace.size());
+  encode_hex<8>(&header[9], std::min<hal::u64>(clock_frequency, 0xFFFF'FFFF));
+  p_console.write(header);
+
+  std::array<hal::byte, trace_event_size> event{};
+  for (auto const* ring : { &interrupt_trace, &loop_trace }) {
+    for (std::size_t i = 0; i < ring->size(); i++) {
+      ring->encode(i, event);
+      p_console.write(event);
     }
-    message.id(id);
   }
 
-  // Increment past ID field
-  command_chars = command_chars.subspan(id_byte_length);
-
-  // Convert length character to value
-  std::size_t payload_length = command_chars[0] - '0';
-
-  // Increment past length character
-  command_chars = command_chars.subspan(1);
-
-  bool valid_payload_length = payload_length <= 8;
-  // We multiply by 2 for the payload length because it takes two characters to
-  // represent each byte in the command string.
-  //
-  // (+ 1) for the '\r' character
-  bool length_within_bounds = command_chars.size() == (payload_length * 2) + 1;
-
-  if (not valid_payload_length or not length_within_bounds) {
-    return std::nullopt;
-  }
+  interrupt_trace.restart();
+  loop_trace.restart();
+  return true;
+}
 
-  message.length = payload_length;
+bool version_command(console_writer& p_console)
+{
+  p_console.write(hal::as_bytes(version));
+  return true;
+}
 
-  for (std::size_t i = 0; i < payload_length; i++) {
-    // Every two characters is a single byte of data, so we shift it by 1
-    // (divide by 2) to get the correct payload index.
-    std::size_t character_offset = i * 2;
-    // +2 because +1 for the next index and +1 for offset to end byte
-    auto status = std::from_chars(&command_chars[character_offset],
-                                  &command_chars[character_offset + 2],
-                                  message.payload[i],
-                                  16);
-    if (status.ec != std::errc{}) {
-      return std::nullopt;
+/// Compile a channel's rules onto its filters, see apply_filters()
+bool program_filters(can_channel& p_channel)
+{
+  auto& banks = p_channel.hardware_filters;
+  if (p_channel.filter_rule_count == 0) {
+    p_channel.acceptance_filter.clear();
+    disable_filters(banks);
+    if (not banks.extended_mask.empty()) {
+      banks.extended_mask[0]->allow(p_channel.global_filter);
     }
+    return true;
   }
 
-  return message;
+  auto const rules =
+    std::span(p_channel.filter_rules).first(p_channel.filter_rule_count);
+  return allocate_filters(rules, banks, p_channel.acceptance_filter)
+    .has_value();
 }
 
-bool version_command(hal::serial& p_serial)
+/**
+ * @brief Program a channel's filters from its loaded rules
+ *
+ * With no rules loaded, the first extended mask filter holds the acceptance
+ * code and mask set by the 'M' and 'm' commands and every other bank is
+ * disabled.
+ *
+ * The channel's receive interrupt keeps running, so it rejects every frame
+ * until the filters are whole again. Filters that could not be programmed
+ * keep rejecting every frame until they are programmed successfully.
+ *
+ * @param p_channel - channel to program the filters of
+ * @return true - the filters were programmed
+ * @return false - the rules could not be compiled onto the filters
+ */
+bool apply_filters(can_channel& p_channel)
 {
-  hal::print(p_serial, version);
-  return true;
+  p_channel.filters_ready.store(false, std::memory_order_relaxed);
+  // The interrupt runs to completion before the loop resumes, so only the
+  // compiler could move the filter writes ahead of the flag
+  std::atomic_signal_fence(std::memory_order_seq_cst);
+
+  auto const programmed = program_filters(p_channel);
+  if (programmed) {
+    p_channel.filters_ready.store(true, std::memory_order_release);
+  }
+  return programmed;
 }
 
-bool sets_acceptance_code_register(hal::can_extended_mask_filter& p_filter,
+bool sets_acceptance_code_register(can_channel& p_channel,
                                    std::span<hal::byte const> p_command)
 {
   constexpr std::string_view format = "Mxxxxxxxx\r";
-  // -1 to remove the null character length
-  if (open or p_command.size() < (format.size() - 1)) {
+  if (bus_open or p_command.size() < (format.size() - 1)) {
     return false;
   }
 
-  // subspan 1 to ignore the command character
-  auto const register_value = ascii_hex_bytes_to_u32(p_command.subspan(1));
+  // Skip the command character
+  auto const register_value = decode_hex<8>(&p_command[1]);
 
   if (not register_value) {
     return false;
   }
 
   if (p_command[0] == 'M') {
-    global_filter.id = *register_value;
+    p_channel.global_filter.id = *register_value;
   } else if (p_command[0] == 'm') {
-    global_filter.mask = *register_value;
+    p_channel.global_filter.mask = *register_value;
   } else {
     return false;
   }
 
-  p_filter.allow(global_filter);
+  return apply_filters(p_channel);
+}
+
+bool acceptance_filter_command(can_channel& p_channel,
+                               std::span<hal::byte const> p_command)
+{
+  if (bus_open) {
+    return false;
+  }
+
+  auto& rules = p_channel.filter_rules;
+  auto& rule_count = p_channel.filter_rule_count;
+
+  // k[CR] removes every rule
+  if (p_command[0] == 'k') {
+    constexpr std::string_view format = "k\r";
+    if (p_command.size() != format.size()) {
+      return false;
+    }
+    rule_count = 0;
+    return apply_filters(p_channel);
+  }
+
+  if (rule_count == rules.size()) {
+    return false;
+  }
+
+  constexpr std::string_view standard_format = "Kiii\r";
+  constexpr std::string_view standard_mask_format = "Kiiimmm\r";
+  constexpr std::string_view extended_format = "Kiiiiiiii\r";
+  constexpr std::string_view extended_mask_format = "Kiiiiiiiimmmmmmmm\r";
+  constexpr hal::u32 standard_id_mask = 0x7FF;
+  constexpr hal::u32 extended_id_mask = 0x1FFF'FFFF;
+
+  std::optional<hal::u32> id;
+  std::optional<hal::u32> mask;
+  bool extended = false;
+
+  switch (p_command.size()) {
+    case standard_format.size(): {
+      id = decode_hex<3>(&p_command[1]);
+      mask = standard_id_mask;
+      break;
+    }
+    case standard_mask_format.size(): {
+      id = decode_hex<3>(&p_command[1]);
+      mask = decode_hex<3>(&p_command[4]);
+      break;
+    }
+    case extended_format.size(): {
+      id = decode_hex<8>(&p_command[1]);
+      mask = extended_id_mask;
+      extended = true;
+      break;
+    }
+    case extended_mask_format.size(): {
+      id = decode_hex<8>(&p_command[1]);
+      mask = decode_hex<8>(&p_command[9]);
+      extended = true;
+      break;
+    }
+    default: {
+      return false;
+    }
+  }
+
+  auto const id_mask = extended ? extended_id_mask : standard_id_mask;
+  if (not id or not mask or *id > id_mask or *mask > id_mask) {
+    return false;
+  }
+
+  rules[rule_count++] = {
+    .id = *id,
+    .mask = *mask,
+    .extended = extended,
+  };
+
+  if (not apply_filters(p_channel)) {
+    // Does not fit, go back to the previous rules
+    rule_count--;
+    apply_filters(p_channel);
+    return false;
+  }
+
+  return true;
+}
+
+/**
+ * @brief Queue several frames from a single 'b' command
+ *
+ * The frames are `t`, `T`, `r` or `R` commands without their '\r', one after
+ * the other. Either every frame is queued or, if any frame is malformed or
+ * they don't all fit into the transmit queue, none are.
+ *
+ * @param p_console - console to acknowledge the command on
+ * @param p_channel - channel to queue the frames on
+ * @param p_command - the command including its terminating '\r'
+ * @return true - every frame was queued and the count was sent as `bnn`
+ * @return false - nothing was queued
+ */
+bool burst_transmit_command(console_writer& p_console,
+                            can_channel& p_channel,
+                            std::span<hal::byte const> p_command)
+{
+  auto& transmit_queue = p_channel.transmit_queue;
+
+  // Skip the command character and the '\r'
+  auto const frames = p_command.subspan(1, p_command.size() - 2);
+
+  // Validate every frame before queuing any of them
+  std::size_t count = 0;
+  for (auto remaining = frames; not remaining.empty(); count++) {
+    auto const length = encoded_frame_length(remaining);
+    if (not length or *length > remaining.size() or
+        not decode_can_frame(remaining.first(*length))) {
+      return false;
+    }
+    remaining = remaining.subspan(*length);
+  }
+
+  auto const free_space = transmit_queue.capacity() - transmit_queue.size();
+  if (count == 0 or count > free_space) {
+    return false;
+  }
+
+  for (auto remaining = frames; not remaining.empty();) {
+    auto const length = *encoded_frame_length(remaining);
+    transmit_queue.push(*decode_can_frame(remaining.first(length)));
+    remaining = remaining.subspan(length);
+  }
 
+  // bnn[CR]
+  std::array<hal::byte, 3> response{ 'b', 0, 0 };
+  encode_hex<2>(&response[1], count);
+  p_console.write(response);
   return true;
 }
 
-void handle_command(hal::serial& p_serial,
-                    hal::can_bus_manager& p_can_manager,
-                    hal::can_extended_mask_filter& p_filter,
+bool error_command(console_writer& p_console,
+                   can_channel& p_channel,
+                   std::span<hal::byte const> p_command)
+{
+  auto const& errors = p_channel.errors;
+
+  // E[CR] reports the selected channel's error state as
+  // Esttrraaaaaaaabbbbbbbbnnnnnnnn, the controller state, the transmit and
+  // receive error counters, the arbitration losses, the bus errors and the
+  // times it went bus off.
+  if (p_command.size() == 2) {
+    auto const& counters = errors.counters();
+    std::array<hal::byte, 30> response{ 'E' };
+    encode_hex<1>(&response[1], static_cast<hal::u32>(errors.state()));
+    encode_hex<2>(&response[2], counters.transmit_errors);
+    encode_hex<2>(&response[4], counters.receive_errors);
+    encode_hex<8>(&response[6], counters.arbitration_losses);
+    encode_hex<8>(&response[14], counters.bus_errors);
+    encode_hex<8>(&response[22], errors.bus_off_count());
+    p_console.write(response);
+    return true;
+  }
+
+  constexpr std::string_view disable_format = "E0\r";
+  constexpr std::string_view enable_format = "E1iiii\r";
+
+  if (p_command.size() == disable_format.size() and p_command[1] == '0') {
+    error_events = false;
+    return true;
+  }
+
+  if (p_command.size() == enable_format.size() and p_command[1] == '1') {
+    auto const interval = decode_hex<4>(&p_command[2]);
+    if (not interval) {
+      return false;
+    }
+    // Only report what happens from here on
+    auto const now = ticks_to_microseconds((*hardware_map.clock)->uptime());
+    for (auto& channel : channels) {
+      channel.errors.restart_events(now / 1'000);
+    }
+    error_event_interval = *interval;
+    error_events = true;
+    return true;
+  }
+
+  return false;
+}
+
+bool channel_select_command(console_writer& p_console,
+                            std::span<hal::byte const> p_command)
+{
+  // J[CR] reports the selected channel as Jn
+  if (p_command.size() == 2) {
+    std::array<hal::byte, 2> response{ 'J', 0 };
+    encode_hex<1>(&response[1], selected_channel);
+    p_console.write(response);
+    return true;
+  }
+
+  constexpr std::string_view format = "Jn\r";
+  if (p_command.size() != format.size()) {
+    return false;
+  }
+
+  auto const channel = decode_hex<1>(&p_command[1]);
+  if (not channel or *channel >= channel_count) {
+    return false;
+  }
+
+  selected_channel = *channel;
+  return true;
+}
+
+void handle_command(console_writer& p_console,
                     std::span<hal::byte const> p_command)
 {
   using namespace std::literals;
 
   bool handled = false;
+  auto& channel = channels[selected_channel];
+  auto& can_manager =
+    **hardware_map.can_channels[selected_channel].bus_manager;
+
+  // The command parser yields an empty command for one that overflowed the
+  // command buffer, reject it.
   if (p_command.empty()) {
+    stats.commands_rejected.increment();
+    p_console.write(hal::as_bytes("\x07"sv));
     return;
   }
 
@@ -339,7 +1116,44 @@ void handle_command(hal::serial& p_serial,
   //            versions into the build.
   switch (p_command[0]) {
     case 'V': {
-      handled = version_command(p_serial);
+      handled = version_command(p_console);
+      break;
+    }
+    case 'U': {
+      handled = console_baud_rate_command(p_console, p_command);
+      break;
+    }
+    case 'D': {
+      handled = change_only_command(p_console, p_command);
+      break;
+    }
+    case 'Y':
+    case 'y': {
+      handled = periodic_command(channel, p_command);
+      break;
+    }
+    case 'J': {
+      handled = channel_select_command(p_console, p_command);
+      break;
+    }
+    case 'E': {
+      handled = error_command(p_console, channel, p_command);
+      break;
+    }
+    case 'I': {
+      handled = statistics_command(p_console, p_command);
+      break;
+    }
+    case 'H': {
+      handled = trace_command(p_console, p_command);
+      break;
+    }
+    case 'G': {
+      handled = capture_command(p_console, p_command);
+      break;
+    }
+    case 'g': {
+      handled = capture_dump_command(p_console, p_command);
       break;
     }
     case '\r': {
@@ -348,25 +1162,38 @@ void handle_command(hal::serial& p_serial,
     }
   }
 
-  if (not open) {
-    // TODO(#11): Add command 'Z': timestamp control
+  if (not bus_open) {
     switch (p_command[0]) {
       case 'S': {
-        handled = setup_command(p_can_manager, p_command);
+        handled = setup_command(can_manager, p_command);
         break;
       }
       case 's': {
         // TODO(#14): This needs to be tested
-        handled = set_custom_baud_rate(p_can_manager, p_command);
+        handled = set_custom_baud_rate(can_manager, p_command);
         break;
       }
       case 'O': {
         handled = open_command();
         break;
       }
+
+      case 'B': {
+        handled = binary_mode_command(p_command);
+        break;
+      }
+      case 'Z': {
+        handled = timestamp_command(p_command);
+        break;
+      }
+      case 'K':
+      case 'k': {
+        handled = acceptance_filter_command(channel, p_command);
+        break;
+      }
       case 'M':
       case 'm': {
-        handled = sets_acceptance_code_register(p_filter, p_command);
+        handled = sets_acceptance_code_register(channel, p_command);
         break;
       }
     }
@@ -377,110 +1204,339 @@ void handle_command(hal::serial& p_serial,
         break;
       }
       case 'F': {
-        handled = status_flags_command(p_serial);
+        handled = status_flags_command(p_console, channel);
         break;
       }
       case 't':
       case 'r':
       case 'T':
       case 'R': {
-        const auto message = string_to_can_message(p_command);
+        // A full queue is reported with a BELL, the message is not queued
+        const auto message = decode_can_message(p_command);
         if (message) {
-          transmit_queue.push_back(message.value());
-          handled = true;
+          handled = channel.transmit_queue.push(message.value());
         }
         break;
       }
+      case 'b': {
+        handled = burst_transmit_command(p_console, channel, p_command);
+        break;
+      }
     }
   }
 
   if (handled) {
     // SEND CR
-    hal::write(p_serial, hal::as_bytes("\r"sv), hal::never_timeout());
+    stats.commands_handled.increment();
+    p_console.write(hal::as_bytes("\r"sv));
   } else {
     // SEND BELL
-    hal::write(p_serial, hal::as_bytes("\x07"sv), hal::never_timeout());
+    stats.commands_rejected.increment();
+    p_console.write(hal::as_bytes("\x07"sv));
+  }
+}
+
+/// Bytes of the channel digit each forwarded frame starts with, none in a
+/// build with a single channel
+constexpr std::size_t channel_tag_size = channel_count > 1 ? 1 : 0;
+/// Largest frame forward_received_message() writes to the console
+constexpr std::size_t max_forwarded_size =
+  std::max(channel_tag_size + max_encoded_message_size, max_binary_frame_size);
+
+/**
+ * @brief Forward the next received message of a channel to the console
+ *
+ * Messages are encoded as slcan text or, in binary mode, as binary records.
+ * In change only mode, messages that repeat the last forwarded contents of
+ * their ID are dropped here. In builds with several channels, text frames
+ * start with the channel's digit and binary records carry the channel.
+ *
+ * @param p_console - console to forward the message to, with room for the
+ * largest encoded message
+ * @param p_channel - number of the channel to take the message from
+ * @return true - a message was taken from the channel's receive queue
+ * @return false - the channel's receive queue is empty
+ */
+bool forward_received_message(console_writer& p_console, std::size_t p_channel)
+{
+  auto& channel = channels[p_channel];
+  auto const received = channel.received_frames.pop();
+  if (not received) {
+    return false;
+  }
+
+  // Trace indexes count the frames of one channel, so only the first channel
+  // is traced
+  bool const traced = p_channel == 0;
+  if (traced) {
+    trace(loop_trace, trace_stage::dequeued, received->index);
+  }
+
+  hal::u64 microseconds = 0;
+  if (timestamps != timestamp_mode::off or change_only) {
+    microseconds = ticks_to_microseconds(received->uptime);
+  }
+
+  auto const milliseconds = static_cast<hal::u32>(microseconds / 1'000);
+  if (change_only and
+      not channel.changes.should_forward(received->message, milliseconds)) {
+    return true;
+  }
+
+  std::array<hal::byte, max_forwarded_size> encoded{};
+  std::size_t length = 0;
+  if (binary_mode) {
+    // Frames dropped by the receive queues use up sequence numbers as well, so
+    // the host sees a gap for them too.
+    auto const sequence = forwarded_frames + receive_overflows();
+    binary_frame frame{
+      .message = received->message,
+      .sequence = hal::u8(sequence),
+    };
+    if (timestamps != timestamp_mode::off) {
+      frame.timestamp = microseconds & 0xFFFF'FFFF;
+    }
+    if (channel_count > 1) {
+      frame.channel = p_channel;
+    }
+    length = encode_binary_frame(encoded, frame);
+  } else {
+    if (channel_count > 1) {
+      encoded[0] = '0' + p_channel;
+    }
+    length = channel_tag_size +
+             encode_can_message(std::span(encoded).subspan(channel_tag_size),
+                                received->message,
+                                timestamps,
+                                microseconds);
+  }
+
+  if (traced) {
+    trace(loop_trace, trace_stage::encoded, received->index);
   }
+
+  p_console.try_write(std::span(encoded).first(length));
+  forwarded_frames++;
+  if (traced) {
+    trace(loop_trace, trace_stage::console_queued, received->index);
+    console_writes.add(received->index, p_console.bytes_queued());
+  }
+  return true;
 }
 
-void print_encoded_can_message(hal::serial& p_serial,
-                               const hal::can_message& p_message)
+/**
+ * @brief Forward pending received messages to the console
+ *
+ * Drains the receive queues for as long as the console output buffer has
+ * room. Messages that don't fit stay in their receive queue until the output
+ * buffer has drained, rather than blocking the loop on the serial port.
+ *
+ * The channels take turns one message at a time, carrying on from the last
+ * pass, so a busy channel cannot starve the others of console bandwidth.
+ *
+ * @param p_console - console to forward the messages to
+ */
+void forward_received_messages(console_writer& p_console)
 {
-  const bool standard = not p_message.extended();
+  for (auto const& channel : channels) {
+    stats.receive_high_water = std::max<hal::u32>(
+      stats.receive_high_water, channel.received_frames.size());
+  }
 
-  if (standard and not p_message.remote_request()) {
-    // A standard 11-bit CAN frame
-    // tiiildd...[CR]
-    hal::print<16>(p_serial, "t%03X", p_message.id());
-  } else if (not standard and not p_message.remote_request()) {
-    // A extended 29-bit CAN frame
-    // Tiiiiiiiildd...[CR]
-    hal::print<16>(p_serial, "T%08X", p_message.id());
-  } else if (standard and p_message.remote_request()) {
-    // A standard 11-bit CAN frame
-    // riii[CR]
-    hal::print<16>(p_serial, "r%03X", p_message.id());
-  } else if (not standard and p_message.remote_request()) {
-    // A extended 29-bit CAN frame
-    // Riiiiiiii[CR]
-    hal::print<16>(p_serial, "R%08X", p_message.id());
+  // Stop once every channel in a row had nothing to forward
+  std::size_t idle_channels = 0;
+  while (idle_channels < channel_count and
+         p_console.free_space() >= max_forwarded_size) {
+    auto const channel = next_forward_channel;
+    next_forward_channel = (next_forward_channel + 1) % channel_count;
+    if (forward_received_message(p_console, channel)) {
+      idle_channels = 0;
+    } else {
+      idle_channels++;
+    }
   }
+}
 
-  // Send data bytes if the message is not a remote request.
-  if (not p_message.remote_request()) {
-    hal::print<16>(p_serial, "%X", int(p_message.length));
-    for (std::size_t i = 0; i < p_message.length; i++) {
-      hal::print<16>(p_serial, "%02X", int(p_message.payload[i]));
+/**
+ * @brief Send a channel's queued messages, highest bus priority first
+ *
+ * If the platform can send without blocking, messages are sent until the
+ * controller has no room for another. Otherwise one message is sent per pass,
+ * so a busy bus cannot hold up the loop for more than one frame.
+ *
+ * @param p_channel - channel to send the queued messages of
+ * @param p_can - the channel's controller
+ */
+void transmit_messages(can_channel& p_channel, can_channel_resources& p_can)
+{
+  auto& transmit_queue = p_channel.transmit_queue;
+  stats.transmit_high_water =
+    std::max<hal::u32>(stats.transmit_high_water, transmit_queue.size());
+
+  // A message the transceiver fails to send is counted and dropped, so one bad
+  // message cannot block the queue.
+  if (p_can.send_nonblocking) {
+    auto& try_send = *p_can.send_nonblocking;
+    while (not transmit_queue.empty()) {
+      try {
+        if (not try_send(transmit_queue.front())) {
+          return;
+        }
+        stats.frames_transmitted.increment();
+      } catch (hal::exception const&) {
+        stats.transmit_failures.increment();
+      }
+      transmit_queue.pop();
     }
+    return;
   }
 
-  hal::print(p_serial, "\r");
+  if (auto const message = transmit_queue.pop()) {
+    try {
+      (*p_can.transceiver)->send(*message);
+      stats.frames_transmitted.increment();
+    } catch (hal::exception const&) {
+      stats.transmit_failures.increment();
+    }
+  }
 }
 
+/**
+ * @brief Follow each controller's error state and stream error events
+ *
+ * Reads the error counters of every channel whose platform can, and starts
+ * bus off recovery as soon as a controller goes bus off. While error events
+ * are enabled, due events are sent as long as the console has room, the rest
+ * wait for a later pass.
+ *
+ * @param p_console - console to send error events to
+ * @param p_clock - uptime clock to timestamp error events with
+ */
+void monitor_bus_errors(console_writer& p_console, hal::steady_clock& p_clock)
+{
+  // [n]esttrraaaabbbb[timestamp][CR]
+  constexpr std::size_t max_event_size = channel_tag_size + 14 + 8 + 1;
+
+  hal::u64 microseconds = 0;
+  if (error_events) {
+    microseconds = ticks_to_microseconds(p_clock.uptime());
+  }
+
+  for (std::size_t i = 0; i < channel_count; i++) {
+    auto& errors = channels[i].errors;
+    auto& can = hardware_map.can_channels[i];
+
+    std::optional<can_error_state> counters;
+    if (can.error_state) {
+      counters = (*can.error_state)();
+    }
+    if (errors.update(counters)) {
+      // The controller rejoins the bus by itself once it has seen the bus
+      // idle for long enough
+      (*can.bus_manager)->bus_on();
+      errors.recovering();
+    }
+
+    if (not error_events or p_console.free_space() < max_event_size) {
+      continue;
+    }
+    auto const event = errors.take_event(
+      static_cast<hal::u32>(microseconds / 1'000), error_event_interval);
+    if (not event) {
+      continue;
+    }
+
+    std::array<hal::byte, max_event_size> line{};
+    std::size_t length = 0;
+    if (channel_count > 1) {
+      line[length++] = '0' + i;
+    }
+    line[length++] = 'e';
+    encode_hex<1>(&line[length], static_cast<hal::u32>(event->state));
+    encode_hex<2>(&line[length + 1], event->transmit_errors);
+    encode_hex<2>(&line[length + 3], event->receive_errors);
+    encode_hex<4>(&line[length + 5],
+                  std::min<hal::u32>(event->arbitration_losses, 0xFFFF));
+    encode_hex<4>(&line[length + 9],
+                  std::min<hal::u32>(event->bus_errors, 0xFFFF));
+    length += 13;
+    length += encode_timestamp(&line[length], timestamps, microseconds);
+    line[length++] = '\r';
+    p_console.try_write(std::span(line).first(length));
+  }
+}
+
+template<std::size_t Channel>
+void can_bus_off_handler(hal::can_bus_manager::bus_off_tag)
+{
+  channels[Channel].errors.bus_off();
+}
+
+template<std::size_t Channel>
 void can_receive_handler(hal::can_interrupt::on_receive_tag,
                          const hal::can_message& p_message)
 {
-  if (not receive_queue.full()) {
-    receive_queue.push_back(p_message);
+  auto& channel = channels[Channel];
+  // Trace indexes count the frames of one channel, so only the first channel
+  // is traced
+  constexpr bool traced = Channel == 0;
+
+  auto const frame = channel.received_frames.next_index();
+  if (traced) {
+    trace(interrupt_trace, trace_stage::interrupt_entry, frame);
+  }
+  channel.stats.frames_received.increment();
+
+  // The frame already sits in the transceiver's buffer, only note whether to
+  // forward it and when it arrived. Rejected frames still use up a slot.
+  // Frames that arrive while the filters are being programmed are rejected.
+  if (not channel.filters_ready.load(std::memory_order_acquire) or
+      not channel.acceptance_filter.accepts(p_message)) {
+    channel.stats.frames_filtered.increment();
+    channel.received_frames.received(false, 0);
+    return;
+  }
+
+  // Timestamp as close to reception as possible
+  auto const uptime = (*hardware_map.clock)->uptime();
+
+  if (capture.recording() and Channel == capture_channel) {
+    capture.record(p_message, ticks_to_microseconds(uptime));
+  }
+
+  // Frames overwritten before the main loop reads them are counted by the
+  // reader and reported through the data overrun status flag.
+  channel.received_frames.received(true, uptime);
+  if (traced) {
+    trace(interrupt_trace, trace_stage::interrupt_exit, frame);
   }
 }
 
-namespace hal {
 /**
- * @ingroup Streams
- * @brief Fill a buffer of bytes until the sequence is found
+ * @brief Start reading a channel's received frames and bus off reports
  *
+ * @tparam Channel - number of the channel
  */
-class stream_fill_upto_v2
-{
-public:
-  /**
-   * @ingroup Streams
-   * @brief Construct a new fill upto object
-   *
-   * @param p_sequence - sequence to search for. The lifetime of this data
-   * pointed to by this span must outlive this object, or not be used when the
-   * lifetime of that data is no longer available.
-   * @param p_buffer - buffer to fill data into
-   */
-  stream_fill_upto_v2(std::span<hal::byte const> p_sequence,
-                      std::span<hal::byte> p_buffer);
-
-  friend std::span<const hal::byte> operator|(
-    const std::span<const hal::byte>& p_input_data,
-    stream_fill_upto_v2& p_self);
-
-  hal::work_state state();
-  std::span<hal::byte const> span();
-  std::span<hal::byte> unfilled();
-
-private:
-  std::span<hal::byte const> m_sequence;
-  std::span<hal::byte> m_buffer;
-  size_t m_fill_amount = 0;
-  size_t m_search_index = 0;
-};
-}  // namespace hal
+template<std::size_t Channel>
+void attach_channel()
+{
+  auto& can = hardware_map.can_channels[Channel];
+  auto& transceiver = *can.transceiver.value();
+  if (not channels[Channel].received_frames.attach(
+        transceiver.receive_buffer(), transceiver.receive_cursor())) {
+    // The platform's receive buffer is larger than this build was configured
+    // for, see CAN_OPENER_RECEIVE_DEPTH.
+    hal::halt();
+  }
+  can.interrupt.value()->on_receive(can_receive_handler<Channel>);
+  can.bus_manager.value()->on_bus_off(can_bus_off_handler<Channel>);
+}
+
+template<std::size_t... Channels>
+void attach_channels(std::index_sequence<Channels...>)
+{
+  (attach_channel<Channels>(), ...);
+}
 
 int main()
 {
@@ -506,65 +1562,80 @@ int main()
 
   auto& red_led = *hardware_map.red_led.value();
   auto& clock = *hardware_map.clock.value();
-  auto& console = *hardware_map.console.value();
-  auto& can = *hardware_map.can_transceiver.value();
-  auto& can_interrupt = *hardware_map.can_interrupt.value();
-  auto& can_bus_manager = *hardware_map.can_bus_manager.value();
-  auto& can_mask_filter = *hardware_map.can_mask_filter.value();
-
-  can_bus_manager.baud_rate(100_kHz);
-  can_mask_filter.allow(global_filter);
+  auto& serial_console = *hardware_map.console.value();
+
+  clock_frequency = static_cast<hal::u64>(clock.frequency());
+
+  for (std::size_t i = 0; i < channel_count; i++) {
+    auto& can = hardware_map.can_channels[i];
+    can.bus_manager.value()->baud_rate(100_kHz);
+    channels[i].hardware_filters = filter_banks{
+      .identifier = can.identifier_filters,
+      .extended_identifier = can.extended_identifier_filters,
+      .mask = can.mask_filters,
+      .extended_mask = can.extended_mask_filters,
+    };
+    apply_filters(channels[i]);
+  }
 
-  // List of commands
-  hal::stream_fill_upto_v2 find_end(hal::as_bytes("\r"sv), command_buffer);
+  command_parser parser(command_buffer);
+  console_writer console(serial_console,
+                         console_output_buffer,
+                         hardware_map.console_write_nonblocking);
 
-  auto reset_command_buffer = [&find_end]() {
-    command_buffer.fill(0U);
-    find_end = hal::stream_fill_upto_v2(hal::as_bytes("\r"sv), command_buffer);
-  };
+  attach_channels(std::make_index_sequence<channel_count>{});
 
-  can_interrupt.on_receive(can_receive_handler);
+  static std::array<hal::byte, 64> read_buffer{};
 
-  static std::array<hal::byte, 32> temporary_read_buffer{};
-  decltype(console.read(temporary_read_buffer).data) received_console_data{};
-  decltype(console.read(temporary_read_buffer).data | find_end) remainder{};
+  auto const has_work = [&serial_console, &console]() -> bool {
+    // Reading into an empty buffer only reports how many bytes are waiting
+    auto const console_bytes_available = serial_console.read({}).available;
+    if (console_bytes_available != 0 or not console.empty() or
+        capture_dump_offset.has_value()) {
+      return true;
+    }
+    // No interrupt fires when a cyclic message becomes due, so keep polling
+    // the clock while any are scheduled.
+    return std::ranges::any_of(channels, [](can_channel const& p_channel) {
+      return not p_channel.received_frames.empty() or
+             not p_channel.transmit_queue.empty() or
+             (bus_open and not p_channel.schedule.empty());
+    });
+  };
 
   while (true) {
-    if (not remainder.empty()) {
-      // Shove remainder back into find end and get the remainder
-      // from that. Continue until remainder is empty.
-      remainder = remainder | find_end;
-    } else {
-      received_console_data = console.read(temporary_read_buffer).data;
-      remainder = received_console_data | find_end;
-    }
+    auto const pass_start = clock.uptime();
 
-    if (hal::finished(find_end)) {
-      handle_command(
-        console, can_bus_manager, can_mask_filter, find_end.span());
+    // Handle every complete command in this read before moving on
+    parser.feed(serial_console.read(read_buffer).data);
+    while (auto const command = parser.next()) {
+      handle_command(console, *command);
       red_led.level(true);
     }
 
-    // hal::stream_fill_upto_v2 terminates
-    // Reset the find_end stream if it terminated:
-    // - Reached the end of the command buffer without finding a '\r'
-    // - Finished finding the '\r' before the end of the
-    if (hal::terminated(find_end)) {
-      reset_command_buffer();
-    }
+    apply_console_baud_rate(console, serial_console, clock);
+    queue_periodic_messages(clock);
 
-    if (not transmit_queue.empty()) {
-      const auto message = transmit_queue.pop_front();
-      can.send(message);
+    for (std::size_t i = 0; i < channel_count; i++) {
+      transmit_messages(channels[i], hardware_map.can_channels[i]);
     }
 
-    if (not receive_queue.empty()) {
-      const auto message = receive_queue.pop_front();
-      print_encoded_can_message(console, message);
-    }
+    monitor_bus_errors(console, clock);
+    forward_received_messages(console);
+    dump_capture(console);
+    console.drain();
+    console_writes.complete(console.bytes_written(), loop_trace, clock);
 
     red_led.level(false);
-    hal::delay(clock, 1ms);
+
+    // Time spent asleep waiting for work is not part of the pass
+    stats.record_pass(clock.uptime() - pass_start);
+
+    // Keep running passes until every queue is empty, then sleep until a CAN
+    // frame or console data arrives.
+    if (hardware_map.wait_for_work) {
+      (*hardware_map.wait_for_work)(has_work);
+    }
   }
 
   return 0;
@@ -580,68 +1651,3 @@ extern "C"
     }
   }
 }
-
-namespace hal {
-
-stream_fill_upto_v2::stream_fill_upto_v2(std::span<hal::byte const> p_sequence,
-                                         std::span<hal::byte> p_buffer)
-  : m_sequence(p_sequence)
-  , m_buffer(p_buffer)
-{
-}
-
-std::span<const hal::byte> operator|(
-  const std::span<const hal::byte>& p_input_data,
-  stream_fill_upto_v2& p_self)
-{
-  if (p_input_data.empty() or
-      p_self.m_sequence.size() == p_self.m_search_index or
-      p_self.m_buffer.empty()) {
-    return p_input_data;
-  }
-
-  auto remaining_buffer = p_self.unfilled();
-  auto min_size = std::min(p_input_data.size(), remaining_buffer.size());
-
-  for (size_t index = 0; index < min_size; index++) {
-    // Check if the search index is equal to the size of the sequence size
-    if (p_self.m_search_index == p_self.m_sequence.size()) {
-      p_self.m_fill_amount += index;
-      return p_input_data.subspan(index);
-    }
-
-    // Check if the next byte received matches the sequence
-    if (p_self.m_sequence[p_self.m_search_index] == p_input_data[index]) {
-      p_self.m_search_index++;
-    } else {  // Otherwise set the search index back to the start.
-      p_self.m_search_index = 0;
-    }
-
-    remaining_buffer[index] = p_input_data[index];
-  }
-
-  p_self.m_fill_amount += min_size;
-  return p_input_data.subspan(min_size);
-}
-
-work_state stream_fill_upto_v2::state()
-{
-  if (m_search_index == m_sequence.size()) {
-    return work_state::finished;
-  }
-  if (m_fill_amount == m_buffer.size()) {
-    return work_state::failed;
-  }
-  return work_state::in_progress;
-}
-
-std::span<hal::byte const> stream_fill_upto_v2::span()
-{
-  return m_buffer.subspan(0, m_fill_amount);
-}
-
-std::span<hal::byte> stream_fill_upto_v2::unfilled()
-{
-  return m_buffer.subspan(m_fill_amount);
-}
-}  // namespace hal
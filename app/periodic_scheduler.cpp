@@ -0,0 +1,141 @@
+// Copyright 2024 Khalil Estell
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <utility>
+
+#include <app/periodic_scheduler.hpp>
+
+bool periodic_scheduler::set(std::size_t p_slot,
+                             hal::can_message const& p_message,
+                             hal::u64 p_period,
+                             hal::u64 p_offset,
+                             hal::u64 p_now)
+{
+  if (p_slot >= slot_count or p_period == 0) {
+    return false;
+  }
+
+  auto& entry = m_slots[p_slot];
+  entry.message = p_message;
+  entry.period = p_period;
+  entry.due = p_now + p_offset;
+
+  if (entry.heap_index == not_in_heap) {
+    entry.heap_index = m_heap_size;
+    m_heap[m_heap_size++] = p_slot;
+  }
+
+  // The due time may have moved either way
+  sift_up(entry.heap_index);
+  sift_down(entry.heap_index);
+  return true;
+}
+
+bool periodic_scheduler::remove(std::size_t p_slot)
+{
+  if (p_slot >= slot_count or m_slots[p_slot].heap_index == not_in_heap) {
+    return false;
+  }
+
+  auto const index = m_slots[p_slot].heap_index;
+  auto const last = m_heap_size - 1;
+
+  swap_heap_entries(index, last);
+  m_heap_size--;
+  m_slots[p_slot].heap_index = not_in_heap;
+
+  if (index < m_heap_size) {
+    sift_up(index);
+    sift_down(index);
+  }
+  return true;
+}
+
+void periodic_scheduler::clear()
+{
+  for (auto& entry : m_slots) {
+    entry.heap_index = not_in_heap;
+  }
+  m_heap_size = 0;
+}
+
+std::optional<hal::can_message> periodic_scheduler::poll(hal::u64 p_now)
+{
+  if (m_heap_size == 0) {
+    return std::nullopt;
+  }
+
+  auto& entry = m_slots[m_heap[0]];
+  if (entry.due > p_now) {
+    return std::nullopt;
+  }
+
+  // Skip whole periods that were missed so the schedule stays in phase
+  auto const missed_periods = (p_now - entry.due) / entry.period;
+  entry.due += (missed_periods + 1) * entry.period;
+  sift_down(0);
+
+  return entry.message;
+}
+
+std::optional<hal::u64> periodic_scheduler::next_due() const
+{
+  if (m_heap_size == 0) {
+    return std::nullopt;
+  }
+  return m_slots[m_heap[0]].due;
+}
+
+void periodic_scheduler::swap_heap_entries(std::size_t p_a, std::size_t p_b)
+{
+  std::swap(m_heap[p_a], m_heap[p_b]);
+  m_slots[m_heap[p_a]].heap_index = p_a;
+  m_slots[m_heap[p_b]].heap_index = p_b;
+}
+
+void periodic_scheduler::sift_up(std::size_t p_index)
+{
+  while (p_index > 0) {
+    auto const parent = (p_index - 1) / 2;
+    if (m_slots[m_heap[parent]].due <= m_slots[m_heap[p_index]].due) {
+      return;
+    }
+    swap_heap_entries(parent, p_index);
+    p_index = parent;
+  }
+}
+
+void periodic_scheduler::sift_down(std::size_t p_index)
+{
+  while (true) {
+    auto const left = (p_index * 2) + 1;
+    auto const right = left + 1;
+    auto smallest = p_index;
+
+    if (left < m_heap_size and
+        m_slots[m_heap[left]].due < m_slots[m_heap[smallest]].due) {
+      smallest = left;
+    }
+    if (right < m_heap_size and
+        m_slots[m_heap[right]].due < m_slots[m_heap[smallest]].due) {
+      smallest = right;
+    }
+    if (smallest == p_index) {
+      return;
+    }
+
+    swap_heap_entries(p_index, smallest);
+    p_index = smallest;
+  }
+}
@@ -0,0 +1,90 @@
+// Copyright 2024 Khalil Estell
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <app/software_filter.hpp>
+
+bool software_filter::allow_standard(hal::u32 p_id)
+{
+  if (p_id > max_standard_id) {
+    return false;
+  }
+
+  m_standard[p_id / 32] |= 1U << (p_id % 32);
+  m_enabled = true;
+  return true;
+}
+
+bool software_filter::allow_extended(hal::u32 p_id)
+{
+  if (p_id > max_extended_id) {
+    return false;
+  }
+
+  auto slot = hash(p_id);
+  for (std::size_t i = 0; i < max_probes; i++) {
+    if (m_extended[slot] == p_id) {
+      return true;
+    }
+    if (m_extended[slot] == empty_slot) {
+      // Checked only now, so a full set still accepts IDs it already has
+      if (m_extended_count == extended_capacity) {
+        return false;
+      }
+      m_extended[slot] = p_id;
+      m_extended_count++;
+      m_enabled = true;
+      return true;
+    }
+    slot = (slot + 1) & slot_mask;
+  }
+
+  // Every slot within reach of a lookup is taken
+  return false;
+}
+
+bool software_filter::allow_standard_mask(hal::u32 p_id, hal::u32 p_mask)
+{
+  if (p_id > max_standard_id or p_mask > max_standard_id) {
+    return false;
+  }
+
+  for (hal::u32 id = 0; id <= max_standard_id; id++) {
+    if ((id & p_mask) == (p_id & p_mask)) {
+      m_standard[id / 32] |= 1U << (id % 32);
+    }
+  }
+  m_enabled = true;
+  return true;
+}
+
+bool software_filter::allow_extended_mask(hal::u32 p_id, hal::u32 p_mask)
+{
+  if (p_id > max_extended_id or p_mask > max_extended_id or
+      m_extended_mask_count == extended_mask_capacity) {
+    return false;
+  }
+
+  m_extended_masks[m_extended_mask_count++] = { .id = p_id, .mask = p_mask };
+  m_enabled = true;
+  return true;
+}
+
+void software_filter::clear()
+{
+  m_enabled = false;
+  m_standard.fill(0);
+  m_extended.fill(empty_slot);
+  m_extended_count = 0;
+  m_extended_mask_count = 0;
+}
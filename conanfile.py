@@ -13,6 +13,7 @@
 # limitations under the License.
 
 from conan import ConanFile
+from conan.tools.cmake import CMake
 
 required_conan_version = ">=2.0.14"
 
@@ -21,7 +22,51 @@ class demos(ConanFile):
     python_requires = "libhal-bootstrap/[^3.0.0]"
     python_requires_extend = "libhal-bootstrap.demo"
 
+    # Channel count and buffer sizes, trading RAM for burst tolerance on each
+    # board
+    options = {
+        "channels": ["ANY"],
+        "receive_depth": ["ANY"],
+        "transmit_depth": ["ANY"],
+        "capture_size": ["ANY"],
+        "trace": [True, False],
+    }
+    default_options = {
+        "channels": 1,
+        "receive_depth": 32,
+        "transmit_depth": 32,
+        "capture_size": 8192,
+        "trace": False,
+    }
+
+    def init(self):
+        base = self.python_requires["libhal-bootstrap"].module.demo
+        self.options.update(getattr(base, "options", {}),
+                            getattr(base, "default_options", {}))
+
     def requirements(self):
         bootstrap = self.python_requires["libhal-bootstrap"]
         bootstrap.module.add_demo_requirements(self)
-        self.requires("ring-span-lite/[^0.7.0]")
+        if str(self.options.platform) == "host":
+            # Platform libraries bring this in for boards, the host build
+            # links it directly
+            self.requires("libhal-exceptions/[^1.0.0]")
+
+    def build_requirements(self):
+        base = self.python_requires["libhal-bootstrap"].module.demo
+        if hasattr(base, "build_requirements"):
+            base.build_requirements(self)
+        if str(self.options.platform) == "host":
+            # Unit tests only run on the build machine
+            self.test_requires("boost-ext-ut/2.1.0")
+
+    def build(self):
+        cmake = CMake(self)
+        cmake.configure(variables={
+            "CAN_OPENER_CHANNELS": str(self.options.channels),
+            "CAN_OPENER_RECEIVE_DEPTH": str(self.options.receive_depth),
+            "CAN_OPENER_TRANSMIT_DEPTH": str(self.options.transmit_depth),
+            "CAN_OPENER_CAPTURE_SIZE": str(self.options.capture_size),
+            "CAN_OPENER_TRACE": "ON" if self.options.trace else "OFF",
+        })
+        cmake.build()
@@ -0,0 +1,189 @@
+// Copyright 2024 Khalil Estell
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <optional>
+#include <span>
+
+#include <libhal/can.hpp>
+#include <libhal/units.hpp>
+
+// Binary frame record layout. Fields follow each other in this order without
+// padding, so every field after the sequence number starts where the one
+// before it ends. Multi-byte fields are little endian.
+//
+//     sync       1 byte, always 0xA5, at offset 0
+//     flags      1 byte at offset 1: bit 0 extended, bit 1 remote request,
+//                bit 2 timestamp present, bit 3 channel present, bits 4 to 7
+//                payload length
+//     sequence   1 byte at offset 2
+//     channel    0 or 1 byte, the channel the frame was received on, only if
+//                the flag is set
+//     ID         2 bytes for standard frames or 4 bytes for extended frames,
+//                at offset 3 or 4 depending on the channel
+//     timestamp  0 or 4 bytes, microseconds, only if the flag is set
+//     payload    `length` bytes, absent for remote requests
+//
+// The sync byte never appears in an ASCII response ('\r' or BELL), so a host
+// can tell records and command responses apart on the same stream.
+constexpr hal::byte binary_frame_sync = 0xA5;
+constexpr hal::byte binary_frame_extended = 1 << 0;
+constexpr hal::byte binary_frame_remote_request = 1 << 1;
+constexpr hal::byte binary_frame_timestamp = 1 << 2;
+constexpr hal::byte binary_frame_channel = 1 << 3;
+constexpr std::size_t binary_frame_length_shift = 4;
+
+constexpr std::size_t binary_frame_header_size = 3;
+constexpr std::size_t max_binary_frame_size =
+  binary_frame_header_size + 1 + 4 + 4 + 8;
+
+struct binary_frame
+{
+  hal::can_message message{};
+  hal::u8 sequence = 0;
+  std::optional<hal::u32> timestamp{};
+  std::optional<hal::u8> channel{};
+};
+
+/**
+ * @brief Compute the size of a record from its flags byte
+ *
+ * @param p_flags - the flags byte of the record
+ * @return std::size_t - total size of the record in bytes
+ */
+constexpr std::size_t binary_frame_size(hal::byte p_flags)
+{
+  std::size_t size = binary_frame_header_size;
+  size += (p_flags & binary_frame_channel) ? 1 : 0;
+  size += (p_flags & binary_frame_extended) ? 4 : 2;
+  size += (p_flags & binary_frame_timestamp) ? 4 : 0;
+  if (not(p_flags & binary_frame_remote_request)) {
+    size += p_flags >> binary_frame_length_shift;
+  }
+  return size;
+}
+
+/**
+ * @brief Encode a CAN message into a binary frame record
+ *
+ * @param p_buffer - buffer to write the record into. Must be at least
+ * `max_binary_frame_size` bytes long.
+ * @param p_frame - message and record metadata to encode
+ * @return std::size_t - number of bytes written to the buffer
+ */
+inline std::size_t encode_binary_frame(std::span<hal::byte> p_buffer,
+                                       binary_frame const& p_frame)
+{
+  auto const& message = p_frame.message;
+  auto const length =
+    std::min<std::size_t>(message.length, message.payload.size());
+  auto* output = p_buffer.data();
+
+  hal::byte flags = length << binary_frame_length_shift;
+  if (message.extended()) {
+    flags |= binary_frame_extended;
+  }
+  if (message.remote_request()) {
+    flags |= binary_frame_remote_request;
+  }
+  if (p_frame.timestamp) {
+    flags |= binary_frame_timestamp;
+  }
+  if (p_frame.channel) {
+    flags |= binary_frame_channel;
+  }
+
+  *output++ = binary_frame_sync;
+  *output++ = flags;
+  *output++ = p_frame.sequence;
+  if (p_frame.channel) {
+    *output++ = *p_frame.channel;
+  }
+
+  auto const write_u32 = [&output](hal::u32 p_value, std::size_t p_bytes) {
+    for (std::size_t i = 0; i < p_bytes; i++) {
+      *output++ = (p_value >> (i * 8)) & 0xFF;
+    }
+  };
+
+  write_u32(message.id(), message.extended() ? 4 : 2);
+
+  if (p_frame.timestamp) {
+    write_u32(*p_frame.timestamp, 4);
+  }
+
+  if (not message.remote_request()) {
+    output = std::copy_n(message.payload.begin(), length, output);
+  }
+
+  return output - p_buffer.data();
+}
+
+/**
+ * @brief Decode a binary frame record
+ *
+ * @param p_data - data starting with the record's sync byte
+ * @return std::optional<binary_frame> - the decoded record or std::nullopt if
+ * the data does not start with a sync byte, is shorter than the record or has
+ * an invalid payload length.
+ */
+inline std::optional<binary_frame> decode_binary_frame(
+  std::span<hal::byte const> p_data)
+{
+  if (p_data.size() < binary_frame_header_size or
+      p_data[0] != binary_frame_sync) {
+    return std::nullopt;
+  }
+
+  auto const flags = p_data[1];
+  std::size_t const length = flags >> binary_frame_length_shift;
+  if (length > 8 or p_data.size() < binary_frame_size(flags)) {
+    return std::nullopt;
+  }
+
+  binary_frame frame{};
+  auto& message = frame.message;
+  frame.sequence = p_data[2];
+  message.extended(flags & binary_frame_extended);
+  message.remote_request(flags & binary_frame_remote_request);
+  message.length = length;
+
+  auto const* input = &p_data[binary_frame_header_size];
+  auto const read_u32 = [&input](std::size_t p_bytes) {
+    hal::u32 value = 0;
+    for (std::size_t i = 0; i < p_bytes; i++) {
+      value |= hal::u32{ *input++ } << (i * 8);
+    }
+    return value;
+  };
+
+  if (flags & binary_frame_channel) {
+    frame.channel = *input++;
+  }
+
+  message.id(read_u32(message.extended() ? 4 : 2));
+
+  if (flags & binary_frame_timestamp) {
+    frame.timestamp = read_u32(4);
+  }
+
+  if (not message.remote_request()) {
+    std::copy_n(input, length, message.payload.begin());
+  }
+
+  return frame;
+}
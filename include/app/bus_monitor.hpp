@@ -0,0 +1,181 @@
+// Copyright 2024 Khalil Estell
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <optional>
+
+#include <libhal/units.hpp>
+
+#include <app/statistics.hpp>
+
+/**
+ * @brief Error counters of a CAN controller, as read by the platform
+ */
+struct can_error_state
+{
+  /// Transmit error counter (TEC)
+  hal::u8 transmit_errors = 0;
+  /// Receive error counter (REC)
+  hal::u8 receive_errors = 0;
+  /// Set while the controller is bus off
+  bool bus_off = false;
+  /// Arbitration losses since start up, wraps around
+  hal::u32 arbitration_losses = 0;
+  /// Bit, stuff, form, CRC and acknowledge errors since start up, wraps around
+  hal::u32 bus_errors = 0;
+};
+
+/**
+ * @brief Fault confinement state of a CAN controller
+ */
+enum class controller_state : hal::u8
+{
+  /// Both error counters below the warning limit
+  error_active = 0,
+  /// An error counter at or above the warning limit of 96
+  error_warning = 1,
+  /// An error counter above 127, the controller only sends passive error flags
+  error_passive = 2,
+  /// The transmit error counter went past 255, the controller left the bus
+  bus_off = 3,
+};
+
+// SJA1000 interrupt flags reported by the 'F' command
+constexpr hal::u8 error_warning_flag = 1 << 2;
+constexpr hal::u8 error_passive_flag = 1 << 5;
+constexpr hal::u8 arbitration_lost_flag = 1 << 6;
+constexpr hal::u8 bus_error_flag = 1 << 7;
+
+/**
+ * @brief Change in a controller's error state, streamed after 'E1'
+ */
+struct error_event
+{
+  controller_state state = controller_state::error_active;
+  hal::u8 transmit_errors = 0;
+  hal::u8 receive_errors = 0;
+  /// Arbitration losses since the previous event
+  hal::u32 arbitration_losses = 0;
+  /// Bus errors since the previous event
+  hal::u32 bus_errors = 0;
+};
+
+/**
+ * @brief Follows the error state of one CAN controller
+ *
+ * Tracks the controller through error active, error warning, error passive
+ * and bus off, and latches the SJA1000 interrupt flags: error warning (EI) on
+ * any change of the error or bus status, error passive (EPI) on entering
+ * error passive or leaving it for error active, and arbitration lost (ALI) and
+ * bus error (BEI) whenever their counters move.
+ *
+ * Platforms that cannot read the error counters still report bus off through
+ * the bus manager. For those only bus off and its recovery are tracked.
+ */
+class bus_monitor
+{
+public:
+  static constexpr hal::u8 warning_limit = 96;
+  static constexpr hal::u8 passive_limit = 128;
+
+  /// Note that the controller went bus off, may be called from an interrupt
+  void bus_off()
+  {
+    m_bus_off_count.increment();
+  }
+
+  /**
+   * @brief Fold in the controller's latest state, once per main loop pass
+   *
+   * @param p_state - the controller's error counters, or std::nullopt if the
+   * platform cannot read them
+   * @return true - the controller went bus off since the last update and bus
+   * off recovery should be started
+   * @return false - the controller did not go bus off
+   */
+  bool update(std::optional<can_error_state> const& p_state);
+
+  /**
+   * @brief Note that bus off recovery was started
+   *
+   * Without error counters to tell otherwise, the controller is taken to be
+   * error active again.
+   */
+  void recovering();
+
+  /**
+   * @brief Read the latched status flags and clear them
+   *
+   * @return hal::u8 - `*_flag` bits set since the last call
+   */
+  hal::u8 take_flags();
+
+  /**
+   * @brief Start a new series of events from the current counters
+   *
+   * @param p_milliseconds - current time, may wrap around
+   */
+  void restart_events(hal::u32 p_milliseconds);
+
+  /**
+   * @brief Take the next error event to stream, if one is due
+   *
+   * An event is due as soon as the controller state changes. While only the
+   * counters move, at most one event is due per interval. Going bus off is
+   * always reported, even when recovering() already moved the state on in
+   * the same pass. The recovery then follows as the next event.
+   *
+   * @param p_milliseconds - current time, may wrap around
+   * @param p_interval - least milliseconds between two events that only
+   * report counter changes
+   * @return std::optional<error_event> - the event, or std::nullopt if none
+   * is due
+   */
+  std::optional<error_event> take_event(hal::u32 p_milliseconds,
+                                        hal::u32 p_interval);
+
+  controller_state state() const
+  {
+    return m_state;
+  }
+
+  /// The last counters read, all zero if the platform cannot read them
+  can_error_state const& counters() const
+  {
+    return m_counters;
+  }
+
+  /// Times the controller went bus off
+  hal::u32 bus_off_count() const
+  {
+    return m_bus_off_count.value();
+  }
+
+private:
+  bool enter(controller_state p_state);
+
+  event_counter m_bus_off_count;
+  hal::u32 m_bus_off_seen = 0;
+  controller_state m_state = controller_state::error_active;
+  bool m_readable = false;
+  can_error_state m_counters{};
+  hal::u8 m_flags = 0;
+  bool m_state_changed = false;
+  // Set when the controller goes bus off, until an event reports it
+  bool m_bus_off_unreported = false;
+  // Counters as of the last streamed event
+  can_error_state m_reported{};
+  hal::u32 m_last_event = 0;
+};
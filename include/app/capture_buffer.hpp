@@ -0,0 +1,347 @@
+// Copyright 2024 Khalil Estell
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <span>
+
+#include <libhal/can.hpp>
+#include <libhal/units.hpp>
+
+enum class capture_state : hal::u8
+{
+  /// Nothing has been armed since startup
+  idle = 0,
+  /// Recording the pre-trigger window and waiting for the trigger
+  armed = 1,
+  /// Recording the post-trigger window
+  triggered = 2,
+  /// Stopped, the recording can be read
+  done = 3,
+};
+
+/**
+ * @brief Condition that triggers a capture
+ *
+ * A frame matches when its key, the ID with bit 31 set for extended frames,
+ * matches `key` in the bits set in `key_mask`, and every payload bit set in
+ * `data_mask` matches `data`. Frames too short to hold a masked payload byte
+ * do not match. Clearing every mask triggers on the first frame.
+ */
+struct capture_trigger
+{
+  hal::u32 key = 0;
+  hal::u32 key_mask = 0;
+  std::array<hal::byte, 8> data{};
+  std::array<hal::byte, 8> data_mask{};
+
+  bool matches(hal::can_message const& p_message) const
+  {
+    auto const key_bits =
+      p_message.id() | (p_message.extended() ? 1U << 31 : 0U);
+    if ((key_bits ^ key) & key_mask) {
+      return false;
+    }
+
+    for (std::size_t i = 0; i < data.size(); i++) {
+      if (data_mask[i] == 0) {
+        continue;
+      }
+      if (p_message.remote_request() or i >= p_message.length or
+          ((p_message.payload[i] ^ data[i]) & data_mask[i])) {
+        return false;
+      }
+    }
+    return true;
+  }
+};
+
+/**
+ * @brief Size of a capture record from its header byte
+ *
+ * Records are packed back to back without padding:
+ *
+ *   | Field   | Size    | Description                                       |
+ *   | ------- | ------- | ------------------------------------------------- |
+ *   | Header  | 1       | Bits 0-3 length, bit 4 extended, bit 5 remote     |
+ *   |         |         | request, bits 6-7 timestamp delta size minus 1.   |
+ *   | Delta   | 1 to 4  | Microseconds since the previous record.           |
+ *   | ID      | 2 or 4  | 2 bytes for standard frames, 4 for extended.      |
+ *   | Payload | 0 to 8  | Absent for remote requests.                       |
+ *
+ * Multi-byte fields are little endian.
+ *
+ * @param p_header - first byte of the record
+ * @return std::size_t - size of the whole record in bytes
+ */
+constexpr std::size_t capture_record_size(hal::byte p_header)
+{
+  std::size_t const length = p_header & 0xF;
+  bool const extended = p_header & (1 << 4);
+  bool const remote_request = p_header & (1 << 5);
+  std::size_t const delta_size = (p_header >> 6) + 1;
+
+  return 1 + delta_size + (extended ? 4 : 2) + (remote_request ? 0 : length);
+}
+
+/**
+ * @brief Records received frames around a trigger into a byte ring
+ *
+ * Once armed, frames are recorded continuously. Before the trigger, the
+ * oldest records are dropped to keep at most the pre-trigger count. After the
+ * trigger, recording stops once the post-trigger count is reached or the ring
+ * is full. Records are variable length with delta coded timestamps, so small
+ * frames arriving close together take only a few bytes each.
+ *
+ * `record()` may be called from an interrupt while the main loop arms or
+ * stops the capture. The recording may only be read once the state is done.
+ *
+ * @tparam Size - bytes of record storage, must be a power of two
+ */
+template<std::size_t Size>
+class capture_buffer
+{
+public:
+  static_assert(Size != 0 and (Size & (Size - 1)) == 0,
+                "capture_buffer size must be a power of two");
+
+  /// Sentinel for the trigger index when the trigger never fired
+  static constexpr hal::u32 no_trigger = 0xFFFF'FFFF;
+
+  /**
+   * @brief Discard the recording and start a new one
+   *
+   * @param p_trigger - condition that triggers the capture
+   * @param p_pre_trigger - records to keep from before the trigger
+   * @param p_post_trigger - records to capture after the trigger record
+   */
+  void arm(capture_trigger const& p_trigger,
+           hal::u32 p_pre_trigger,
+           hal::u32 p_post_trigger)
+  {
+    // Stop the recording before changing it under the interrupt
+    m_state.store(capture_state::done, std::memory_order_release);
+
+    m_trigger = p_trigger;
+    m_pre_trigger = p_pre_trigger;
+    m_post_remaining = p_post_trigger;
+    m_head = 0;
+    m_tail = 0;
+    m_records = 0;
+    m_trigger_index = no_trigger;
+    m_base_time = 0;
+    m_last_time = 0;
+
+    m_state.store(capture_state::armed, std::memory_order_release);
+  }
+
+  /**
+   * @brief Stop recording, keeping what has been recorded so far
+   */
+  void stop()
+  {
+    if (m_state.load(std::memory_order_acquire) != capture_state::idle) {
+      m_state.store(capture_state::done, std::memory_order_release);
+    }
+  }
+
+  /**
+   * @brief Record a received frame if a capture is running
+   *
+   * @param p_message - received message
+   * @param p_microseconds - time the message was received
+   */
+  void record(hal::can_message const& p_message, hal::u64 p_microseconds)
+  {
+    if (not recording()) {
+      return;
+    }
+    auto current = m_state.load(std::memory_order_relaxed);
+
+    bool const trigger =
+      current == capture_state::armed and m_trigger.matches(p_message);
+
+    if (m_records == 0) {
+      m_base_time = p_microseconds;
+      m_last_time = p_microseconds;
+    }
+
+    // Gaps longer than 71 minutes are recorded as the longest delta
+    auto const delta =
+      std::min<hal::u64>(p_microseconds - m_last_time, 0xFFFF'FFFF);
+    hal::u8 delta_size = 1;
+    while (delta_size < 4 and (delta >> (delta_size * 8)) != 0) {
+      delta_size++;
+    }
+    auto const length = std::min<hal::u8>(p_message.length, 8);
+
+    hal::byte const header = length | (p_message.extended() << 4) |
+                             (p_message.remote_request() << 5) |
+                             ((delta_size - 1) << 6);
+    auto const size = capture_record_size(header);
+
+    while (Size - (m_head - m_tail) < size) {
+      // Records are only dropped before the trigger, so the trigger record
+      // and everything after it are kept.
+      if (current == capture_state::triggered) {
+        m_state.store(capture_state::done, std::memory_order_release);
+        return;
+      }
+      drop_oldest();
+    }
+
+    put(header);
+    put_le(delta, delta_size);
+    put_le(p_message.id(), p_message.extended() ? 4 : 2);
+    if (not p_message.remote_request()) {
+      for (std::size_t i = 0; i < length; i++) {
+        put(p_message.payload[i]);
+      }
+    }
+    m_last_time = p_microseconds;
+    m_records++;
+
+    if (current == capture_state::armed and not trigger) {
+      while (m_records > m_pre_trigger) {
+        drop_oldest();
+      }
+      return;
+    }
+
+    if (trigger) {
+      m_trigger_index = m_records - 1;
+      current = capture_state::triggered;
+      m_state.store(current, std::memory_order_release);
+      finish_if_complete();
+      return;
+    }
+
+    m_post_remaining--;
+    finish_if_complete();
+  }
+
+  capture_state state() const
+  {
+    return m_state.load(std::memory_order_acquire);
+  }
+
+  /// True while frames passed to record() are being recorded
+  bool recording() const
+  {
+    auto const current = m_state.load(std::memory_order_acquire);
+    return current == capture_state::armed or
+           current == capture_state::triggered;
+  }
+
+  /// Bytes of records currently held
+  std::size_t size() const
+  {
+    return m_head - m_tail;
+  }
+
+  /// Number of records currently held
+  hal::u32 records() const
+  {
+    return m_records;
+  }
+
+  /// Index of the trigger record, or no_trigger if it never fired. Only valid
+  /// once a capture has been armed.
+  hal::u32 trigger_index() const
+  {
+    return m_trigger_index;
+  }
+
+  /// Time that the first record's delta is relative to, in microseconds
+  hal::u64 base_time() const
+  {
+    return m_base_time;
+  }
+
+  /**
+   * @brief Copy recorded bytes out of the ring
+   *
+   * Only valid once the state is done.
+   *
+   * @param p_offset - offset into the recording
+   * @param p_output - where to copy the bytes
+   * @return std::size_t - number of bytes copied
+   */
+  std::size_t read(std::size_t p_offset, std::span<hal::byte> p_output) const
+  {
+    auto const available = size() - std::min(p_offset, size());
+    auto const count = std::min(available, p_output.size());
+    for (std::size_t i = 0; i < count; i++) {
+      p_output[i] = m_buffer[(m_tail + p_offset + i) & mask];
+    }
+    return count;
+  }
+
+private:
+  static constexpr std::size_t mask = Size - 1;
+
+  void put(hal::byte p_byte)
+  {
+    m_buffer[m_head++ & mask] = p_byte;
+  }
+
+  void put_le(hal::u64 p_value, std::size_t p_bytes)
+  {
+    for (std::size_t i = 0; i < p_bytes; i++) {
+      put(static_cast<hal::byte>(p_value >> (i * 8)));
+    }
+  }
+
+  void drop_oldest()
+  {
+    auto const header = m_buffer[m_tail & mask];
+    std::size_t const delta_size = (header >> 6) + 1;
+
+    // The next record's delta now counts from the dropped record's time
+    hal::u64 delta = 0;
+    for (std::size_t i = 0; i < delta_size; i++) {
+      delta |= hal::u64{ m_buffer[(m_tail + 1 + i) & mask] } << (i * 8);
+    }
+    m_base_time += delta;
+
+    m_tail += capture_record_size(header);
+    m_records--;
+  }
+
+  void finish_if_complete()
+  {
+    if (m_post_remaining == 0) {
+      m_state.store(capture_state::done, std::memory_order_release);
+    }
+  }
+
+  std::array<hal::byte, Size> m_buffer{};
+  std::atomic<capture_state> m_state = capture_state::idle;
+  capture_trigger m_trigger{};
+  hal::u32 m_pre_trigger = 0;
+  hal::u32 m_post_remaining = 0;
+  // Free running byte offsets of the newest and oldest records
+  std::size_t m_head = 0;
+  std::size_t m_tail = 0;
+  hal::u32 m_records = 0;
+  // Set by arm(). Every member starts out zero so that the buffer is placed in
+  // .bss rather than copied from flash at startup.
+  hal::u32 m_trigger_index = 0;
+  hal::u64 m_base_time = 0;
+  hal::u64 m_last_time = 0;
+};
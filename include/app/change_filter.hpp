@@ -0,0 +1,88 @@
+// Copyright 2024 Khalil Estell
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <array>
+#include <cstddef>
+
+#include <libhal/can.hpp>
+#include <libhal/units.hpp>
+
+/**
+ * @brief Suppresses frames whose contents have not changed
+ *
+ * Keeps the last forwarded length and payload of each CAN ID in a fixed size
+ * open addressing table. A frame is forwarded when its ID is new, its length
+ * or payload differ from the last forwarded frame with that ID, or the keep
+ * alive interval has passed since that frame was forwarded.
+ *
+ * IDs that don't fit into the table are always forwarded. Remote requests
+ * carry no payload and are always forwarded.
+ */
+class change_filter
+{
+public:
+  static constexpr std::size_t capacity = 128;
+  static constexpr std::size_t max_probes = 16;
+
+  /**
+   * @brief Decide whether a frame should be forwarded
+   *
+   * @param p_message - received message
+   * @param p_milliseconds - time the message was received. Only differences
+   * between times are used, so it may wrap around.
+   * @return true - forward the frame, the cache now holds its contents
+   * @return false - the frame is a repeat, it was counted as suppressed
+   */
+  bool should_forward(hal::can_message const& p_message,
+                      hal::u32 p_milliseconds);
+
+  /**
+   * @brief Forget every cached frame and reset the counters
+   *
+   * @param p_keep_alive - milliseconds after which an unchanged frame is
+   * forwarded again, 0 to never forward unchanged frames.
+   */
+  void reset(hal::u32 p_keep_alive);
+
+  /// Frames not forwarded because they had not changed
+  hal::u32 suppressed() const
+  {
+    return m_suppressed;
+  }
+
+  /// Frames forwarded because their ID did not fit into the table
+  hal::u32 untracked() const
+  {
+    return m_untracked;
+  }
+
+private:
+  // IDs are at most 29 bits, so this can never be a valid key
+  static constexpr hal::u32 empty_key = 0xFFFF'FFFF;
+
+  struct entry
+  {
+    hal::u32 key = empty_key;
+    hal::u32 forwarded_at = 0;
+    std::array<hal::byte, 8> payload{};
+    hal::u8 length = 0;
+  };
+
+  std::array<entry, capacity> m_entries{};
+  hal::u32 m_keep_alive = 0;
+  hal::u32 m_suppressed = 0;
+  hal::u32 m_untracked = 0;
+};
@@ -0,0 +1,84 @@
+// Copyright 2024 Khalil Estell
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <optional>
+#include <span>
+
+#include <libhal/units.hpp>
+
+/**
+ * @brief Splits console data into '\r' terminated commands
+ *
+ * Commands that arrive complete within a single read are returned as spans
+ * directly into the read data without being copied. Only a command that is
+ * split across reads has its leading part copied into the partial buffer,
+ * where it is completed once the rest arrives.
+ *
+ * Usage:
+ *
+ *     parser.feed(console.read(read_buffer).data);
+ *     while (auto const command = parser.next()) {
+ *       handle_command(*command);
+ *     }
+ */
+class command_parser
+{
+public:
+  /**
+   * @brief Construct a new command parser
+   *
+   * @param p_partial_buffer - storage for a command split across reads. Its
+   * size is the longest command (including the '\r') that can be parsed.
+   */
+  explicit command_parser(std::span<hal::byte> p_partial_buffer);
+
+  /**
+   * @brief Provide the next chunk of console data
+   *
+   * The data is not copied. It must outlive the calls to `next()` that follow
+   * and every command those calls return. All commands from the previous chunk
+   * must have been consumed via `next()` before feeding another chunk.
+   *
+   * @param p_data - data read from the console
+   */
+  void feed(std::span<hal::byte const> p_data);
+
+  /**
+   * @brief Get the next complete command
+   *
+   * A command longer than the partial buffer is discarded up to and including
+   * its '\r' and is returned as an empty span, so the caller can reject it.
+   *
+   * @return std::optional<std::span<hal::byte const>> - the next command,
+   * including its '\r' terminator, or std::nullopt once the fed data has no
+   * more complete commands. The span is valid until the next call to `next()`
+   * or `feed()`.
+   */
+  std::optional<std::span<hal::byte const>> next();
+
+  /**
+   * @return true - the data fed in still has unreturned commands
+   */
+  bool pending() const;
+
+private:
+  void store_partial(std::span<hal::byte const> p_data);
+
+  std::span<hal::byte> m_buffer;
+  std::span<hal::byte const> m_input{};
+  std::size_t m_length = 0;
+  bool m_overflowed = false;
+};
@@ -0,0 +1,55 @@
+// Copyright 2024 Khalil Estell
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <cstddef>
+
+// Buffer sizes are set per board by the build, see the CAN_OPENER_* CMake
+// cache variables and the matching conan options. The defaults here only
+// apply when building without them.
+
+#ifndef CAN_OPENER_CHANNELS
+#define CAN_OPENER_CHANNELS 1
+#endif
+
+#ifndef CAN_OPENER_RECEIVE_DEPTH
+#define CAN_OPENER_RECEIVE_DEPTH 32
+#endif
+
+#ifndef CAN_OPENER_TRANSMIT_DEPTH
+#define CAN_OPENER_TRANSMIT_DEPTH 32
+#endif
+
+#ifndef CAN_OPENER_CAPTURE_SIZE
+#define CAN_OPENER_CAPTURE_SIZE 8192
+#endif
+
+#ifndef CAN_OPENER_TRACE_DEPTH
+#define CAN_OPENER_TRACE_DEPTH 0
+#endif
+
+/// CAN controllers served, each with its own queues, baud rate and filters
+constexpr std::size_t channel_count = CAN_OPENER_CHANNELS;
+/// CAN frames each transceiver's receive buffer holds
+constexpr std::size_t receive_depth = CAN_OPENER_RECEIVE_DEPTH;
+/// CAN frames waiting to be transmitted on each channel
+constexpr std::size_t transmit_depth = CAN_OPENER_TRANSMIT_DEPTH;
+/// Bytes of RAM for triggered captures, must be a power of two
+constexpr std::size_t capture_size = CAN_OPENER_CAPTURE_SIZE;
+/// Latency trace events kept per context, 0 compiles tracing out
+constexpr std::size_t trace_depth = CAN_OPENER_TRACE_DEPTH;
+
+static_assert(channel_count >= 1 and channel_count <= 10,
+              "Channels are numbered with a single decimal digit");
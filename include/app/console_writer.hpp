@@ -0,0 +1,122 @@
+// Copyright 2024 Khalil Estell
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <cstddef>
+#include <optional>
+#include <span>
+
+#include <libhal/functional.hpp>
+#include <libhal/serial.hpp>
+#include <libhal/units.hpp>
+
+/**
+ * @brief Buffers console output and drains it without stalling the main loop
+ *
+ * Output is queued into a ring buffer and drained a little at a time by
+ * calling `drain()` once per loop pass.
+ *
+ * If the platform provides a non-blocking write, it is handed as much data as
+ * it will take each time. Otherwise every pending byte is written to the
+ * console directly, in one blocking write per contiguous region of the
+ * buffer. A pass is then held up for as long as the serial port takes to send
+ * the output queued since the previous pass.
+ *
+ * Full buffer policy:
+ *
+ * - `try_write()` is all or nothing and never blocks. Forwarded frames use
+ *   it, a frame that doesn't fit is left in the receive queue.
+ * - `write()` blocks, draining the buffer until the data fits. Command
+ *   responses use it, as the host waits on them and they must not be lost.
+ */
+class console_writer
+{
+public:
+  using nonblocking_write =
+    hal::callback<std::size_t(std::span<hal::byte const>)>;
+
+  /**
+   * @brief Construct a new console writer
+   *
+   * @param p_console - console to write to when there is no non-blocking write
+   * @param p_buffer - ring buffer storage for pending output
+   * @param p_nonblocking_write - optional platform non-blocking write. Returns
+   * the number of bytes accepted which may be fewer than provided.
+   */
+  console_writer(hal::serial& p_console,
+                 std::span<hal::byte> p_buffer,
+                 std::optional<nonblocking_write> p_nonblocking_write);
+
+  /**
+   * @brief Queue data only if all of it fits
+   *
+   * @param p_data - data to queue
+   * @return true - the data was queued
+   * @return false - not enough space, nothing was queued
+   */
+  bool try_write(std::span<hal::byte const> p_data);
+
+  /**
+   * @brief Queue data, draining the buffer synchronously until it fits
+   *
+   * @param p_data - data to queue
+   */
+  void write(std::span<hal::byte const> p_data);
+
+  /**
+   * @brief Push some of the pending output out to the console
+   *
+   * Never blocks when a non-blocking write is available, otherwise blocks
+   * until all pending output has been written.
+   */
+  void drain();
+
+  /**
+   * @brief Block until all pending output has been handed to the console
+   */
+  void flush();
+
+  std::size_t free_space() const;
+  bool empty() const;
+
+  /**
+   * @return hal::u32 - bytes handed to the console so far. Wraps around on
+   * overflow.
+   */
+  hal::u32 bytes_written() const
+  {
+    return m_bytes_written;
+  }
+
+  /**
+   * @return hal::u32 - bytes_written() once everything queued so far has been
+   * handed to the console
+   */
+  hal::u32 bytes_queued() const
+  {
+    return m_bytes_written + m_size;
+  }
+
+private:
+  void push(std::span<hal::byte const> p_data);
+  void consume(std::size_t p_amount);
+
+  hal::serial* m_console;
+  std::span<hal::byte> m_buffer;
+  std::optional<nonblocking_write> m_nonblocking_write;
+  std::size_t m_read_index = 0;
+  std::size_t m_size = 0;
+  hal::u32 m_bytes_written = 0;
+};
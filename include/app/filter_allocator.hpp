@@ -0,0 +1,99 @@
+// Copyright 2024 Khalil Estell
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <cstddef>
+#include <optional>
+#include <span>
+
+#include <libhal/can.hpp>
+#include <libhal/units.hpp>
+
+#include <app/software_filter.hpp>
+
+/**
+ * @brief A frame acceptance rule
+ *
+ */
+struct filter_rule
+{
+  hal::u32 id = 0;
+  /// Bits of the ID that must match, a 1 bit must match
+  hal::u32 mask = 0;
+  bool extended = false;
+};
+
+/**
+ * @brief Hardware filter banks available to the allocator
+ *
+ * A frame is accepted if any enabled bank accepts it.
+ */
+struct filter_banks
+{
+  std::span<hal::can_identifier_filter* const> identifier{};
+  std::span<hal::can_extended_identifier_filter* const> extended_identifier{};
+  std::span<hal::can_mask_filter* const> mask{};
+  std::span<hal::can_extended_mask_filter* const> extended_mask{};
+};
+
+struct filter_allocation
+{
+  /// Rules with a hardware bank of their own
+  std::size_t hardware_rules = 0;
+  /// Rules that did not fit into hardware and are enforced in software
+  std::size_t software_rules = 0;
+};
+
+/**
+ * @brief Compile a set of rules onto hardware filter banks
+ *
+ * Each rule gets the cheapest bank that can express it. Mask rules can only
+ * use mask banks, so they are placed first. Exact ID rules then take the
+ * identifier banks, followed by whatever mask banks are left. Banks that end
+ * up unused are disabled.
+ *
+ * Rules that don't fit spill over to the software filter. The last mask bank
+ * of that frame type is then set to the narrowest ID/mask pair covering every
+ * spilled rule, so the hardware still rejects what it can. If there is no
+ * mask bank of that frame type, the first extended mask bank is opened up to
+ * accept everything. Like the Lawicel acceptance registers it holds, that
+ * bank with a zero mask is expected to accept standard frames too, so it also
+ * serves standard rules on platforms without standard mask banks. Whenever
+ * rules spill, the software filter is loaded with every rule, as the covering
+ * pair lets through more than the rules allow.
+ *
+ * The banks and the software filter are programmed one at a time while the
+ * controller keeps receiving, so the caller must reject received frames until
+ * this returns successfully.
+ *
+ * @param p_rules - rules to compile, must not be empty
+ * @param p_banks - hardware filter banks to program
+ * @param p_software - software filter, cleared and loaded if rules spill
+ * @return std::optional<filter_allocation> - where the rules ended up or
+ * std::nullopt if the software filter could not hold the rules, or rules
+ * spilled on a platform whose banks cannot be opened up. The filters are then
+ * left in an unspecified state.
+ */
+std::optional<filter_allocation> allocate_filters(
+  std::span<filter_rule const> p_rules,
+  filter_banks const& p_banks,
+  software_filter& p_software);
+
+/**
+ * @brief Disable every hardware filter bank
+ *
+ * @param p_banks - hardware filter banks to disable
+ */
+void disable_filters(filter_banks const& p_banks);
@@ -0,0 +1,112 @@
+// Copyright 2024 Khalil Estell
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <optional>
+
+#include <libhal/can.hpp>
+#include <libhal/units.hpp>
+
+/**
+ * @brief Schedules cyclic CAN messages
+ *
+ * Each slot holds a message that is due every `period` microseconds. Active
+ * slots are kept in a binary min-heap ordered by their next due time, so
+ * finding the next due message is O(1) and rescheduling it is O(log n).
+ *
+ * Due times advance by whole periods from the first due time rather than from
+ * when the message was actually sent, so lateness in one cycle does not
+ * accumulate into the next. If a message falls more than a period behind, the
+ * missed cycles are skipped rather than sent in a burst.
+ */
+class periodic_scheduler
+{
+public:
+  static constexpr std::size_t slot_count = 64;
+
+  /**
+   * @brief Add or replace the message in a slot
+   *
+   * @param p_slot - slot to set
+   * @param p_message - message to send
+   * @param p_period - microseconds between sends, must not be 0
+   * @param p_offset - microseconds from now until the first send
+   * @param p_now - current time in microseconds
+   * @return true - the slot was set
+   * @return false - the slot or period is out of range
+   */
+  bool set(std::size_t p_slot,
+           hal::can_message const& p_message,
+           hal::u64 p_period,
+           hal::u64 p_offset,
+           hal::u64 p_now);
+
+  /**
+   * @brief Stop sending the message in a slot
+   *
+   * @param p_slot - slot to remove
+   * @return true - the slot was active and has been removed
+   */
+  bool remove(std::size_t p_slot);
+
+  /**
+   * @brief Stop sending every message
+   */
+  void clear();
+
+  /**
+   * @brief Get the next message that is due
+   *
+   * The returned message is rescheduled for its next period.
+   *
+   * @param p_now - current time in microseconds
+   * @return std::optional<hal::can_message> - a due message or std::nullopt if
+   * none are due yet
+   */
+  std::optional<hal::can_message> poll(hal::u64 p_now);
+
+  /**
+   * @return std::optional<hal::u64> - time the next message is due or
+   * std::nullopt if there are no messages scheduled
+   */
+  std::optional<hal::u64> next_due() const;
+
+  bool empty() const
+  {
+    return m_heap_size == 0;
+  }
+
+private:
+  static constexpr hal::u8 not_in_heap = 0xFF;
+
+  struct slot
+  {
+    hal::can_message message{};
+    hal::u64 period = 0;
+    hal::u64 due = 0;
+    hal::u8 heap_index = not_in_heap;
+  };
+
+  void swap_heap_entries(std::size_t p_a, std::size_t p_b);
+  void sift_up(std::size_t p_index);
+  void sift_down(std::size_t p_index);
+
+  std::array<slot, slot_count> m_slots{};
+  // Slot numbers ordered as a min-heap on their due time
+  std::array<hal::u8, slot_count> m_heap{};
+  std::size_t m_heap_size = 0;
+};
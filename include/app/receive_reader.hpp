@@ -0,0 +1,226 @@
+// Copyright 2024 Khalil Estell
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <optional>
+#include <span>
+
+#include <libhal/can.hpp>
+#include <libhal/units.hpp>
+
+// A received message along with the uptime clock ticks when it arrived
+struct received_message
+{
+  hal::can_message message;
+  hal::u64 uptime;
+  // Position of the frame in the sequence of every frame received
+  hal::u32 index;
+};
+
+/**
+ * @brief Reads received frames straight out of the transceiver's buffer
+ *
+ * The transceiver already keeps received frames in a circular buffer, so
+ * rather than copying each frame into a second queue, the receive interrupt
+ * only records the time each frame arrived and whether it passed the
+ * acceptance filter, in arrays parallel to the transceiver's buffer. The main
+ * loop then copies frames out of the transceiver's buffer once, as it
+ * forwards them.
+ *
+ * This relies on the transceiver writing every frame into the next slot of
+ * its buffer before calling the receive interrupt handler for it.
+ *
+ * The transceiver writes a frame into the slot of the frame a buffer before it
+ * and only then reports it, so once a whole buffer of frames has arrived
+ * after the oldest unread frame, its slot may be being rewritten. From then
+ * on the frame is treated as overwritten, skipped and counted as an overflow,
+ * which keeps frames whole even when the transceiver runs concurrently with
+ * the main loop rather than interrupting it. At most one frame less than the
+ * buffer holds can be waiting to be read.
+ *
+ * @tparam Depth - the most frames the transceiver's buffer may hold
+ */
+template<std::size_t Depth>
+class receive_reader
+{
+public:
+  static_assert(std::atomic<std::size_t>::is_always_lock_free);
+
+  static constexpr std::size_t capacity()
+  {
+    return Depth;
+  }
+
+  /**
+   * @brief Start reading from a transceiver's receive buffer
+   *
+   * Must be called before the receive interrupt handler is registered.
+   *
+   * @param p_buffer - the transceiver's receive buffer
+   * @param p_cursor - the slot the transceiver will write next
+   * @return true - the reader is attached
+   * @return false - the buffer has fewer than two slots or is larger than
+   * Depth
+   */
+  bool attach(std::span<hal::can_message const> p_buffer, std::size_t p_cursor)
+  {
+    if (p_buffer.size() < 2 or p_buffer.size() > Depth) {
+      return false;
+    }
+    m_buffer = p_buffer;
+    m_write_slot = p_cursor % p_buffer.size();
+    m_read_slot = m_write_slot;
+    return true;
+  }
+
+  /**
+   * @brief Note the frame the transceiver just wrote into its buffer
+   *
+   * Must only be called from the receive interrupt, once per received frame.
+   *
+   * @param p_accepted - whether the frame should be forwarded
+   * @param p_uptime - uptime clock ticks when the frame arrived
+   */
+  void received(bool p_accepted, hal::u64 p_uptime)
+  {
+    auto const written = m_written.load(std::memory_order_relaxed);
+    m_accepted[m_write_slot] = p_accepted;
+    m_uptime[m_write_slot] = p_uptime;
+    m_write_slot = next_slot(m_write_slot, 1);
+    m_written.store(written + 1, std::memory_order_release);
+  }
+
+  /**
+   * @brief Position the next received frame will have
+   *
+   * Must only be called from the receive interrupt.
+   *
+   * @return hal::u32 - position in the sequence of every frame received
+   */
+  hal::u32 next_index() const
+  {
+    return m_written.load(std::memory_order_relaxed);
+  }
+
+  /**
+   * @brief Copy out the oldest unread accepted frame
+   *
+   * Must only be called from the main loop. Frames rejected by the
+   * acceptance filter are skipped.
+   *
+   * @return std::optional<received_message> - the frame or std::nullopt if
+   * there are no more
+   */
+  std::optional<received_message> pop()
+  {
+    auto const size = m_buffer.size();
+
+    while (true) {
+      auto written = m_written.load(std::memory_order_acquire);
+      if (m_read == written) {
+        return std::nullopt;
+      }
+
+      if (written - m_read >= size) {
+        // The transceiver has lapped us or may be rewriting the oldest slot,
+        // skip to the oldest frame it cannot be writing
+        auto const skipped = written - m_read - size + 1;
+        m_overflow_count += skipped;
+        m_read += skipped;
+        m_read_slot = next_slot(m_read_slot, skipped % size);
+      }
+
+      auto const slot = m_read_slot;
+      received_message frame{
+        .message = m_buffer[slot],
+        .uptime = m_uptime[slot],
+        .index = static_cast<hal::u32>(m_read),
+      };
+      bool const accepted = m_accepted[slot];
+
+      // The transceiver starts rewriting the slot once a buffer of frames has
+      // been reported after this one, check that had not happened by the end
+      // of the copy. The fence keeps the copy ahead of the check.
+      std::atomic_thread_fence(std::memory_order_acquire);
+      written = m_written.load(std::memory_order_relaxed);
+      if (written - m_read >= size) {
+        continue;
+      }
+
+      m_read++;
+      m_read_slot = next_slot(m_read_slot, 1);
+      if (accepted) {
+        return frame;
+      }
+    }
+  }
+
+  /// Frames written by the transceiver and not yet read
+  std::size_t size() const
+  {
+    return m_written.load(std::memory_order_acquire) - m_read;
+  }
+
+  bool empty() const
+  {
+    return size() == 0;
+  }
+
+  bool full() const
+  {
+    return size() >= m_buffer.size();
+  }
+
+  /**
+   * @return hal::u32 - number of frames overwritten before they were read.
+   * Wraps around on overflow.
+   */
+  hal::u32 overflow_count() const
+  {
+    return m_overflow_count;
+  }
+
+private:
+  /**
+   * @brief Slot a number of slots after another, wrapping around the buffer
+   *
+   * Slots are kept within the buffer rather than derived from the frame
+   * counters, which would skip slots when the counters wrap around for a
+   * buffer whose size is not a power of two.
+   *
+   * @param p_slot - slot to start from
+   * @param p_count - number of slots to move, less than the buffer size
+   * @return std::size_t - the slot
+   */
+  std::size_t next_slot(std::size_t p_slot, std::size_t p_count) const
+  {
+    auto const slot = p_slot + p_count;
+    return slot >= m_buffer.size() ? slot - m_buffer.size() : slot;
+  }
+
+  std::span<hal::can_message const> m_buffer{};
+  // Slot the next received frame is noted in, only used by the interrupt
+  std::size_t m_write_slot = 0;
+  // Slot of the oldest unread frame, only used by the main loop
+  std::size_t m_read_slot = 0;
+  std::array<hal::u64, Depth> m_uptime{};
+  std::array<bool, Depth> m_accepted{};
+  std::atomic<std::size_t> m_written = 0;
+  std::size_t m_read = 0;
+  hal::u32 m_overflow_count = 0;
+};
@@ -14,7 +14,10 @@
 
 #pragma once
 
+#include <array>
+#include <cstddef>
 #include <optional>
+#include <span>
 
 #include <libhal/can.hpp>
 #include <libhal/functional.hpp>
@@ -22,16 +25,75 @@
 #include <libhal/serial.hpp>
 #include <libhal/steady_clock.hpp>
 
+#include <app/bus_monitor.hpp>
+#include <app/config.hpp>
+
+/**
+ * @brief The parts of one CAN controller the application uses
+ */
+struct can_channel_resources
+{
+  std::optional<hal::can_transceiver*> transceiver;
+  /**
+   * @brief Send a CAN message without blocking
+   *
+   * Returns false, without sending, if the controller has no free transmit
+   * buffer. Platforms that can tell should provide this so the application can
+   * fill every transmit buffer in one pass. If this is not provided, the
+   * application sends one message per pass through `transceiver`.
+   */
+  std::optional<hal::callback<bool(hal::can_message const&)>> send_nonblocking;
+  std::optional<hal::can_bus_manager*> bus_manager;
+  std::optional<hal::can_interrupt*> interrupt;
+  /**
+   * @brief Read the controller's error counters
+   *
+   * Called once per main loop pass, so it should only read registers.
+   * Platforms that can read them should provide this to report error
+   * warning, error passive, arbitration lost and bus error through the 'F'
+   * command and error events. If this is not provided, only bus off, reported
+   * through `bus_manager`, is tracked.
+   */
+  std::optional<hal::callback<can_error_state()>> error_state;
+  // Hardware filter banks, any of these may be empty. The first extended mask
+  // filter holds the Lawicel acceptance code and mask ('M' and 'm').
+  std::span<hal::can_identifier_filter* const> identifier_filters{};
+  std::span<hal::can_extended_identifier_filter* const>
+    extended_identifier_filters{};
+  std::span<hal::can_mask_filter* const> mask_filters{};
+  std::span<hal::can_extended_mask_filter* const> extended_mask_filters{};
+};
+
 struct resource_list
 {
   std::optional<hal::output_pin*> red_led;
   std::optional<hal::serial*> console;
+  /**
+   * @brief Write console bytes without blocking
+   *
+   * Returns how many of the bytes were accepted, which may be none. Platforms
+   * with interrupt or DMA driven transmit should provide this. If this is not
+   * provided, the application writes to `console` in small bounded chunks.
+   */
+  std::optional<hal::callback<std::size_t(std::span<hal::byte const>)>>
+    console_write_nonblocking;
   std::optional<hal::steady_clock*> clock;
-  std::optional<hal::can_transceiver*> can_transceiver;
-  std::optional<hal::can_bus_manager*> can_bus_manager;
-  std::optional<hal::can_interrupt*> can_interrupt;
-  std::optional<hal::can_extended_mask_filter*> can_mask_filter;
+  /// One entry per CAN channel, see CAN_OPENER_CHANNELS
+  std::array<can_channel_resources, channel_count> can_channels{};
   std::optional<hal::callback<void()>> reset;
+  /**
+   * @brief Put the device to sleep until there is work for the application
+   *
+   * The callback passed in reports whether the application has pending work.
+   * Implementations must evaluate it in a way that cannot miss a wake up
+   * source firing between the check and going to sleep (for example, by
+   * evaluating it with interrupts masked and relying on the pending interrupt
+   * to wake the core). If it returns true, the implementation must return
+   * immediately.
+   *
+   * If this is not provided, the application will poll continuously.
+   */
+  std::optional<hal::callback<void(hal::callback<bool()>)>> wait_for_work;
 };
 
 // Application function must be implemented by one of the compilation units
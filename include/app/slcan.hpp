@@ -0,0 +1,368 @@
+// Copyright 2024 Khalil Estell
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <optional>
+#include <span>
+#include <string_view>
+
+#include <libhal/can.hpp>
+#include <libhal/units.hpp>
+
+// Largest encoded frame: 'T' + 8 ID characters + 1 length character + 16
+// payload characters + 8 microsecond timestamp characters + '\r'
+constexpr std::size_t max_encoded_message_size = 1 + 8 + 1 + 16 + 8 + 1;
+
+/**
+ * @brief Timestamp appended to encoded frames, selected with the 'Z' command
+ *
+ */
+enum class timestamp_mode : hal::u8
+{
+  /// No timestamp
+  off,
+  /// Lawicel timestamp: 4 hex characters of milliseconds, wrapping at 60000
+  milliseconds,
+  /// Extension: 8 hex characters of microseconds, wrapping at 2^32
+  microseconds,
+};
+
+// Maps a nibble to its upper case ASCII hex character
+constexpr std::array<hal::byte, 16> nibble_to_hex = {
+  '0', '1', '2', '3', '4', '5', '6', '7',
+  '8', '9', 'A', 'B', 'C', 'D', 'E', 'F',
+};
+
+/**
+ * @brief Write the upper case hex representation of a value
+ *
+ * @tparam Digits - number of hex characters to write, leading digits are zero
+ * filled and digits beyond this width are discarded.
+ * @param p_output - location to write the characters to
+ * @param p_value - value to encode
+ */
+template<std::size_t Digits>
+constexpr void encode_hex(hal::byte* p_output, hal::u32 p_value)
+{
+  for (std::size_t i = Digits; i > 0; i--) {
+    p_output[i - 1] = nibble_to_hex[p_value & 0xF];
+    p_value >>= 4;
+  }
+}
+
+/**
+ * @brief Write a timestamp in the format selected with the 'Z' command
+ *
+ * @param p_output - location to write the characters to, with room for 8
+ * @param p_timestamp_mode - timestamp format
+ * @param p_microseconds - time to encode in microseconds
+ * @return std::size_t - number of characters written
+ */
+constexpr std::size_t encode_timestamp(hal::byte* p_output,
+                                       timestamp_mode p_timestamp_mode,
+                                       hal::u64 p_microseconds)
+{
+  switch (p_timestamp_mode) {
+    case timestamp_mode::off: {
+      return 0;
+    }
+    case timestamp_mode::milliseconds: {
+      encode_hex<4>(p_output, (p_microseconds / 1'000) % 60'000);
+      return 4;
+    }
+    case timestamp_mode::microseconds: {
+      encode_hex<8>(p_output, p_microseconds & 0xFFFF'FFFF);
+      return 8;
+    }
+  }
+  return 0;
+}
+
+/**
+ * @brief Encode a CAN message into its slcan representation
+ *
+ * Produces `tiiildd..\r`, `Tiiiiiiiildd..\r`, `riii\r` or `Riiiiiiii\r`
+ * depending on the frame type, with the timestamp inserted before the '\r'
+ * when enabled. Characters are produced directly from a lookup table without
+ * any format string parsing.
+ *
+ * @param p_buffer - buffer to write the encoded message into. Must be at least
+ * `max_encoded_message_size` bytes long.
+ * @param p_message - message to encode
+ * @param p_timestamp_mode - timestamp format to append
+ * @param p_microseconds - time the message was received in microseconds
+ * @return std::size_t - number of bytes written to the buffer
+ */
+inline std::size_t encode_can_message(
+  std::span<hal::byte> p_buffer,
+  hal::can_message const& p_message,
+  timestamp_mode p_timestamp_mode = timestamp_mode::off,
+  hal::u64 p_microseconds = 0)
+{
+  auto* output = p_buffer.data();
+  bool const remote_request = p_message.remote_request();
+
+  if (p_message.extended()) {
+    // A extended 29-bit CAN frame
+    // Tiiiiiiiildd...[CR] or Riiiiiiii[CR]
+    *output++ = remote_request ? 'R' : 'T';
+    encode_hex<8>(output, p_message.id());
+    output += 8;
+  } else {
+    // A standard 11-bit CAN frame
+    // tiiildd...[CR] or riii[CR]
+    *output++ = remote_request ? 'r' : 't';
+    encode_hex<3>(output, p_message.id());
+    output += 3;
+  }
+
+  // Send data bytes if the message is not a remote request.
+  if (not remote_request) {
+    auto const length =
+      std::min<std::size_t>(p_message.length, p_message.payload.size());
+    *output++ = nibble_to_hex[length];
+    for (std::size_t i = 0; i < length; i++) {
+      output[0] = nibble_to_hex[p_message.payload[i] >> 4];
+      output[1] = nibble_to_hex[p_message.payload[i] & 0xF];
+      output += 2;
+    }
+  }
+
+  output += encode_timestamp(output, p_timestamp_mode, p_microseconds);
+  *output++ = '\r';
+
+  return output - p_buffer.data();
+}
+
+// Marks characters that are not hex digits in `hex_to_nibble`. Any value with
+// bits set above the low nibble is invalid.
+constexpr hal::byte invalid_hex = 0xFF;
+
+// Maps an ASCII character to its hex value or `invalid_hex`
+constexpr std::array<hal::byte, 256> hex_to_nibble = []() {
+  std::array<hal::byte, 256> table{};
+  table.fill(invalid_hex);
+  for (hal::byte i = 0; i < 10; i++) {
+    table['0' + i] = i;
+  }
+  for (hal::byte i = 0; i < 6; i++) {
+    table['A' + i] = 10 + i;
+    table['a' + i] = 10 + i;
+  }
+  return table;
+}();
+
+/**
+ * @brief Convert a fixed width field of hex characters into a value
+ *
+ * Every character is looked up and accumulated unconditionally. Validity is
+ * checked once at the end by testing whether any lookup produced
+ * `invalid_hex`, so the loop has no data dependent branches.
+ *
+ * @tparam Digits - number of hex characters in the field (at most 8)
+ * @param p_input - first character of the field
+ * @return std::optional<hal::u32> - the value or std::nullopt if any of the
+ * characters are not hex digits
+ */
+template<std::size_t Digits>
+constexpr std::optional<hal::u32> decode_hex(hal::byte const* p_input)
+{
+  static_assert(Digits <= 8, "A u32 can only hold 8 hex digits");
+
+  hal::u32 value = 0;
+  hal::byte seen = 0;
+  for (std::size_t i = 0; i < Digits; i++) {
+    auto const nibble = hex_to_nibble[p_input[i]];
+    seen |= nibble;
+    value = (value << 4) | (nibble & 0xF);
+  }
+
+  if (seen & 0xF0) {
+    return std::nullopt;
+  }
+
+  return value;
+}
+
+/**
+ * @brief Convert a variable width field of hex characters into a value
+ *
+ * @param p_input - hex characters, must be between 1 and 8 characters long
+ * @return std::optional<hal::u32> - the value or std::nullopt if the field is
+ * empty, too long or contains non hex characters
+ */
+constexpr std::optional<hal::u32> decode_hex(std::span<hal::byte const> p_input)
+{
+  if (p_input.empty() or p_input.size() > 8) {
+    return std::nullopt;
+  }
+
+  hal::u32 value = 0;
+  hal::byte seen = 0;
+  for (auto const character : p_input) {
+    auto const nibble = hex_to_nibble[character];
+    seen |= nibble;
+    value = (value << 4) | (nibble & 0xF);
+  }
+
+  if (seen & 0xF0) {
+    return std::nullopt;
+  }
+
+  return value;
+}
+
+/**
+ * @brief Get the length of the `t`, `T`, `r` or `R` frame at the start of text
+ *
+ * Only the command character and the length character are looked at, the rest
+ * of the frame is validated when it is decoded.
+ *
+ * @param p_text - text starting with a frame
+ * @return std::optional<std::size_t> - number of characters in the frame,
+ * without any terminator, or std::nullopt if the text does not start with a
+ * frame header
+ */
+inline std::optional<std::size_t> encoded_frame_length(
+  std::span<hal::byte const> p_text)
+{
+  if (p_text.empty()) {
+    return std::nullopt;
+  }
+
+  std::size_t id_length = 0;
+  if (p_text[0] == 't' or p_text[0] == 'r') {
+    id_length = 3;
+  } else if (p_text[0] == 'T' or p_text[0] == 'R') {
+    id_length = 8;
+  } else {
+    return std::nullopt;
+  }
+
+  if (p_text.size() <= 1 + id_length) {
+    return std::nullopt;
+  }
+
+  // Unsigned subtraction turns characters below '0' into large lengths
+  std::size_t const payload_length = p_text[1 + id_length] - '0';
+  if (payload_length > 8) {
+    return std::nullopt;
+  }
+
+  return 1 + id_length + 1 + (payload_length * 2);
+}
+
+/**
+ * @brief Decode a `t`, `T`, `r` or `R` frame into a CAN message
+ *
+ * The whole frame is validated and converted in a single pass over the input.
+ * The payload is decoded two characters at a time, a whole byte per pair of
+ * table lookups.
+ *
+ * @param p_frame - the frame without any terminator
+ * @return std::optional<hal::can_message> - the message or std::nullopt if the
+ * frame is malformed
+ */
+inline std::optional<hal::can_message> decode_can_frame(
+  std::span<hal::byte const> p_frame)
+{
+  hal::can_message message{};
+
+  if (p_frame.empty()) {
+    return std::nullopt;
+  }
+
+  auto const command = p_frame[0];
+  std::optional<hal::u32> id;
+  std::size_t id_length = 0;
+
+  // Every format is the command character, the ID and the length character at
+  // the least.
+  if (command == 't' or command == 'r') {
+    constexpr std::string_view format = "tiiil";
+    if (p_frame.size() < format.size()) {
+      return std::nullopt;
+    }
+    id_length = 3;
+    id = decode_hex<3>(&p_frame[1]);
+    message.extended(false);
+  } else if (command == 'T' or command == 'R') {
+    constexpr std::string_view format = "Tiiiiiiiil";
+    if (p_frame.size() < format.size()) {
+      return std::nullopt;
+    }
+    id_length = 8;
+    id = decode_hex<8>(&p_frame[1]);
+    message.extended(true);
+  } else {
+    return std::nullopt;
+  }
+
+  if (not id) {
+    return std::nullopt;
+  }
+
+  message.id(*id);
+  message.remote_request(command == 'r' or command == 'R');
+
+  // Skip the command character and the ID field
+  auto const fields = p_frame.subspan(1 + id_length);
+
+  // Unsigned subtraction turns characters below '0' into large lengths
+  std::size_t const payload_length = fields[0] - '0';
+  auto const payload = fields.subspan(1);
+
+  // We multiply by 2 for the payload length because it takes two characters to
+  // represent each byte in the command string.
+  if (payload_length > message.payload.size() or
+      payload.size() != payload_length * 2) {
+    return std::nullopt;
+  }
+
+  message.length = payload_length;
+
+  hal::byte seen = 0;
+  for (std::size_t i = 0; i < payload_length; i++) {
+    auto const upper = hex_to_nibble[payload[i * 2]];
+    auto const lower = hex_to_nibble[payload[(i * 2) + 1]];
+    seen |= upper | lower;
+    message.payload[i] = ((upper & 0xF) << 4) | (lower & 0xF);
+  }
+
+  if (seen & 0xF0) {
+    return std::nullopt;
+  }
+
+  return message;
+}
+
+/**
+ * @brief Decode a `t`, `T`, `r` or `R` transmit command into a CAN message
+ *
+ * @param p_command - the command including its terminating '\r'
+ * @return std::optional<hal::can_message> - the message or std::nullopt if the
+ * command is malformed or does not end in '\r'
+ */
+inline std::optional<hal::can_message> decode_can_message(
+  std::span<hal::byte const> p_command)
+{
+  if (p_command.empty() or p_command.back() != '\r') {
+    return std::nullopt;
+  }
+  return decode_can_frame(p_command.first(p_command.size() - 1));
+}
@@ -0,0 +1,165 @@
+// Copyright 2024 Khalil Estell
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <array>
+#include <bit>
+#include <cstddef>
+
+#include <libhal/can.hpp>
+#include <libhal/units.hpp>
+
+/**
+ * @brief Acceptance filter for received frames, cheap enough to run in an ISR
+ *
+ * Standard IDs are looked up in a 2048 bit bitmap, one bit per ID. Extended
+ * IDs are kept in an open addressing hash set. Insertions that would need more
+ * than `max_probes` slots are refused, which bounds the worst case lookup to a
+ * fixed number of reads whatever IDs are loaded. A small table of extended
+ * ID/mask pairs, at most `extended_mask_capacity`, is checked after the hash
+ * set.
+ *
+ * While no IDs are loaded, every frame is accepted. Once any ID is loaded,
+ * only frames with loaded IDs are accepted.
+ *
+ * Entries must only be changed while frames are not being accepted from
+ * another context, or a frame may be filtered against a partially updated set.
+ */
+class software_filter
+{
+public:
+  static constexpr std::size_t extended_capacity = 64;
+  static constexpr std::size_t max_probes = 8;
+  static constexpr std::size_t extended_mask_capacity = 8;
+
+  /**
+   * @brief Check if a frame passes the filter
+   *
+   * @param p_message - received message
+   * @return true - the message should be kept
+   */
+  bool accepts(hal::can_message const& p_message) const
+  {
+    if (not m_enabled) {
+      return true;
+    }
+
+    if (not p_message.extended()) {
+      auto const id = p_message.id() & max_standard_id;
+      return (m_standard[id / 32] >> (id % 32)) & 1;
+    }
+
+    auto const id = p_message.id();
+    auto slot = hash(id);
+    for (std::size_t i = 0; i < max_probes; i++) {
+      auto const entry = m_extended[slot];
+      if (entry == id) {
+        return true;
+      }
+      if (entry == empty_slot) {
+        break;
+      }
+      slot = (slot + 1) & slot_mask;
+    }
+
+    for (std::size_t i = 0; i < m_extended_mask_count; i++) {
+      auto const& pair = m_extended_masks[i];
+      if ((id & pair.mask) == (pair.id & pair.mask)) {
+        return true;
+      }
+    }
+    return false;
+  }
+
+  /**
+   * @brief Accept frames with a standard ID
+   *
+   * @param p_id - 11-bit ID
+   * @return true - the ID was added
+   * @return false - the ID is out of range
+   */
+  bool allow_standard(hal::u32 p_id);
+
+  /**
+   * @brief Accept frames with an extended ID
+   *
+   * @param p_id - 29-bit ID
+   * @return true - the ID was added or already present
+   * @return false - the ID is out of range or the set has no room for it
+   */
+  bool allow_extended(hal::u32 p_id);
+
+  /**
+   * @brief Accept frames with a standard ID matching an ID/mask pair
+   *
+   * Every matching ID is set in the bitmap, so this costs nothing extra when
+   * filtering.
+   *
+   * @param p_id - 11-bit ID
+   * @param p_mask - bits of the ID that must match, a 1 bit must match
+   * @return true - the pair was added
+   * @return false - the pair is out of range
+   */
+  bool allow_standard_mask(hal::u32 p_id, hal::u32 p_mask);
+
+  /**
+   * @brief Accept frames with an extended ID matching an ID/mask pair
+   *
+   * @param p_id - 29-bit ID
+   * @param p_mask - bits of the ID that must match, a 1 bit must match
+   * @return true - the pair was added
+   * @return false - the pair is out of range or the table is full
+   */
+  bool allow_extended_mask(hal::u32 p_id, hal::u32 p_mask);
+
+  /**
+   * @brief Remove every ID, which accepts all frames again
+   */
+  void clear();
+
+  bool enabled() const
+  {
+    return m_enabled;
+  }
+
+private:
+  static constexpr hal::u32 max_standard_id = 0x7FF;
+  static constexpr hal::u32 max_extended_id = 0x1FFF'FFFF;
+  // Not a valid 29-bit ID, so it can mark unused slots
+  static constexpr hal::u32 empty_slot = 0xFFFF'FFFF;
+  // Keep the table at most half full so probe sequences stay short
+  static constexpr std::size_t slot_count = extended_capacity * 2;
+  static constexpr std::size_t slot_mask = slot_count - 1;
+  static_assert((slot_count & slot_mask) == 0);
+
+  static std::size_t hash(hal::u32 p_id)
+  {
+    // Fibonacci hashing, the top bits of the product are the best mixed
+    constexpr auto slot_bits = std::countr_zero(slot_count);
+    return (p_id * 0x9E37'79B1U) >> (32 - slot_bits);
+  }
+
+  std::array<hal::u32, (max_standard_id + 1) / 32> m_standard{};
+  std::array<hal::u32, slot_count> m_extended = []() {
+    std::array<hal::u32, slot_count> slots{};
+    slots.fill(empty_slot);
+    return slots;
+  }();
+  std::size_t m_extended_count = 0;
+  std::array<hal::can_extended_mask_filter::pair, extended_mask_capacity>
+    m_extended_masks{};
+  std::size_t m_extended_mask_count = 0;
+  bool m_enabled = false;
+};
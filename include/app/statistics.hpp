@@ -0,0 +1,92 @@
+// Copyright 2024 Khalil Estell
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <limits>
+
+#include <libhal/units.hpp>
+
+/**
+ * @brief Counter written by a single context and read by any other
+ *
+ * With only one writer, a relaxed load and store pair is enough to increment
+ * it, which avoids requiring atomic read-modify-write support from the core
+ * and costs no more than a plain increment. Wraps around on overflow.
+ */
+class event_counter
+{
+public:
+  void increment(hal::u32 p_amount = 1)
+  {
+    m_count.store(m_count.load(std::memory_order_relaxed) + p_amount,
+                  std::memory_order_relaxed);
+  }
+
+  hal::u32 value() const
+  {
+    return m_count.load(std::memory_order_relaxed);
+  }
+
+private:
+  std::atomic<hal::u32> m_count = 0;
+};
+
+/**
+ * @brief Counters written by one channel's CAN receive interrupt
+ *
+ * Each channel keeps its own, so every counter has a single writer even when
+ * the receive interrupts of several channels preempt each other. The 'I'
+ * command reports the sum over every channel.
+ */
+struct channel_statistics
+{
+  /// Every frame the transceiver received
+  event_counter frames_received;
+  /// Frames rejected by the acceptance filter
+  event_counter frames_filtered;
+};
+
+/**
+ * @brief Counters reported by the 'I' command, written by the main loop
+ *
+ * Cheap enough to stay enabled in every build. Counters are only ever reset
+ * by rebooting, so the host works with the differences between two reports.
+ */
+struct statistics
+{
+  /// Frames handed to the transceiver
+  event_counter frames_transmitted;
+  /// Frames the transceiver failed to send, they are dropped
+  event_counter transmit_failures;
+  /// Commands answered with CR
+  event_counter commands_handled;
+  /// Commands answered with BELL
+  event_counter commands_rejected;
+  /// Most unread frames seen in the receive buffer
+  hal::u32 receive_high_water = 0;
+  /// Most frames seen in the transmit queue
+  hal::u32 transmit_high_water = 0;
+  /// Shortest and longest main loop pass, in uptime clock ticks
+  hal::u64 shortest_pass = std::numeric_limits<hal::u64>::max();
+  hal::u64 longest_pass = 0;
+
+  void record_pass(hal::u64 p_ticks)
+  {
+    shortest_pass = std::min(shortest_pass, p_ticks);
+    longest_pass = std::max(longest_pass, p_ticks);
+  }
+};
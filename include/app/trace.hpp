@@ -0,0 +1,221 @@
+// Copyright 2024 Khalil Estell
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <span>
+
+#include <libhal/steady_clock.hpp>
+#include <libhal/units.hpp>
+
+/// Points a received frame passes on its way to the host
+enum class trace_stage : hal::u8
+{
+  /// Entered the CAN receive interrupt
+  interrupt_entry = 0,
+  /// Noted in the receive buffer, leaving the interrupt
+  interrupt_exit = 1,
+  /// Read out of the receive buffer by the main loop
+  dequeued = 2,
+  /// Encoded as slcan text or a binary record
+  encoded = 3,
+  /// Queued into the console output buffer
+  console_queued = 4,
+  /// Last byte handed to the console serial port
+  console_written = 5,
+};
+
+/**
+ * @brief A trace event, 8 bytes when dumped
+ *
+ * Dumped little endian as: u32 ticks, u16 frame, u8 stage, u8 reserved.
+ */
+struct trace_event
+{
+  /// Low 32 bits of the uptime clock
+  hal::u32 ticks;
+  /// Low 16 bits of the frame's position in the receive sequence
+  hal::u16 frame;
+  trace_stage stage;
+};
+
+inline constexpr std::size_t trace_event_size = 8;
+
+/**
+ * @brief Fixed size ring of the most recent trace events
+ *
+ * Each context that records events needs its own ring, as only a single
+ * writer is supported. With a capacity of 0, tracing compiles out completely:
+ * record() does nothing, not even read the clock, and no events are stored.
+ *
+ * @tparam Capacity - events kept, 0 to disable tracing
+ */
+template<std::size_t Capacity>
+class trace_buffer
+{
+public:
+  static constexpr bool enabled = Capacity != 0;
+
+  /**
+   * @brief Record an event at the current time
+   *
+   * @param p_stage - point the frame has reached
+   * @param p_frame - the frame's position in the receive sequence
+   * @param p_clock - uptime clock
+   */
+  void record(trace_stage p_stage, hal::u32 p_frame, hal::steady_clock& p_clock)
+  {
+    if constexpr (enabled) {
+      if (m_paused.load(std::memory_order_relaxed)) {
+        return;
+      }
+      auto const count = m_count.load(std::memory_order_relaxed);
+      m_events[count % Capacity] = trace_event{
+        .ticks = static_cast<hal::u32>(p_clock.uptime()),
+        .frame = static_cast<hal::u16>(p_frame),
+        .stage = p_stage,
+      };
+      m_count.store(count + 1, std::memory_order_release);
+    }
+  }
+
+  /**
+   * @brief Stop recording so the events can be read
+   *
+   * The writer must either run in the caller's context or be an interrupt
+   * that runs to completion, so it cannot be part way through an event.
+   */
+  void pause()
+  {
+    m_paused.store(true, std::memory_order_release);
+  }
+
+  /**
+   * @brief Discard every event and start recording again
+   */
+  void restart()
+  {
+    m_count.store(0, std::memory_order_relaxed);
+    m_paused.store(false, std::memory_order_release);
+  }
+
+  /// Number of events held, oldest first when read
+  std::size_t size() const
+  {
+    return std::min<std::size_t>(m_count.load(std::memory_order_acquire),
+                                 Capacity);
+  }
+
+  /**
+   * @brief Encode a held event for dumping
+   *
+   * @param p_index - event to encode, 0 is the oldest
+   * @param p_output - where to write the trace_event_size bytes
+   */
+  void encode(std::size_t p_index,
+              std::span<hal::byte, trace_event_size> p_output) const
+  {
+    if constexpr (enabled) {
+      auto const count = m_count.load(std::memory_order_acquire);
+      auto const first = count > Capacity ? count - Capacity : 0;
+      auto const& event = m_events[(first + p_index) % Capacity];
+      p_output[0] = event.ticks;
+      p_output[1] = event.ticks >> 8;
+      p_output[2] = event.ticks >> 16;
+      p_output[3] = event.ticks >> 24;
+      p_output[4] = event.frame;
+      p_output[5] = event.frame >> 8;
+      p_output[6] = static_cast<hal::byte>(event.stage);
+      p_output[7] = 0;
+    }
+  }
+
+private:
+  std::array<trace_event, Capacity> m_events{};
+  std::atomic<std::size_t> m_count = 0;
+  std::atomic<bool> m_paused = false;
+};
+
+/**
+ * @brief Remembers where each traced frame ends in the console output
+ *
+ * Lets the main loop record when the last byte of a frame actually leaves
+ * the console buffer, rather than when it was queued.
+ *
+ * @tparam Capacity - frames tracked at once, 0 to disable tracing
+ */
+template<std::size_t Capacity>
+class console_write_tracker
+{
+public:
+  /**
+   * @brief Track a frame that was just queued
+   *
+   * @param p_frame - the frame's position in the receive sequence
+   * @param p_end - console byte count once the frame has been written
+   */
+  void add(hal::u32 p_frame, hal::u32 p_end)
+  {
+    if constexpr (Capacity != 0) {
+      if (m_size == Capacity) {
+        // Lose the oldest rather than stall the loop
+        m_head++;
+        m_size--;
+      }
+      m_pending[(m_head + m_size) % Capacity] = { p_frame, p_end };
+      m_size++;
+    }
+  }
+
+  /**
+   * @brief Record an event for every tracked frame now fully written
+   *
+   * @param p_written - console byte count
+   * @param p_trace - where to record the events
+   * @param p_clock - uptime clock
+   */
+  template<std::size_t TraceCapacity>
+  void complete(hal::u32 p_written,
+                trace_buffer<TraceCapacity>& p_trace,
+                hal::steady_clock& p_clock)
+  {
+    if constexpr (Capacity != 0) {
+      while (m_size != 0) {
+        auto const& pending = m_pending[m_head % Capacity];
+        // Signed difference keeps working when the byte count wraps
+        if (static_cast<hal::i32>(p_written - pending.end) < 0) {
+          return;
+        }
+        p_trace.record(trace_stage::console_written, pending.frame, p_clock);
+        m_head++;
+        m_size--;
+      }
+    }
+  }
+
+private:
+  struct pending_write
+  {
+    hal::u32 frame;
+    hal::u32 end;
+  };
+
+  std::array<pending_write, Capacity> m_pending{};
+  std::size_t m_head = 0;
+  std::size_t m_size = 0;
+};
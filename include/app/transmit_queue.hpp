@@ -0,0 +1,198 @@
+// Copyright 2024 Khalil Estell
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <optional>
+#include <utility>
+
+#include <libhal/can.hpp>
+#include <libhal/units.hpp>
+
+/**
+ * @brief Compute the arbitration priority of a message
+ *
+ * Orders the bits the same way they go out on the bus during arbitration: the
+ * 11 bit base ID, then the standard frame RTR or extended frame SRR bit, the
+ * IDE bit, the 18 bit ID extension and finally the extended frame RTR bit.
+ * A lower value wins arbitration.
+ *
+ * @param p_message - message to rank
+ * @return hal::u32 - arbitration priority, lower is higher priority
+ */
+constexpr hal::u32 arbitration_priority(hal::can_message const& p_message)
+{
+  auto const rtr = static_cast<hal::u32>(p_message.remote_request());
+
+  if (not p_message.extended()) {
+    auto const base_id = p_message.id() & 0x7FF;
+    return (base_id << 21) | (rtr << 20);
+  }
+
+  auto const id = p_message.id() & 0x1FFF'FFFF;
+  auto const base_id = id >> 18;
+  auto const id_extension = id & 0x3'FFFF;
+  // SRR and IDE are both recessive for extended frames
+  return (base_id << 21) | (1U << 20) | (1U << 19) | (id_extension << 1) | rtr;
+}
+
+/**
+ * @brief Bounded queue of messages to transmit, ordered by bus priority
+ *
+ * A binary min-heap on the arbitration priority of each message, so a high
+ * priority message queued behind many low priority ones goes out next, just
+ * as it would win arbitration on the bus. Messages with the same priority
+ * leave in the order they were queued.
+ *
+ * Pushing into a full queue is rejected rather than overwriting a queued
+ * message.
+ *
+ * @tparam Capacity - number of messages the queue can hold
+ */
+template<std::size_t Capacity>
+class priority_transmit_queue
+{
+public:
+  static_assert(Capacity != 0);
+
+  static constexpr std::size_t capacity()
+  {
+    return Capacity;
+  }
+
+  /**
+   * @brief Add a message to the queue
+   *
+   * @param p_message - message to transmit
+   * @return true - the message was queued
+   * @return false - the queue was full
+   */
+  bool push(hal::can_message const& p_message)
+  {
+    if (full()) {
+      return false;
+    }
+
+    m_entries[m_size] = entry{
+      .priority = arbitration_priority(p_message),
+      .sequence = m_next_sequence++,
+      .message = p_message,
+    };
+    sift_up(m_size++);
+    return true;
+  }
+
+  /**
+   * @brief Get the highest priority message without removing it
+   *
+   * The queue must not be empty.
+   *
+   * @return hal::can_message const& - highest priority message
+   */
+  hal::can_message const& front() const
+  {
+    return m_entries[0].message;
+  }
+
+  /**
+   * @brief Remove the highest priority message
+   *
+   * @return std::optional<hal::can_message> - the highest priority message or
+   * std::nullopt if the queue is empty
+   */
+  std::optional<hal::can_message> pop()
+  {
+    if (empty()) {
+      return std::nullopt;
+    }
+
+    auto const message = m_entries[0].message;
+    m_entries[0] = m_entries[--m_size];
+    sift_down(0);
+    return message;
+  }
+
+  std::size_t size() const
+  {
+    return m_size;
+  }
+
+  bool empty() const
+  {
+    return m_size == 0;
+  }
+
+  bool full() const
+  {
+    return m_size == Capacity;
+  }
+
+private:
+  struct entry
+  {
+    hal::u32 priority = 0;
+    // Breaks ties so equal priority messages keep their queued order
+    hal::u32 sequence = 0;
+    hal::can_message message{};
+  };
+
+  static bool before(entry const& p_a, entry const& p_b)
+  {
+    if (p_a.priority != p_b.priority) {
+      return p_a.priority < p_b.priority;
+    }
+    // Signed difference keeps the order correct when the sequence wraps
+    return static_cast<hal::i32>(p_a.sequence - p_b.sequence) < 0;
+  }
+
+  void sift_up(std::size_t p_index)
+  {
+    while (p_index > 0) {
+      auto const parent = (p_index - 1) / 2;
+      if (not before(m_entries[p_index], m_entries[parent])) {
+        return;
+      }
+      std::swap(m_entries[p_index], m_entries[parent]);
+      p_index = parent;
+    }
+  }
+
+  void sift_down(std::size_t p_index)
+  {
+    while (true) {
+      auto const left = (p_index * 2) + 1;
+      auto const right = left + 1;
+      auto first = p_index;
+
+      if (left < m_size and before(m_entries[left], m_entries[first])) {
+        first = left;
+      }
+      if (right < m_size and before(m_entries[right], m_entries[first])) {
+        first = right;
+      }
+      if (first == p_index) {
+        return;
+      }
+
+      std::swap(m_entries[p_index], m_entries[first]);
+      p_index = first;
+    }
+  }
+
+  std::array<entry, Capacity> m_entries{};
+  std::size_t m_size = 0;
+  hal::u32 m_next_sequence = 0;
+};
@@ -0,0 +1,217 @@
+// Copyright 2024 Khalil Estell
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <optional>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/ioctl.h>
+#include <termios.h>
+#include <unistd.h>
+
+#include <libhal/serial.hpp>
+
+#include <app/config.hpp>
+#include <app/resource_list.hpp>
+
+#include "host/simulation.hpp"
+
+namespace {
+[[noreturn]] void fail(char const* p_what)
+{
+  std::perror(p_what);
+  std::exit(EXIT_FAILURE);
+}
+
+/**
+ * @brief Console on a pseudo terminal
+ *
+ * Open the terminal printed at start up with any serial terminal or SLCAN
+ * tool. The terminal is put in raw mode so carriage returns reach the
+ * application untouched.
+ */
+class pty_console : public hal::serial
+{
+public:
+  pty_console()
+  {
+    m_master = posix_openpt(O_RDWR | O_NOCTTY | O_NONBLOCK);
+    if (m_master < 0 or grantpt(m_master) != 0 or unlockpt(m_master) != 0) {
+      fail("pty");
+    }
+
+    // Holding the other end open keeps reads from failing while no terminal
+    // is attached
+    m_slave = ::open(ptsname(m_master), O_RDWR | O_NOCTTY);
+    if (m_slave < 0) {
+      fail("pty");
+    }
+    termios raw{};
+    tcgetattr(m_slave, &raw);
+    cfmakeraw(&raw);
+    tcsetattr(m_slave, TCSANOW, &raw);
+  }
+
+  char const* name() const
+  {
+    return ptsname(m_master);
+  }
+
+  int descriptor() const
+  {
+    return m_master;
+  }
+
+  std::size_t write_nonblocking(std::span<hal::byte const> p_data)
+  {
+    auto const written = ::write(m_master, p_data.data(), p_data.size());
+    if (written < 0) {
+      if (errno == EAGAIN) {
+        return 0;
+      }
+      fail("pty write");
+    }
+    return static_cast<std::size_t>(written);
+  }
+
+private:
+  void driver_configure(settings const&) override
+  {
+    // Baud rate and framing mean nothing on a pseudo terminal
+  }
+
+  write_t driver_write(std::span<hal::byte const> p_data) override
+  {
+    auto remaining = p_data;
+    while (not remaining.empty()) {
+      remaining = remaining.subspan(write_nonblocking(remaining));
+      if (not remaining.empty()) {
+        pollfd writable{ .fd = m_master, .events = POLLOUT, .revents = 0 };
+        poll(&writable, 1, -1);
+      }
+    }
+    return { .data = p_data };
+  }
+
+  read_t driver_read(std::span<hal::byte> p_data) override
+  {
+    std::size_t received = 0;
+    if (not p_data.empty()) {
+      auto const result = ::read(m_master, p_data.data(), p_data.size());
+      if (result > 0) {
+        received = static_cast<std::size_t>(result);
+      }
+    }
+
+    int available = 0;
+    ioctl(m_master, FIONREAD, &available);
+    return {
+      .data = p_data.first(received),
+      .available = static_cast<std::size_t>(available),
+      .capacity = 4096,
+    };
+  }
+
+  void driver_flush() override
+  {
+    tcflush(m_master, TCIFLUSH);
+  }
+
+  int m_master = -1;
+  int m_slave = -1;
+};
+}  // namespace
+
+void initialize_platform(resource_list& p_map)
+{
+  static host_clock clock;
+  static host_led led;
+  static pty_console console;
+
+  p_map.reset = +[]() { std::exit(EXIT_SUCCESS); };
+  p_map.red_led = &led;
+  p_map.clock = &clock;
+  p_map.console = &console;
+  p_map.console_write_nonblocking =
+    [](std::span<hal::byte const> p_data) -> std::size_t {
+    return console.write_nonblocking(p_data);
+  };
+
+  // Every channel is a simulated bus of its own. Frames are only generated
+  // when CAN_OPENER_HOST_LOAD is set.
+  static std::array<std::array<hal::can_message, receive_depth>, channel_count>
+    can_receive_buffers{};
+  static std::array<std::optional<simulated_can_bus>, channel_count> buses{};
+  auto const settings = generator_settings_from_environment(0.0f);
+  for (std::size_t i = 0; i < channel_count; i++) {
+    auto& bus = buses[i].emplace(can_receive_buffers[i], settings);
+    auto& can = p_map.can_channels[i];
+    can.transceiver = &bus;
+    can.bus_manager = &bus;
+    can.interrupt = &bus;
+    can.error_state = [&bus]() { return bus.error_state(); };
+  }
+
+  std::printf("console on %s\n", console.name());
+  std::fflush(stdout);
+
+  p_map.wait_for_work = [](hal::callback<bool()> p_has_work) {
+    // Frames that arrived while the application was busy are delivered here,
+    // standing in for the receive interrupts. A person is on the other end of
+    // the console, so simulated time keeps up with the wall clock.
+    static auto const start = std::chrono::steady_clock::now();
+    auto const deliver = []() {
+      clock.advance_to(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                         std::chrono::steady_clock::now() - start)
+                         .count());
+      auto const now = clock.now();
+      for (auto& bus : buses) {
+        bus->deliver(now);
+      }
+    };
+    deliver();
+    if (p_has_work()) {
+      return;
+    }
+
+    // Sleep until console input arrives or the next frame is due on any bus
+    std::optional<hal::u64> next;
+    for (auto const& bus : buses) {
+      if (auto const arrival = bus->next_arrival()) {
+        next = std::min(next.value_or(*arrival), *arrival);
+      }
+    }
+    timespec timeout{};
+    timespec* wait = nullptr;
+    if (next) {
+      auto const now = clock.now();
+      auto const delay = *next > now ? *next - now : 0;
+      timeout.tv_sec = static_cast<time_t>(delay / 1'000'000'000);
+      timeout.tv_nsec = static_cast<long>(delay % 1'000'000'000);
+      wait = &timeout;
+    }
+    pollfd readable{
+      .fd = console.descriptor(), .events = POLLIN, .revents = 0
+    };
+    ppoll(&readable, 1, wait, nullptr);
+    deliver();
+  };
+}
@@ -0,0 +1,292 @@
+// Copyright 2024 Khalil Estell
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <algorithm>
+#include <cstdlib>
+#include <limits>
+#include <utility>
+
+#include "simulation.hpp"
+
+hal::u64 host_clock::now()
+{
+  m_now += read_cost;
+  return m_now;
+}
+
+void host_clock::advance_to(hal::u64 p_time)
+{
+  m_now = std::max(m_now, p_time);
+}
+
+hal::hertz host_clock::driver_frequency()
+{
+  return 1'000'000'000.0f;
+}
+
+hal::u64 host_clock::driver_uptime()
+{
+  return now();
+}
+
+void host_led::driver_configure(settings const&)
+{
+}
+
+void host_led::driver_level(bool p_high)
+{
+  m_level = p_high;
+}
+
+bool host_led::driver_level()
+{
+  return m_level;
+}
+
+frame_generator_settings generator_settings_from_environment(
+  float p_default_load)
+{
+  auto const number = [](char const* p_name, auto p_default) {
+    auto const* value = std::getenv(p_name);
+    if (value == nullptr or *value == '\0') {
+      return p_default;
+    }
+    return static_cast<decltype(p_default)>(std::strtod(value, nullptr));
+  };
+
+  frame_generator_settings settings{};
+  settings.load = number("CAN_OPENER_HOST_LOAD", p_default_load * 100) / 100;
+  settings.first_id = number("CAN_OPENER_HOST_FIRST_ID", settings.first_id);
+  settings.id_count = number("CAN_OPENER_HOST_ID_COUNT", settings.id_count);
+  settings.length = number("CAN_OPENER_HOST_LENGTH", settings.length);
+  settings.error_rate =
+    number("CAN_OPENER_HOST_ERROR_RATE", settings.error_rate);
+  return settings;
+}
+
+simulated_can_bus::simulated_can_bus(
+  std::span<hal::can_message> p_receive_buffer,
+  frame_generator_settings p_settings)
+  : m_receive_buffer(p_receive_buffer)
+  , m_settings(p_settings)
+{
+  m_settings.length = std::min<hal::u8>(m_settings.length, 8);
+  m_settings.id_count = std::max<hal::u32>(m_settings.id_count, 1);
+  schedule_next(0);
+  if (m_settings.error_rate > 0.0f) {
+    m_next_error = static_cast<hal::u64>(1e9f / m_settings.error_rate);
+  }
+}
+
+void simulated_can_bus::deliver(hal::u64 p_now)
+{
+  constexpr auto never = std::numeric_limits<hal::u64>::max();
+
+  if (m_bus_on_requested and m_bus_off and not m_recovered_at) {
+    m_recovered_at = p_now + bit_time(128 * 11);
+  }
+  m_bus_on_requested = false;
+
+  // Frames, bus errors and the end of bus off recovery, in the order they
+  // happen
+  while (true) {
+    auto const recovery = m_recovered_at.value_or(never);
+    auto const error = m_next_error.value_or(never);
+    auto const arrival = m_next_arrival.value_or(never);
+    auto const due = std::min({ recovery, error, arrival });
+    if (due > p_now) {
+      break;
+    }
+
+    if (due == recovery) {
+      m_bus_off = false;
+      m_transmit_errors = 0;
+      m_recovered_at.reset();
+      continue;
+    }
+    if (due == error) {
+      bus_error(due);
+      continue;
+    }
+
+    if (m_bus_off) {
+      // A controller that is bus off receives nothing, the frame is lost
+      m_generated++;
+      schedule_next(due);
+      continue;
+    }
+    if (m_transmit_errors > 0) {
+      m_transmit_errors--;
+    }
+
+    auto const sequence = m_generated;
+
+    // Like a real controller, overwrite the oldest frame if nobody read it
+    m_receive_buffer[m_cursor] = next_frame();
+    auto const& frame = m_receive_buffer[m_cursor];
+    m_generated++;
+    m_cursor = (m_cursor + 1) % m_receive_buffer.size();
+
+    if (m_receive_handler) {
+      (*m_receive_handler)(on_receive_tag{}, frame);
+    }
+    if (m_delivered_handler) {
+      (*m_delivered_handler)(sequence, due);
+    }
+
+    schedule_next(due);
+  }
+}
+
+std::optional<hal::u64> simulated_can_bus::next_arrival() const
+{
+  std::optional<hal::u64> next = m_next_arrival;
+  for (auto const& other : { m_next_error, m_recovered_at }) {
+    if (other) {
+      next = std::min(next.value_or(*other), *other);
+    }
+  }
+  return next;
+}
+
+can_error_state simulated_can_bus::error_state() const
+{
+  return {
+    .transmit_errors = static_cast<hal::u8>(std::min(m_transmit_errors, 255U)),
+    .bus_off = m_bus_off,
+    .bus_errors = m_bus_errors,
+  };
+}
+
+void simulated_can_bus::on_delivered(delivered_handler p_handler)
+{
+  m_delivered_handler = std::move(p_handler);
+}
+
+void simulated_can_bus::on_sent(sent_handler p_handler)
+{
+  m_sent_handler = std::move(p_handler);
+}
+
+hal::u32 simulated_can_bus::frame_bits(hal::can_message const& p_message)
+{
+  // SOF, arbitration, control, CRC, ACK and EOF fields, plus 3 bits of
+  // interframe space
+  hal::u32 const overhead = p_message.extended() ? 67 : 47;
+  hal::u32 const data =
+    p_message.remote_request() ? 0 : std::min<hal::u32>(p_message.length, 8);
+  return overhead + (data * 8);
+}
+
+hal::can_message simulated_can_bus::next_frame() const
+{
+  hal::can_message frame{};
+  frame.id(m_settings.first_id + (m_generated % m_settings.id_count));
+  frame.length = m_settings.length;
+  for (std::size_t i = 0; i < frame.length; i++) {
+    frame.payload[i] = static_cast<hal::byte>(m_generated >> ((i % 4) * 8));
+  }
+  return frame;
+}
+
+void simulated_can_bus::bus_error(hal::u64 p_due)
+{
+  m_next_error = p_due + static_cast<hal::u64>(1e9f / m_settings.error_rate);
+  // A controller that is bus off does not take part in the bus
+  if (m_bus_off) {
+    return;
+  }
+
+  m_bus_errors++;
+  m_transmit_errors += 8;
+  if (m_transmit_errors > 255) {
+    m_bus_off = true;
+    if (m_bus_off_handler) {
+      (*m_bus_off_handler)(bus_off_tag{});
+    }
+  }
+}
+
+hal::u64 simulated_can_bus::bit_time(hal::u32 p_bits) const
+{
+  return (hal::u64{ p_bits } * 1'000'000'000) / m_baud_rate;
+}
+
+void simulated_can_bus::schedule_next(hal::u64 p_from)
+{
+  if (m_settings.load <= 0.0f) {
+    m_next_arrival.reset();
+    return;
+  }
+
+  // At full load frames follow each other back to back
+  auto const bits = frame_bits(next_frame());
+  auto const frame_time = (bits * 1e9) / m_baud_rate;
+  auto const interval = frame_time / std::min(m_settings.load, 1.0f);
+  m_next_arrival = p_from + static_cast<hal::u64>(interval);
+}
+
+hal::u32 simulated_can_bus::driver_baud_rate()
+{
+  return m_baud_rate;
+}
+
+void simulated_can_bus::driver_send(hal::can_message const& p_message)
+{
+  // Nothing else is on the bus to receive it
+  m_transmitted++;
+  if (m_sent_handler) {
+    (*m_sent_handler)(p_message);
+  }
+}
+
+std::span<hal::can_message const> simulated_can_bus::driver_receive_buffer()
+{
+  return m_receive_buffer;
+}
+
+std::size_t simulated_can_bus::driver_receive_cursor()
+{
+  return m_cursor;
+}
+
+void simulated_can_bus::driver_baud_rate(hal::hertz p_hertz)
+{
+  m_baud_rate = static_cast<hal::u32>(p_hertz);
+  if (m_next_arrival) {
+    schedule_next(*m_next_arrival);
+  }
+}
+
+void simulated_can_bus::driver_filter_mode(accept)
+{
+}
+
+void simulated_can_bus::driver_on_bus_off(
+  std::optional<hal::callback<bus_off_handler>>& p_callback)
+{
+  m_bus_off_handler = p_callback;
+}
+
+void simulated_can_bus::driver_bus_on()
+{
+  // Recovery starts on the next delivery, which knows the time
+  m_bus_on_requested = true;
+}
+
+void simulated_can_bus::driver_on_receive(
+  std::optional<hal::callback<handler>>& p_callback)
+{
+  m_receive_handler = p_callback;
+}
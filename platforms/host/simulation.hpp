@@ -0,0 +1,232 @@
+// Copyright 2024 Khalil Estell
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <cstddef>
+#include <optional>
+#include <span>
+
+#include <libhal/can.hpp>
+#include <libhal/functional.hpp>
+#include <libhal/output_pin.hpp>
+#include <libhal/steady_clock.hpp>
+#include <libhal/units.hpp>
+
+#include <app/bus_monitor.hpp>
+
+/**
+ * @brief Simulated uptime clock the host platforms advance
+ *
+ * Time only moves when the platform advances it and by read_cost with every
+ * reading, which stands in for the time the code taking it runs and lets busy
+ * waits end. Runs driven by it come out the same whatever else the host is
+ * doing.
+ */
+class host_clock : public hal::steady_clock
+{
+public:
+  /// Simulated nanoseconds each reading of the clock takes
+  static constexpr hal::u64 read_cost = 100;
+
+  /// Nanoseconds since start up, after taking a reading's cost
+  hal::u64 now();
+
+  /**
+   * @brief Move time forward
+   *
+   * @param p_time - nanoseconds since start up, earlier times are ignored
+   */
+  void advance_to(hal::u64 p_time);
+
+private:
+  hal::hertz driver_frequency() override;
+  hal::u64 driver_uptime() override;
+
+  hal::u64 m_now = 0;
+};
+
+/// An LED nobody can see
+class host_led : public hal::output_pin
+{
+private:
+  void driver_configure(settings const& p_settings) override;
+  void driver_level(bool p_high) override;
+  bool driver_level() override;
+
+  bool m_level = false;
+};
+
+/**
+ * @brief Settings for the frames a simulated bus generates
+ */
+struct frame_generator_settings
+{
+  /// Fraction of the bus bandwidth to fill with received frames, 0 for none
+  float load = 0.0f;
+  /// First standard ID generated, IDs count up from here
+  hal::u32 first_id = 0x100;
+  /// Number of distinct IDs cycled through
+  hal::u32 id_count = 16;
+  /// Payload bytes in each frame, the first four carry a sequence number
+  hal::u8 length = 8;
+  /// Bus errors per second, 0 for none
+  float error_rate = 0.0f;
+};
+
+/**
+ * @brief Read frame generator settings from the environment
+ *
+ * CAN_OPENER_HOST_LOAD sets the bus load in percent,
+ * CAN_OPENER_HOST_FIRST_ID and CAN_OPENER_HOST_ID_COUNT the IDs generated and
+ * CAN_OPENER_HOST_LENGTH the payload length and CAN_OPENER_HOST_ERROR_RATE
+ * the bus errors per second. Unset variables keep their defaults.
+ *
+ * @param p_default_load - bus load, as a fraction, if none is set
+ * @return frame_generator_settings - settings to generate frames with
+ */
+frame_generator_settings generator_settings_from_environment(
+  float p_default_load);
+
+/**
+ * @brief In-memory CAN bus with a frame generator and a bit-rate model
+ *
+ * Stands in for the transceiver, bus manager and receive interrupt of a real
+ * controller. Generated frames arrive at the rate a bus at the configured
+ * load and baud rate would deliver them. Each frame takes its nominal bit
+ * count, without stuffing, at the baud rate set through the bus manager.
+ * Frames carry a little endian sequence number in their first four payload
+ * bytes so a consumer can match them up.
+ *
+ * Frames are written into the receive buffer and announced to the receive
+ * handler from deliver(), which the platform calls from the main loop in
+ * place of a real interrupt.
+ *
+ * Bus errors hit the node's own transmissions, each one adding 8 to the
+ * transmit error counter while every delivered frame takes 1 off. More than
+ * one error per eight frames drives the controller through error warning and
+ * error passive to bus off. Once bus on is requested, the controller rejoins
+ * the bus after 128 idle periods of 11 bits, with both counters cleared.
+ * Frames due while bus off are lost. Nothing else transmits, so arbitration
+ * is never lost.
+ */
+class simulated_can_bus
+  : public hal::can_transceiver
+  , public hal::can_bus_manager
+  , public hal::can_interrupt
+{
+public:
+  using delivered_handler = hal::callback<void(hal::u32, hal::u64)>;
+  using sent_handler = hal::callback<void(hal::can_message const&)>;
+
+  /**
+   * @param p_receive_buffer - storage for received frames
+   * @param p_settings - frames to generate
+   */
+  simulated_can_bus(std::span<hal::can_message> p_receive_buffer,
+                    frame_generator_settings p_settings);
+
+  /**
+   * @brief Deliver every generated frame due by now
+   *
+   * @param p_now - current time in nanoseconds
+   */
+  void deliver(hal::u64 p_now);
+
+  /**
+   * @return std::optional<hal::u64> - time in nanoseconds the next frame or
+   * bus error is due, or std::nullopt if neither is generated
+   */
+  std::optional<hal::u64> next_arrival() const;
+
+  /// Error counters, in the form the platform reports them
+  can_error_state error_state() const;
+
+  /**
+   * @brief Get told the sequence number and due time of each delivered frame
+   *
+   * @param p_handler - called after the receive handler for each frame
+   */
+  void on_delivered(delivered_handler p_handler);
+
+  /**
+   * @brief Get told about each frame the application transmits
+   *
+   * @param p_handler - called with each frame as it is sent
+   */
+  void on_sent(sent_handler p_handler);
+
+  hal::u32 generated() const
+  {
+    return m_generated;
+  }
+
+  hal::u32 transmitted() const
+  {
+    return m_transmitted;
+  }
+
+  /**
+   * @brief Nominal bits a frame occupies on the bus
+   *
+   * Includes the interframe space but not stuff bits.
+   *
+   * @param p_message - frame to measure
+   * @return hal::u32 - bits on the bus
+   */
+  static hal::u32 frame_bits(hal::can_message const& p_message);
+
+private:
+  // can_transceiver
+  hal::u32 driver_baud_rate() override;
+  void driver_send(hal::can_message const& p_message) override;
+  std::span<hal::can_message const> driver_receive_buffer() override;
+  std::size_t driver_receive_cursor() override;
+
+  // can_bus_manager
+  void driver_baud_rate(hal::hertz p_hertz) override;
+  void driver_filter_mode(accept p_accept) override;
+  void driver_on_bus_off(
+    std::optional<hal::callback<bus_off_handler>>& p_callback) override;
+  void driver_bus_on() override;
+
+  // can_interrupt
+  void driver_on_receive(
+    std::optional<hal::callback<handler>>& p_callback) override;
+
+  hal::can_message next_frame() const;
+  void schedule_next(hal::u64 p_from);
+  void bus_error(hal::u64 p_due);
+  /// Time a number of bits take on the bus, in nanoseconds
+  hal::u64 bit_time(hal::u32 p_bits) const;
+
+  std::span<hal::can_message> m_receive_buffer;
+  std::size_t m_cursor = 0;
+  frame_generator_settings m_settings;
+  hal::u32 m_baud_rate = 100'000;
+  std::optional<hal::u64> m_next_arrival;
+  std::optional<hal::u64> m_next_error;
+  // Transmit error count, counted past 255 to tell when it goes bus off
+  hal::u32 m_transmit_errors = 0;
+  bool m_bus_off = false;
+  hal::u32 m_bus_errors = 0;
+  bool m_bus_on_requested = false;
+  std::optional<hal::u64> m_recovered_at;
+  hal::u32 m_generated = 0;
+  hal::u32 m_transmitted = 0;
+  std::optional<hal::callback<handler>> m_receive_handler;
+  std::optional<hal::callback<bus_off_handler>> m_bus_off_handler;
+  std::optional<delivered_handler> m_delivered_handler;
+  std::optional<sent_handler> m_sent_handler;
+};
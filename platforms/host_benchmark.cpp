@@ -0,0 +1,394 @@
+// Copyright 2024 Khalil Estell
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Runs the application against a simulated bus at a set load and reports how
+// well it keeps up. Settings come from the environment:
+//
+//   CAN_OPENER_HOST_LOAD       bus load in percent, defaults to 50
+//   CAN_OPENER_BENCH_SECONDS   how long to generate frames, defaults to 5
+//   CAN_OPENER_BENCH_SETUP     commands sent first, defaults to
+//                              "UA\rS8\rO\r"
+//   CAN_OPENER_BENCH_MAX_DROPS exit with failure above this many drops
+//   CAN_OPENER_BENCH_MAX_P99   exit with failure above this p99 latency in us
+//
+// along with the frame generator settings read by
+// generator_settings_from_environment(). The setup commands must leave the
+// application forwarding frames as text. The console drains at the baud rate
+// it is configured to, 115200 until a 'U' command changes it, so the default
+// setup switches it to 2 Mbaud first.
+//
+// Time is simulated by host_clock and skips ahead whenever the application
+// waits for work, so a run takes less than its simulated duration and gives
+// the same results however busy the host is.
+
+#include <algorithm>
+#include <array>
+#include <cstdio>
+#include <cstdlib>
+#include <limits>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include <libhal/serial.hpp>
+
+#include <app/config.hpp>
+#include <app/resource_list.hpp>
+
+#include "host/simulation.hpp"
+
+namespace {
+/// Time given to frames still in flight after generation stops
+constexpr hal::u64 settle_time = 100'000'000;
+/// Bytes the console's transmit buffer holds, like a UART's DMA buffer
+constexpr std::size_t console_transmit_buffer = 64;
+/// Baud rate the console starts at, as on the boards
+constexpr hal::u32 initial_console_baud_rate = 115'200;
+
+double environment(char const* p_name, double p_default)
+{
+  auto const* value = std::getenv(p_name);
+  if (value == nullptr or *value == '\0') {
+    return p_default;
+  }
+  return std::strtod(value, nullptr);
+}
+
+hal::u32 hex_value(std::string_view p_hex)
+{
+  return std::strtoul(std::string(p_hex).c_str(), nullptr, 16);
+}
+
+/**
+ * @brief Records when each generated frame was due and how long it took to
+ * reach the console
+ */
+class latency_recorder
+{
+public:
+  latency_recorder()
+  {
+    m_latencies.reserve(1 << 20);
+  }
+
+  void delivered(hal::u32 p_sequence, hal::u64 p_due)
+  {
+    m_due[p_sequence % m_due.size()] = { p_sequence, p_due };
+  }
+
+  /**
+   * @param p_sequence - sequence number of the forwarded frame
+   * @param p_sent - time in nanoseconds its last character left the console
+   */
+  void forwarded(hal::u32 p_sequence, hal::u64 p_sent)
+  {
+    auto const& [sequence, due] = m_due[p_sequence % m_due.size()];
+    if (sequence == p_sequence) {
+      m_latencies.push_back(p_sent - due);
+    }
+    m_forwarded++;
+  }
+
+  hal::u32 forwarded_count() const
+  {
+    return m_forwarded;
+  }
+
+  /// Latency in microseconds at a fraction of the way through the samples
+  double percentile(double p_fraction)
+  {
+    if (m_latencies.empty()) {
+      return 0.0;
+    }
+    auto const position = static_cast<std::size_t>(
+      p_fraction * static_cast<double>(m_latencies.size() - 1));
+    std::nth_element(m_latencies.begin(),
+                     m_latencies.begin() + position,
+                     m_latencies.end());
+    return m_latencies[position] / 1e3;
+  }
+
+private:
+  struct due_frame
+  {
+    hal::u32 sequence = 0xFFFF'FFFF;
+    hal::u64 due = 0;
+  };
+
+  std::vector<due_frame> m_due = std::vector<due_frame>(1 << 16);
+  std::vector<hal::u64> m_latencies;
+  hal::u32 m_forwarded = 0;
+};
+
+/**
+ * @brief Console that types the setup commands and reads what comes back
+ *
+ * Output goes out at the configured baud rate, ten bits per byte, through a
+ * transmit buffer of console_transmit_buffer bytes. Writes only take what
+ * fits in the buffer, so a console slower than the bus backs up into the
+ * application's own buffers just as a real UART would.
+ *
+ * Forwarded frames are matched up with the recorder by the sequence number in
+ * their first four payload bytes, at the time their last character leaves
+ * the console. The answer to the final 'I' command ends the benchmark.
+ */
+class scripted_console : public hal::serial
+{
+public:
+  using finished_handler = hal::callback<void(std::string_view)>;
+
+  scripted_console(host_clock& p_clock,
+                   latency_recorder& p_recorder,
+                   std::string p_input)
+    : m_clock(&p_clock)
+    , m_recorder(&p_recorder)
+    , m_input(std::move(p_input))
+  {
+  }
+
+  void type(std::string_view p_input)
+  {
+    m_input.append(p_input);
+  }
+
+  void on_finished(finished_handler p_handler)
+  {
+    m_finished = std::move(p_handler);
+  }
+
+  /// Time the transmit buffer has room for another byte
+  hal::u64 room_at() const
+  {
+    auto const draining = (console_transmit_buffer - 1) * byte_time();
+    return m_idle_at > draining ? m_idle_at - draining : 0;
+  }
+
+  std::size_t write_nonblocking(std::span<hal::byte const> p_data)
+  {
+    auto const now = m_clock->now();
+    auto const byte_time = this->byte_time();
+    auto sent = std::max(m_idle_at, now);
+    auto const buffered = (sent - now + byte_time - 1) / byte_time;
+    auto const accepted =
+      std::min(p_data.size(), console_transmit_buffer - buffered);
+
+    for (auto const byte : p_data.first(accepted)) {
+      sent += byte_time;
+      if (byte == '\r' or byte == '\a') {
+        line(m_line, sent);
+        m_line.clear();
+      } else {
+        m_line.push_back(static_cast<char>(byte));
+      }
+    }
+    m_idle_at = sent;
+    return accepted;
+  }
+
+private:
+  /// Nanoseconds a byte takes on the wire, ten bits at the baud rate
+  hal::u64 byte_time() const
+  {
+    return 10'000'000'000 / m_baud_rate;
+  }
+
+  /**
+   * @param p_line - line without its CR or BELL
+   * @param p_sent - time in nanoseconds its last character left the console
+   */
+  void line(std::string_view p_line, hal::u64 p_sent)
+  {
+    if (p_line.empty()) {
+      return;
+    }
+
+    // Builds with several channels tag each frame with its channel's digit
+    if (p_line[0] >= '0' and p_line[0] <= '9') {
+      p_line.remove_prefix(1);
+    }
+
+    // Frames forwarded as 'tiiil<payload>' with at least four payload bytes
+    constexpr std::size_t payload_start = 5;
+    if (p_line[0] == 't' and p_line.size() >= payload_start + 8) {
+      hal::u32 sequence = 0;
+      for (std::size_t i = 0; i < 4; i++) {
+        auto const byte = p_line.substr(payload_start + (i * 2), 2);
+        sequence |= hex_value(byte) << (i * 8);
+      }
+      m_recorder->forwarded(sequence, p_sent);
+    } else if (p_line[0] == 'I' and m_finished) {
+      (*m_finished)(p_line.substr(1));
+    }
+  }
+
+  void driver_configure(settings const& p_settings) override
+  {
+    m_baud_rate = static_cast<hal::u32>(p_settings.baud_rate);
+  }
+
+  write_t driver_write(std::span<hal::byte const> p_data) override
+  {
+    return { .data = p_data.first(write_nonblocking(p_data)) };
+  }
+
+  read_t driver_read(std::span<hal::byte> p_data) override
+  {
+    auto const count = std::min(p_data.size(), m_input.size() - m_read);
+    std::copy_n(m_input.begin() + m_read, count, p_data.begin());
+    m_read += count;
+    return {
+      .data = p_data.first(count),
+      .available = m_input.size() - m_read,
+      .capacity = m_input.capacity(),
+    };
+  }
+
+  void driver_flush() override
+  {
+    m_read = m_input.size();
+  }
+
+  host_clock* m_clock;
+  latency_recorder* m_recorder;
+  hal::u32 m_baud_rate = initial_console_baud_rate;
+  // Time the transmit buffer runs empty
+  hal::u64 m_idle_at = 0;
+  std::string m_input;
+  std::size_t m_read = 0;
+  std::string m_line;
+  std::optional<finished_handler> m_finished;
+};
+}  // namespace
+
+void initialize_platform(resource_list& p_map)
+{
+  static host_clock clock;
+  static host_led led;
+  static latency_recorder recorder;
+
+  auto const* setup = std::getenv("CAN_OPENER_BENCH_SETUP");
+  static scripted_console console(
+    clock, recorder, setup ? setup : "UA\rS8\rO\r");
+
+  static std::array<hal::can_message, receive_depth> can_receive_buffer{};
+  static auto const settings = generator_settings_from_environment(0.5f);
+  static simulated_can_bus bus(can_receive_buffer, settings);
+  bus.on_delivered([](hal::u32 p_sequence, hal::u64 p_due) {
+    recorder.delivered(p_sequence, p_due);
+  });
+
+  p_map.reset = +[]() { std::exit(EXIT_SUCCESS); };
+  p_map.red_led = &led;
+  p_map.clock = &clock;
+  p_map.console = &console;
+  p_map.console_write_nonblocking =
+    [](std::span<hal::byte const> p_data) -> std::size_t {
+    return console.write_nonblocking(p_data);
+  };
+  // Frames are generated on the first channel only, any others stay idle
+  static std::array<std::array<hal::can_message, receive_depth>,
+                    channel_count - 1>
+    idle_receive_buffers{};
+  static std::array<std::optional<simulated_can_bus>, channel_count - 1>
+    idle_buses{};
+  for (std::size_t i = 0; i < channel_count; i++) {
+    auto* channel_bus = &bus;
+    if (i > 0) {
+      channel_bus = &idle_buses[i - 1].emplace(idle_receive_buffers[i - 1],
+                                               frame_generator_settings{});
+    }
+    auto& can = p_map.can_channels[i];
+    can.transceiver = channel_bus;
+    can.bus_manager = channel_bus;
+    can.interrupt = channel_bus;
+    can.error_state = [channel_bus]() { return channel_bus->error_state(); };
+  }
+
+  static auto const duration = static_cast<hal::u64>(
+    environment("CAN_OPENER_BENCH_SECONDS", 5.0) * 1e9);
+
+  console.on_finished([](std::string_view p_statistics) {
+    auto const field = [p_statistics](std::size_t p_index) {
+      return hex_value(p_statistics.substr(p_index * 8, 8));
+    };
+    auto const seconds = duration / 1e9;
+    auto const generated = bus.generated();
+    auto const forwarded = recorder.forwarded_count();
+    auto const dropped = generated - std::min(generated, forwarded);
+    auto const p99 = recorder.percentile(0.99);
+
+    std::printf("bus load:          %.1f%% at %u bit/s\n",
+                settings.load * 100.0,
+                static_cast<hal::can_transceiver&>(bus).baud_rate());
+    std::printf("frames generated:  %u\n", generated);
+    std::printf("frames forwarded:  %u (%.0f frames/s)\n",
+                forwarded,
+                forwarded / seconds);
+    std::printf("frames dropped:    %u (%u receive overflows)\n",
+                dropped,
+                field(2));
+    std::printf("latency (us):      p50 %.1f  p90 %.1f  p99 %.1f  max %.1f\n",
+                recorder.percentile(0.5),
+                recorder.percentile(0.9),
+                p99,
+                recorder.percentile(1.0));
+    std::printf("loop pass (us):    shortest %u  longest %u\n",
+                field(12),
+                field(13));
+    std::printf("bus errors:        %u (%u times bus off)\n",
+                bus.error_state().bus_errors,
+                field(14));
+
+    bool const passed =
+      dropped <= environment("CAN_OPENER_BENCH_MAX_DROPS", 1e12) and
+      p99 <= environment("CAN_OPENER_BENCH_MAX_P99", 1e12);
+    std::exit(passed ? EXIT_SUCCESS : EXIT_FAILURE);
+  });
+
+  static bool finishing = false;
+  p_map.wait_for_work = [](hal::callback<bool()> p_has_work) {
+    auto const now = clock.now();
+    bus.deliver(std::min(now, duration));
+    if (now >= duration + settle_time and not finishing) {
+      // Ask for the statistics, the answer ends the benchmark
+      console.type("I\r");
+      finishing = true;
+    }
+
+    // Passes cost only the clock readings they take, so the latency is down
+    // to the bus, the console's time on the wire and the order the
+    // application handles things in
+    if (p_has_work() and console.room_at() <= now) {
+      return;
+    }
+
+    // Nothing changes for the application until the next frame arrives, the
+    // console has room again or the statistics are due
+    auto next = std::numeric_limits<hal::u64>::max();
+    if (auto const arrival = bus.next_arrival(); arrival < duration) {
+      next = *arrival;
+    }
+    if (console.room_at() > now) {
+      next = std::min(next, console.room_at());
+    }
+    if (not finishing) {
+      next = std::min(next, duration + settle_time);
+    }
+    if (next != std::numeric_limits<hal::u64>::max()) {
+      clock.advance_to(next);
+    }
+  };
+}
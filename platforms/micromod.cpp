@@ -14,8 +14,12 @@
 
 #include <libhal-micromod/micromod.hpp>
 
+#include <app/config.hpp>
 #include <app/resource_list.hpp>
 
+static_assert(channel_count == 1,
+              "The MicroMod API exposes a single CAN controller");
+
 void initialize_platform(resource_list& p_map)
 {
   using namespace hal::literals;
@@ -35,10 +39,33 @@ void initialize_platform(resource_list& p_map)
   });
 
   p_map.console = &console;
+  // The MicroMod console only offers blocking writes, so
+  // console_write_nonblocking is left empty and the application writes out
+  // its whole output buffer each pass.
+
+  // The application reads received frames straight out of this buffer
+  static std::array<hal::can_message, receive_depth> can_receive_buffer{};
+  auto& can = p_map.can_channels[0];
+  can.transceiver = &v1::can_transceiver(can_receive_buffer);
+  // The MicroMod API does not report free transmit mailboxes, so
+  // send_nonblocking is left empty and one message is sent per pass.
+  can.bus_manager = &v1::can_bus_manager();
+  can.interrupt = &v1::can_interrupt();
+  // Only list the filter banks the MicroMod API exposes. More banks of any
+  // type can be added to these lists and the application will use them.
+  static std::array<hal::can_extended_mask_filter*, 1> extended_mask_filters{
+    &v1::can_extended_mask_filter0(),
+  };
+  can.extended_mask_filters = extended_mask_filters;
 
-  static std::array<hal::can_message, 32> can_receive_buffer{};
-  p_map.can_transceiver = &v1::can_transceiver(can_receive_buffer);
-  p_map.can_bus_manager = &v1::can_bus_manager();
-  p_map.can_interrupt = &v1::can_interrupt();
-  p_map.can_mask_filter = &v1::can_extended_mask_filter0();
+  p_map.wait_for_work = [](hal::callback<bool()> p_has_work) {
+    // Mask interrupts so that a CAN or UART interrupt arriving after the check
+    // stays pending. A pending interrupt wakes the core from WFI even while
+    // masked and is serviced as soon as interrupts are unmasked again.
+    asm volatile("cpsid i" ::: "memory");
+    if (not p_has_work()) {
+      asm volatile("wfi" ::: "memory");
+    }
+    asm volatile("cpsie i" ::: "memory");
+  };
 }
@@ -0,0 +1,180 @@
+// Copyright 2024 Khalil Estell
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <array>
+#include <random>
+#include <span>
+#include <vector>
+
+#include <app/binary_frame.hpp>
+#include <app/slcan.hpp>
+
+#include <boost/ut.hpp>
+
+namespace {
+binary_frame random_frame(std::mt19937& p_random)
+{
+  binary_frame frame{};
+  auto& message = frame.message;
+  bool const extended = p_random() & 1;
+  message.extended(extended);
+  message.remote_request((p_random() & 3) == 0);
+  message.id(p_random() & (extended ? 0x1FFF'FFFF : 0x7FF));
+  message.length = p_random() % 9;
+  for (auto& byte : message.payload) {
+    byte = static_cast<hal::byte>(p_random());
+  }
+  frame.sequence = static_cast<hal::u8>(p_random());
+  if (p_random() & 1) {
+    frame.timestamp = p_random();
+  }
+  if (p_random() & 1) {
+    frame.channel = static_cast<hal::u8>(p_random());
+  }
+  return frame;
+}
+
+bool same_frame(binary_frame const& p_left, binary_frame const& p_right)
+{
+  auto const& left = p_left.message;
+  auto const& right = p_right.message;
+  if (left.id() != right.id() or left.extended() != right.extended() or
+      left.remote_request() != right.remote_request() or
+      left.length != right.length or p_left.sequence != p_right.sequence or
+      p_left.timestamp != p_right.timestamp or
+      p_left.channel != p_right.channel) {
+    return false;
+  }
+  // Remote requests carry a length but no payload
+  if (left.remote_request()) {
+    return true;
+  }
+  for (std::size_t i = 0; i < left.length; i++) {
+    if (left.payload[i] != right.payload[i]) {
+      return false;
+    }
+  }
+  return true;
+}
+
+std::vector<hal::byte> encode(binary_frame const& p_frame)
+{
+  std::array<hal::byte, max_binary_frame_size> buffer{};
+  auto const length = encode_binary_frame(buffer, p_frame);
+  return { buffer.begin(), buffer.begin() + length };
+}
+}  // namespace
+
+void binary_frame_test()
+{
+  using namespace boost::ut;
+
+  "decode_binary_frame reads back what encode_binary_frame writes"_test =
+    []() {
+      std::mt19937 random(4);
+      std::size_t mismatches = 0;
+      std::size_t wrong_sizes = 0;
+      for (int i = 0; i < 100'000; i++) {
+        auto const frame = random_frame(random);
+        auto const record = encode(frame);
+        if (record.size() != binary_frame_size(record[1])) {
+          wrong_sizes++;
+        }
+        auto const decoded = decode_binary_frame(record);
+        if (not decoded or not same_frame(*decoded, frame)) {
+          mismatches++;
+        }
+      }
+      expect(wrong_sizes == 0) << wrong_sizes << " records sized wrong";
+      expect(mismatches == 0) << mismatches << " frames differ";
+    };
+
+  "encode_binary_frame writes the documented layout"_test = []() {
+    binary_frame frame{};
+    frame.message.id(0x123).length = 2;
+    frame.message.payload[0] = 0xAB;
+    frame.message.payload[1] = 0xCD;
+    frame.sequence = 7;
+    expect(encode(frame) ==
+           std::vector<hal::byte>{ 0xA5, 0x20, 0x07, 0x23, 0x01, 0xAB, 0xCD });
+
+    frame.message.extended(true).id(0x1234'5678);
+    frame.message.remote_request(true);
+    frame.timestamp = 0xDEAD'BEEF;
+    frame.channel = 2;
+    expect(encode(frame) == std::vector<hal::byte>{ 0xA5,
+                                                   0x2F,
+                                                   0x07,
+                                                   0x02,
+                                                   0x78,
+                                                   0x56,
+                                                   0x34,
+                                                   0x12,
+                                                   0xEF,
+                                                   0xBE,
+                                                   0xAD,
+                                                   0xDE });
+  };
+
+  "the largest record fits max_binary_frame_size"_test = []() {
+    binary_frame frame{};
+    frame.message.extended(true).id(0x1FFF'FFFF).length = 8;
+    frame.timestamp = 0;
+    frame.channel = 0;
+    expect(encode(frame).size() == max_binary_frame_size);
+  };
+
+  "decode_binary_frame rejects bad records"_test = []() {
+    binary_frame frame{};
+    frame.message.extended(true).id(0x1234'5678).length = 8;
+    frame.timestamp = 1;
+    frame.channel = 1;
+    auto const record = encode(frame);
+    std::span<hal::byte const> const whole(record);
+
+    expect(decode_binary_frame(whole).has_value());
+    for (std::size_t size = 0; size < record.size(); size++) {
+      expect(not decode_binary_frame(whole.first(size))) << size;
+    }
+
+    auto no_sync = record;
+    no_sync[0] = '\r';
+    expect(not decode_binary_frame(no_sync));
+
+    for (hal::byte length = 9; length < 16; length++) {
+      auto too_long = record;
+      too_long[1] = (too_long[1] & 0xF) | (length << binary_frame_length_shift);
+      too_long.resize(max_binary_frame_size * 2);
+      expect(not decode_binary_frame(too_long)) << int(length);
+    }
+  };
+
+  "records are smaller than slcan text"_test = []() {
+    std::mt19937 random(5);
+    std::size_t binary_bytes = 0;
+    std::size_t text_bytes = 0;
+    for (int i = 0; i < 10'000; i++) {
+      auto frame = random_frame(random);
+      frame.timestamp.reset();
+      frame.channel.reset();
+      binary_bytes += encode(frame).size();
+
+      std::array<hal::byte, max_encoded_message_size> text{};
+      text_bytes += encode_can_message(text, frame.message);
+    }
+    // Each payload byte takes one byte rather than two characters
+    expect(binary_bytes * 3 < text_bytes * 2)
+      << binary_bytes << " binary bytes against " << text_bytes << " text";
+  };
+}
@@ -0,0 +1,115 @@
+// Copyright 2024 Khalil Estell
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <optional>
+
+#include <app/bus_monitor.hpp>
+
+#include <boost/ut.hpp>
+
+namespace {
+constexpr hal::u32 interval = 100;
+
+can_error_state counters(hal::u8 p_transmit_errors, bool p_bus_off = false)
+{
+  return { .transmit_errors = p_transmit_errors, .bus_off = p_bus_off };
+}
+
+/// One main loop pass as monitor_bus_errors makes it
+std::optional<error_event> pass(bus_monitor& p_monitor,
+                                std::optional<can_error_state> p_counters,
+                                hal::u32 p_milliseconds)
+{
+  if (p_monitor.update(p_counters)) {
+    p_monitor.recovering();
+  }
+  return p_monitor.take_event(p_milliseconds, interval);
+}
+}  // namespace
+
+void bus_monitor_test()
+{
+  using namespace boost::ut;
+
+  "bus off is reported on a platform without error counters"_test = []() {
+    bus_monitor monitor;
+    expect(not pass(monitor, std::nullopt, 0));
+
+    // Only the interrupt tells, and recovery starts in the same pass
+    monitor.bus_off();
+    auto const off = pass(monitor, std::nullopt, 1);
+    expect(off and off->state == controller_state::bus_off);
+    expect(monitor.state() == controller_state::error_active);
+    expect(monitor.take_flags() == error_warning_flag);
+    expect(monitor.bus_off_count() == 1);
+
+    auto const recovered = pass(monitor, std::nullopt, 2);
+    expect(recovered and recovered->state == controller_state::error_active);
+    expect(not pass(monitor, std::nullopt, 3));
+  };
+
+  "bus off and recovery are reported from the error counters"_test = []() {
+    bus_monitor monitor;
+    expect(not pass(monitor, counters(0), 0));
+
+    auto const warning = pass(monitor, counters(100), 1);
+    expect(warning and warning->state == controller_state::error_warning);
+    expect(warning->transmit_errors == 100);
+    auto const passive = pass(monitor, counters(200), 2);
+    expect(passive and passive->state == controller_state::error_passive);
+
+    // The counters keep the controller bus off until it has rejoined
+    auto const off = pass(monitor, counters(255, true), 3);
+    expect(off and off->state == controller_state::bus_off);
+    expect(monitor.state() == controller_state::bus_off);
+    expect(not pass(monitor, counters(255, true), 4));
+
+    auto const recovered = pass(monitor, counters(0), 5);
+    expect(recovered and recovered->state == controller_state::error_active);
+    expect(monitor.take_flags() == (error_warning_flag | error_passive_flag));
+  };
+
+  "a bus off between two readings is still reported"_test = []() {
+    bus_monitor monitor;
+    expect(not pass(monitor, counters(0), 0));
+
+    monitor.bus_off();
+    auto const off = pass(monitor, counters(0), 1);
+    expect(off and off->state == controller_state::bus_off);
+    auto const recovered = pass(monitor, counters(0), 2);
+    expect(recovered and recovered->state == controller_state::error_active);
+    expect(monitor.bus_off_count() == 1);
+  };
+
+  "counter changes are reported at most once per interval"_test = []() {
+    bus_monitor monitor;
+    expect(not pass(monitor, counters(0), 0));
+
+    auto const first = pass(monitor, counters(1), interval);
+    expect(first and first->state == controller_state::error_active);
+    expect(not pass(monitor, counters(2), interval + 1));
+    auto const second = pass(monitor, counters(3), 2 * interval);
+    expect(second and second->transmit_errors == 3);
+  };
+
+  "events from before streaming was enabled are dropped"_test = []() {
+    bus_monitor monitor;
+    monitor.bus_off();
+    expect(monitor.update(std::nullopt));
+    monitor.recovering();
+
+    monitor.restart_events(10);
+    expect(not monitor.take_event(11, interval));
+  };
+}
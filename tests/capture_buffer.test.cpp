@@ -0,0 +1,165 @@
+// Copyright 2024 Khalil Estell
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <atomic>
+#include <cstddef>
+#include <thread>
+#include <vector>
+
+#include <app/capture_buffer.hpp>
+
+#include <boost/ut.hpp>
+
+namespace {
+struct decoded_record
+{
+  hal::u32 id = 0;
+  hal::u64 time = 0;
+  hal::byte first_byte = 0;
+};
+
+/// Decode a finished capture back into its frames and receive times
+template<std::size_t Size>
+std::vector<decoded_record> decode(capture_buffer<Size> const& p_capture)
+{
+  std::vector<hal::byte> bytes(p_capture.size());
+  p_capture.read(0, bytes);
+
+  std::vector<decoded_record> records;
+  auto time = p_capture.base_time();
+  std::size_t offset = 0;
+  while (offset < bytes.size()) {
+    auto const header = bytes[offset];
+    std::size_t const delta_size = (header >> 6) + 1;
+    std::size_t const id_size = (header & (1 << 4)) ? 4 : 2;
+
+    auto const read_le = [&bytes](std::size_t p_at, std::size_t p_size) {
+      hal::u64 value = 0;
+      for (std::size_t i = 0; i < p_size; i++) {
+        value |= hal::u64{ bytes[p_at + i] } << (i * 8);
+      }
+      return value;
+    };
+    time += read_le(offset + 1, delta_size);
+    auto const payload = offset + 1 + delta_size + id_size;
+    records.push_back({
+      .id = static_cast<hal::u32>(read_le(offset + 1 + delta_size, id_size)),
+      .time = time,
+      .first_byte = (header & 0xF) != 0 ? bytes[payload] : hal::byte{ 0 },
+    });
+    offset += capture_record_size(header);
+  }
+  return records;
+}
+
+hal::can_message frame(hal::u32 p_id, hal::byte p_first_byte)
+{
+  hal::can_message message{};
+  message.id(p_id).length = 1;
+  message.payload[0] = p_first_byte;
+  return message;
+}
+
+/// Receive time of the nth frame, with gaps taking 1 to 4 byte deltas
+hal::u64 receive_time(std::size_t p_index)
+{
+  constexpr std::array<hal::u64, 4> gaps{ 3, 700, 90'000, 20'000'000 };
+  hal::u64 time = 1'000;
+  for (std::size_t i = 0; i < p_index; i++) {
+    time += gaps[i % gaps.size()];
+  }
+  return time;
+}
+}  // namespace
+
+void capture_buffer_test()
+{
+  using namespace boost::ut;
+
+  "delta coded times survive the ring wrapping around"_test = []() {
+    // Small enough for the pre-trigger window to lap the ring many times
+    capture_buffer<64> capture;
+    capture_trigger const trigger{ .key = 0x700, .key_mask = 0x7FF };
+    capture.arm(trigger, 5, 2);
+
+    constexpr std::size_t trigger_frame = 50;
+    std::size_t frame_count = 0;
+    while (capture.recording()) {
+      auto const id = frame_count == trigger_frame ? 0x700 : 0x100;
+      capture.record(frame(id, static_cast<hal::byte>(frame_count)),
+                     receive_time(frame_count));
+      frame_count++;
+    }
+    expect(capture.state() == capture_state::done);
+    expect(frame_count == trigger_frame + 3);
+
+    auto const records = decode(capture);
+    expect(records.size() == capture.records());
+    expect(capture.trigger_index() < records.size());
+
+    // The newest frames are kept, each with the exact time it was received
+    auto const first = frame_count - records.size();
+    for (std::size_t i = 0; i < records.size(); i++) {
+      auto const index = first + i;
+      expect(records[i].first_byte == static_cast<hal::byte>(index));
+      expect(records[i].time == receive_time(index));
+    }
+    expect(first + capture.trigger_index() == trigger_frame);
+    expect(records[capture.trigger_index()].id == 0x700);
+  };
+
+  "a finished capture is read while the interrupt keeps recording"_test =
+    []() {
+      for (std::size_t round = 0; round < 20; round++) {
+        capture_buffer<256> capture;
+        capture_trigger const trigger{ .key = 0x700, .key_mask = 0x7FF };
+        capture.arm(trigger, 10, 10);
+
+        std::atomic<bool> done = false;
+        std::thread interrupt([&]() {
+          // Keeps recording after the capture is done, which must not touch
+          // it any more
+          for (std::size_t i = 0; not done.load(); i++) {
+            auto const id = (i % 97) == 96 ? 0x700 : 0x100;
+            capture.record(frame(id, static_cast<hal::byte>(i)), i * 13);
+          }
+        });
+
+        while (capture.state() != capture_state::done) {
+          std::this_thread::yield();
+        }
+        auto const records = capture.records();
+        auto const first = decode(capture);
+        for (int i = 0; i < 100; i++) {
+          std::this_thread::yield();
+        }
+        auto const second = decode(capture);
+        done = true;
+        interrupt.join();
+
+        expect(first.size() == records and records == 21);
+        expect(second.size() == first.size());
+        for (std::size_t i = 0; i < first.size() and i < second.size(); i++) {
+          expect(first[i].time == second[i].time and
+                 first[i].first_byte == second[i].first_byte);
+        }
+        for (std::size_t i = 1; i < first.size(); i++) {
+          expect(first[i].first_byte ==
+                 static_cast<hal::byte>(first[i - 1].first_byte + 1));
+          expect(first[i].time == first[i - 1].time + 13);
+        }
+        expect(first[capture.trigger_index()].id == 0x700);
+      }
+    };
+}
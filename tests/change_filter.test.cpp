@@ -0,0 +1,120 @@
+// Copyright 2024 Khalil Estell
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <cstddef>
+
+#include <app/change_filter.hpp>
+
+#include <boost/ut.hpp>
+
+namespace {
+hal::can_message frame(hal::u32 p_id,
+                       hal::byte p_first_byte,
+                       bool p_extended = false)
+{
+  hal::can_message message{};
+  message.id(p_id).length = 2;
+  message.extended(p_extended);
+  message.payload[0] = p_first_byte;
+  return message;
+}
+}  // namespace
+
+void change_filter_test()
+{
+  using namespace boost::ut;
+
+  "repeated frames are suppressed"_test = []() {
+    change_filter filter;
+    filter.reset(0);
+    expect(filter.should_forward(frame(0x123, 1), 0));
+    expect(not filter.should_forward(frame(0x123, 1), 1));
+    expect(not filter.should_forward(frame(0x123, 1), 2));
+    expect(filter.suppressed() == 2);
+    expect(filter.untracked() == 0);
+  };
+
+  "changed payloads and lengths are forwarded"_test = []() {
+    change_filter filter;
+    filter.reset(0);
+    expect(filter.should_forward(frame(0x123, 1), 0));
+    expect(filter.should_forward(frame(0x123, 2), 1));
+    expect(not filter.should_forward(frame(0x123, 2), 2));
+
+    auto longer = frame(0x123, 2);
+    longer.length = 3;
+    expect(filter.should_forward(longer, 3));
+    expect(not filter.should_forward(longer, 4));
+    expect(filter.suppressed() == 2);
+  };
+
+  "unchanged frames are forwarded again after the keep alive"_test = []() {
+    change_filter filter;
+    filter.reset(100);
+    expect(filter.should_forward(frame(0x123, 1), 0xFFFF'FFF0));
+    expect(not filter.should_forward(frame(0x123, 1), 0xFFFF'FFFF));
+    // The time wrapped around in between
+    expect(filter.should_forward(frame(0x123, 1), 0x54));
+    expect(not filter.should_forward(frame(0x123, 1), 0x55));
+  };
+
+  "standard and extended frames with the same ID are kept apart"_test =
+    []() {
+      change_filter filter;
+      filter.reset(0);
+      expect(filter.should_forward(frame(0x123, 1), 0));
+      expect(filter.should_forward(frame(0x123, 1, true), 1));
+      expect(not filter.should_forward(frame(0x123, 1), 2));
+      expect(not filter.should_forward(frame(0x123, 1, true), 3));
+      expect(filter.should_forward(frame(0x123, 2, true), 4));
+      expect(not filter.should_forward(frame(0x123, 1), 5));
+    };
+
+  "remote requests are always forwarded"_test = []() {
+    change_filter filter;
+    filter.reset(0);
+    auto request = frame(0x123, 0);
+    request.remote_request(true);
+    expect(filter.should_forward(request, 0));
+    expect(filter.should_forward(request, 1));
+    expect(filter.suppressed() == 0);
+  };
+
+  "IDs that do not fit into a full table are counted and forwarded"_test =
+    []() {
+      change_filter filter;
+      filter.reset(0);
+
+      hal::u32 id = 0;
+      while (filter.untracked() == 0) {
+        expect(filter.should_forward(frame(id, 1, true), 0));
+        id++;
+      }
+      expect(id <= change_filter::capacity + 1);
+      auto const untracked_id = id - 1;
+
+      // The ID that did not fit is never suppressed, the others still are
+      for (hal::u32 i = 0; i < 3; i++) {
+        expect(filter.should_forward(frame(untracked_id, 1, true), 1));
+      }
+      expect(filter.untracked() == 4);
+      expect(not filter.should_forward(frame(0, 1, true), 2));
+      expect(filter.suppressed() == 1);
+
+      filter.reset(0);
+      expect(filter.untracked() == 0);
+      expect(filter.should_forward(frame(untracked_id, 1, true), 3));
+      expect(not filter.should_forward(frame(untracked_id, 1, true), 4));
+    };
+}
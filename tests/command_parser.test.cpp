@@ -0,0 +1,131 @@
+// Copyright 2024 Khalil Estell
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <array>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <app/command_parser.hpp>
+
+#include <boost/ut.hpp>
+
+namespace {
+std::span<hal::byte const> bytes(std::string_view p_text)
+{
+  return { reinterpret_cast<hal::byte const*>(p_text.data()), p_text.size() };
+}
+
+std::string text(std::span<hal::byte const> p_command)
+{
+  return { reinterpret_cast<char const*>(p_command.data()), p_command.size() };
+}
+
+/// Feed a read and collect every command it completes
+std::vector<std::string> feed(command_parser& p_parser, std::string_view p_read)
+{
+  std::vector<std::string> commands;
+  p_parser.feed(bytes(p_read));
+  while (auto const command = p_parser.next()) {
+    commands.push_back(text(*command));
+  }
+  return commands;
+}
+}  // namespace
+
+void command_parser_test()
+{
+  using namespace boost::ut;
+
+  "a whole command is returned without being copied"_test = []() {
+    std::array<hal::byte, 16> buffer{};
+    command_parser parser(buffer);
+    std::string_view const read = "t1230\r";
+
+    parser.feed(bytes(read));
+    auto const command = parser.next();
+    expect(command.has_value());
+    expect(command->data() == bytes(read).data());
+    expect(text(*command) == "t1230\r");
+    expect(not parser.next());
+    expect(not parser.pending());
+  };
+
+  "every command in one read is returned in order"_test = []() {
+    std::array<hal::byte, 16> buffer{};
+    command_parser parser(buffer);
+
+    auto const commands = feed(parser, "S6\rO\rt1230\rt4561AA\r\rC\r");
+    expect(commands == std::vector<std::string>{
+                         "S6\r", "O\r", "t1230\r", "t4561AA\r", "\r", "C\r" });
+  };
+
+  "a command split across reads is put back together"_test = []() {
+    std::array<hal::byte, 16> buffer{};
+    command_parser parser(buffer);
+
+    expect(feed(parser, "t12").empty());
+    expect(feed(parser, "").empty());
+    expect(feed(parser, "31A").empty());
+    expect(feed(parser, "A\rO") == std::vector<std::string>{ "t1231AA\r" });
+    expect(feed(parser, "\rC\r") == std::vector<std::string>{ "O\r", "C\r" });
+  };
+
+  "a split terminator completes the command"_test = []() {
+    std::array<hal::byte, 16> buffer{};
+    command_parser parser(buffer);
+
+    expect(feed(parser, "V").empty());
+    expect(feed(parser, "\r") == std::vector<std::string>{ "V\r" });
+  };
+
+  "the longest command fits exactly"_test = []() {
+    std::array<hal::byte, 8> buffer{};
+    command_parser parser(buffer);
+
+    expect(feed(parser, "t12310A\r") ==
+           std::vector<std::string>{ "t12310A\r" });
+    expect(feed(parser, "t1231").empty());
+    expect(feed(parser, "0A\r") == std::vector<std::string>{ "t12310A\r" });
+  };
+
+  "an overlong command is rejected whole"_test = []() {
+    std::array<hal::byte, 8> buffer{};
+    command_parser parser(buffer);
+
+    // Arriving in one read
+    expect(feed(parser, "t1232AABB\rO\r") ==
+           std::vector<std::string>{ "", "O\r" });
+
+    // Arriving over several reads, rejected once its terminator arrives
+    expect(feed(parser, "t1234").empty());
+    expect(feed(parser, "AABB").empty());
+    expect(feed(parser, "CCDD").empty());
+    expect(feed(parser, "\rC\r") == std::vector<std::string>{ "", "C\r" });
+
+    // Overflowing only when completed by a later read
+    expect(feed(parser, "t12310").empty());
+    expect(feed(parser, "AB\rV\r") == std::vector<std::string>{ "", "V\r" });
+  };
+
+  "the parser recovers after an overlong command"_test = []() {
+    std::array<hal::byte, 8> buffer{};
+    command_parser parser(buffer);
+
+    expect(feed(parser, std::string(40, 'x')).empty());
+    expect(feed(parser, "x\rt12") == std::vector<std::string>{ "" });
+    expect(feed(parser, "30\r") == std::vector<std::string>{ "t1230\r" });
+  };
+}
@@ -0,0 +1,369 @@
+// Copyright 2024 Khalil Estell
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <optional>
+#include <random>
+#include <vector>
+
+#include <libhal/can.hpp>
+
+#include <app/filter_allocator.hpp>
+
+#include <boost/ut.hpp>
+
+namespace {
+/// Records what a hardware filter bank was last programmed with
+template<class Interface, class Value>
+class mock_filter : public Interface
+{
+public:
+  std::optional<Value> allowed{};
+  int calls = 0;
+
+private:
+  void driver_allow(std::optional<Value> p_value) override
+  {
+    allowed = p_value;
+    calls++;
+  }
+};
+
+using mock_identifier_filter =
+  mock_filter<hal::can_identifier_filter, hal::u16>;
+using mock_extended_identifier_filter =
+  mock_filter<hal::can_extended_identifier_filter, hal::u32>;
+using mock_mask_filter =
+  mock_filter<hal::can_mask_filter, hal::can_mask_filter::pair>;
+using mock_extended_mask_filter =
+  mock_filter<hal::can_extended_mask_filter,
+              hal::can_extended_mask_filter::pair>;
+
+/**
+ * @brief A controller with some number of each kind of filter bank
+ *
+ * Accepts a frame the way a controller would once the banks are programmed:
+ * if any enabled bank of the frame's type matches it. An extended mask bank
+ * with a zero mask accepts standard frames too, like the Lawicel acceptance
+ * registers it holds. A controller without any banks accepts every frame.
+ */
+struct mock_controller
+{
+  mock_controller(std::size_t p_identifier,
+                  std::size_t p_extended_identifier,
+                  std::size_t p_mask,
+                  std::size_t p_extended_mask)
+    : identifier(p_identifier)
+    , extended_identifier(p_extended_identifier)
+    , mask(p_mask)
+    , extended_mask(p_extended_mask)
+  {
+    for (auto& filter : identifier) {
+      identifier_pointers.push_back(&filter);
+    }
+    for (auto& filter : extended_identifier) {
+      extended_identifier_pointers.push_back(&filter);
+    }
+    for (auto& filter : mask) {
+      mask_pointers.push_back(&filter);
+    }
+    for (auto& filter : extended_mask) {
+      extended_mask_pointers.push_back(&filter);
+    }
+  }
+
+  filter_banks banks() const
+  {
+    return {
+      .identifier = identifier_pointers,
+      .extended_identifier = extended_identifier_pointers,
+      .mask = mask_pointers,
+      .extended_mask = extended_mask_pointers,
+    };
+  }
+
+  bool accepts(hal::can_message const& p_message) const
+  {
+    if (identifier.empty() and extended_identifier.empty() and mask.empty() and
+        extended_mask.empty()) {
+      return true;
+    }
+
+    auto const id = p_message.id();
+    for (auto const& filter : extended_mask) {
+      if (filter.allowed and filter.allowed->mask == 0) {
+        return true;
+      }
+    }
+
+    if (not p_message.extended()) {
+      for (auto const& filter : identifier) {
+        if (filter.allowed and *filter.allowed == id) {
+          return true;
+        }
+      }
+      for (auto const& filter : mask) {
+        auto const& pair = filter.allowed;
+        if (pair and (id & pair->mask) == (pair->id & pair->mask)) {
+          return true;
+        }
+      }
+      return false;
+    }
+
+    for (auto const& filter : extended_identifier) {
+      if (filter.allowed and *filter.allowed == id) {
+        return true;
+      }
+    }
+    for (auto const& filter : extended_mask) {
+      auto const& pair = filter.allowed;
+      if (pair and (id & pair->mask) == (pair->id & pair->mask)) {
+        return true;
+      }
+    }
+    return false;
+  }
+
+  /// Every bank must have been programmed, enabled or disabled
+  bool all_programmed() const
+  {
+    auto const programmed = [](auto const& p_filters) {
+      for (auto const& filter : p_filters) {
+        if (filter.calls == 0) {
+          return false;
+        }
+      }
+      return true;
+    };
+    return programmed(identifier) and programmed(extended_identifier) and
+           programmed(mask) and programmed(extended_mask);
+  }
+
+  std::vector<mock_identifier_filter> identifier;
+  std::vector<mock_extended_identifier_filter> extended_identifier;
+  std::vector<mock_mask_filter> mask;
+  std::vector<mock_extended_mask_filter> extended_mask;
+  std::vector<hal::can_identifier_filter*> identifier_pointers;
+  std::vector<hal::can_extended_identifier_filter*>
+    extended_identifier_pointers;
+  std::vector<hal::can_mask_filter*> mask_pointers;
+  std::vector<hal::can_extended_mask_filter*> extended_mask_pointers;
+};
+
+bool matches(filter_rule const& p_rule, hal::can_message const& p_message)
+{
+  return p_rule.extended == p_message.extended() and
+         (p_message.id() & p_rule.mask) == (p_rule.id & p_rule.mask);
+}
+
+hal::can_message frame(bool p_extended, hal::u32 p_id)
+{
+  hal::can_message message{};
+  message.extended(p_extended).id(p_id);
+  return message;
+}
+
+filter_rule random_rule(std::mt19937& p_random)
+{
+  bool const extended = p_random() & 1;
+  hal::u32 const full_mask = extended ? 0x1FFF'FFFF : 0x7FF;
+  // IDs from a small range, so rules overlap and frames hit several of them
+  hal::u32 const base = extended ? 0x1234'5600 : 0x500;
+  filter_rule rule{
+    .id = base | static_cast<hal::u32>(p_random() & 0x3F),
+    .extended = extended,
+  };
+  switch (p_random() % 3) {
+    case 0: {
+      rule.mask = full_mask;
+      break;
+    }
+    case 1: {
+      rule.mask = full_mask & ~(p_random() & 0xF);
+      break;
+    }
+    case 2: {
+      rule.mask = p_random() & full_mask;
+      break;
+    }
+  }
+  return rule;
+}
+}  // namespace
+
+void filter_allocator_test()
+{
+  using namespace boost::ut;
+
+  "rules that fit are enforced by hardware alone"_test = []() {
+    mock_controller controller(2, 1, 1, 1);
+    std::vector<filter_rule> const rules{
+      { .id = 0x100, .mask = 0x7FF },
+      { .id = 0x200, .mask = 0x7FF },
+      { .id = 0x300, .mask = 0x7F0 },
+      { .id = 0x1234'5678, .mask = 0x1FFF'FFFF, .extended = true },
+    };
+    software_filter software;
+
+    auto const allocation =
+      allocate_filters(rules, controller.banks(), software);
+    expect(allocation.has_value());
+    expect(allocation->hardware_rules == 4 and allocation->software_rules == 0);
+    expect(not software.enabled());
+    expect(controller.all_programmed());
+    // The spare extended mask bank is disabled rather than left open
+    expect(not controller.extended_mask[0].allowed);
+
+    for (hal::u32 id = 0; id <= 0x7FF; id++) {
+      bool const allowed = id == 0x100 or id == 0x200 or (id & 0x7F0) == 0x300;
+      expect(controller.accepts(frame(false, id)) == allowed) << id;
+    }
+    expect(controller.accepts(frame(true, 0x1234'5678)));
+    expect(not controller.accepts(frame(true, 0x1234'5679)));
+  };
+
+  "spilled rules get the narrowest covering pair"_test = []() {
+    mock_controller controller(0, 0, 1, 0);
+    std::vector<filter_rule> const rules{
+      { .id = 0x100, .mask = 0x7FF },
+      { .id = 0x101, .mask = 0x7FF },
+    };
+    software_filter software;
+
+    auto const allocation =
+      allocate_filters(rules, controller.banks(), software);
+    expect(allocation.has_value());
+    expect(allocation->software_rules == 2);
+    auto const& cover = controller.mask[0].allowed;
+    expect(cover and cover->id == 0x100 and cover->mask == 0x7FE);
+    expect(software.enabled());
+  };
+
+  "spilled standard rules open the Lawicel acceptance bank"_test = []() {
+    // No standard mask bank to cover them, as on MicroMod
+    mock_controller controller(1, 0, 0, 1);
+    std::vector<filter_rule> const rules{
+      { .id = 0x100, .mask = 0x7FF },
+      { .id = 0x200, .mask = 0x7FF },
+    };
+    software_filter software;
+
+    auto const allocation =
+      allocate_filters(rules, controller.banks(), software);
+    expect(allocation.has_value());
+    expect(allocation->hardware_rules == 1 and allocation->software_rules == 1);
+    expect(controller.identifier[0].allowed == hal::u16{ 0x100 });
+    auto const& open = controller.extended_mask[0].allowed;
+    expect(open and open->id == 0 and open->mask == 0);
+
+    for (hal::u32 id = 0; id <= 0x7FF; id++) {
+      auto const message = frame(false, id);
+      bool const allowed = id == 0x100 or id == 0x200;
+      bool const accepted =
+        controller.accepts(message) and software.accepts(message);
+      expect(accepted == allowed) << id;
+    }
+  };
+
+  "rules that spill where no bank can open are refused"_test = []() {
+    mock_controller controller(1, 1, 0, 0);
+    std::vector<filter_rule> const rules{
+      { .id = 0x100, .mask = 0x7FF },
+      { .id = 0x200, .mask = 0x7FF },
+    };
+    software_filter software;
+    expect(not allocate_filters(rules, controller.banks(), software));
+  };
+
+  "without hardware banks the software filter does everything"_test = []() {
+    mock_controller controller(0, 0, 0, 0);
+    std::vector<filter_rule> const rules{
+      { .id = 0x100, .mask = 0x7FF },
+      { .id = 0x1234'5678, .mask = 0x1FFF'FF00, .extended = true },
+    };
+    software_filter software;
+
+    auto const allocation =
+      allocate_filters(rules, controller.banks(), software);
+    expect(allocation.has_value());
+    expect(allocation->software_rules == 2);
+    expect(software.accepts(frame(false, 0x100)));
+    expect(software.accepts(frame(true, 0x1234'56AB)));
+    expect(not software.accepts(frame(false, 0x101)));
+    expect(not software.accepts(frame(true, 0x1234'5778)));
+  };
+
+  "hardware and software together accept exactly the rules"_test = []() {
+    std::mt19937 random(7);
+    std::size_t wrong = 0;
+    std::size_t refused = 0;
+    std::size_t spilled = 0;
+    for (int round = 0; round < 2000; round++) {
+      mock_controller controller(
+        random() % 3, random() % 3, random() % 3, random() % 3);
+      std::vector<filter_rule> rules(1 + random() % 10);
+      for (auto& rule : rules) {
+        rule = random_rule(random);
+      }
+      software_filter software;
+
+      auto const allocation =
+        allocate_filters(rules, controller.banks(), software);
+      if (not allocation) {
+        refused++;
+        continue;
+      }
+      if (allocation->software_rules != 0) {
+        spilled++;
+      }
+      if (allocation->hardware_rules + allocation->software_rules !=
+            rules.size() or
+          (allocation->software_rules == 0 and software.enabled()) or
+          not controller.all_programmed()) {
+        wrong++;
+      }
+
+      std::vector<hal::can_message> messages;
+      for (auto const& rule : rules) {
+        // Frames matching the rule, and ones that miss it by a bit
+        messages.push_back(frame(rule.extended, rule.id));
+        messages.push_back(
+          frame(rule.extended, rule.id ^ (~rule.mask & random() & 0x7FF)));
+        messages.push_back(
+          frame(rule.extended, rule.id ^ (1U << (random() % 11))));
+      }
+      for (int i = 0; i < 32; i++) {
+        bool const extended = random() & 1;
+        hal::u32 const base = extended ? 0x1234'5600 : 0x500;
+        messages.push_back(frame(extended, base | (random() & 0x7F)));
+      }
+
+      for (auto const& message : messages) {
+        bool allowed = false;
+        for (auto const& rule : rules) {
+          allowed = allowed or matches(rule, message);
+        }
+        bool const accepted =
+          controller.accepts(message) and software.accepts(message);
+        if (accepted != allowed) {
+          wrong++;
+        }
+      }
+    }
+    expect(wrong == 0) << wrong << " frames or allocations wrong";
+    // Make sure the banks run out often, but not so often nothing is tested
+    expect(spilled > 200) << spilled;
+    expect(refused < 1000) << refused;
+  };
+}
@@ -0,0 +1,40 @@
+// Copyright 2024 Khalil Estell
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+void slcan_test();
+void command_parser_test();
+void receive_reader_test();
+void binary_frame_test();
+void software_filter_test();
+void filter_allocator_test();
+void periodic_scheduler_test();
+void transmit_queue_test();
+void bus_monitor_test();
+void change_filter_test();
+void capture_buffer_test();
+
+int main()
+{
+  slcan_test();
+  command_parser_test();
+  receive_reader_test();
+  binary_frame_test();
+  software_filter_test();
+  filter_allocator_test();
+  periodic_scheduler_test();
+  transmit_queue_test();
+  bus_monitor_test();
+  change_filter_test();
+  capture_buffer_test();
+}
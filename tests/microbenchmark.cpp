@@ -0,0 +1,145 @@
+// Copyright 2024 Khalil Estell
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Times the per frame hot paths of the application on the build machine and
+// prints nanoseconds per frame. Numbers are only comparable between runs on
+// the same machine.
+
+#include <array>
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <span>
+#include <string>
+#include <vector>
+
+#include <libhal/can.hpp>
+
+#include <app/binary_frame.hpp>
+#include <app/slcan.hpp>
+#include <app/software_filter.hpp>
+
+#include "reference_slcan.hpp"
+
+namespace {
+constexpr std::size_t frame_count = 4096;
+constexpr int rounds = 250;
+
+/**
+ * @brief Run an operation over every frame for a number of rounds
+ *
+ * @param p_name - label to print
+ * @param p_frames - frames to run the operation on
+ * @param p_operation - returns a value that depends on its work, so the
+ * compiler cannot drop it
+ */
+template<class Frame, class Operation>
+void measure(char const* p_name,
+             std::vector<Frame> const& p_frames,
+             Operation p_operation)
+{
+  std::size_t checksum = 0;
+  auto const start = std::chrono::steady_clock::now();
+  for (int round = 0; round < rounds; round++) {
+    for (auto const& frame : p_frames) {
+      checksum += p_operation(frame);
+    }
+  }
+  auto const elapsed = std::chrono::steady_clock::now() - start;
+  auto const nanoseconds =
+    std::chrono::duration<double, std::nano>(elapsed).count();
+  std::printf("%-40s %8.1f ns/frame  (checksum %zu)\n",
+              p_name,
+              nanoseconds / (rounds * p_frames.size()),
+              checksum);
+}
+
+std::vector<hal::can_message> random_messages()
+{
+  std::mt19937 random(1);
+  std::vector<hal::can_message> messages(frame_count);
+  for (auto& message : messages) {
+    bool const extended = random() & 1;
+    message.extended(extended);
+    message.id(random() & (extended ? 0x1FFF'FFFF : 0x7FF));
+    message.length = 8;
+    for (auto& byte : message.payload) {
+      byte = static_cast<hal::byte>(random());
+    }
+  }
+  return messages;
+}
+
+std::span<hal::byte const> bytes(std::string const& p_text)
+{
+  return { reinterpret_cast<hal::byte const*>(p_text.data()), p_text.size() };
+}
+}  // namespace
+
+int main()
+{
+  auto const messages = random_messages();
+
+  measure("encode: snprintf per field (before)",
+          messages,
+          [](hal::can_message const& p_message) {
+            return reference_encode(p_message).size();
+          });
+  measure("encode: encode_can_message",
+          messages,
+          [](hal::can_message const& p_message) {
+            std::array<hal::byte, max_encoded_message_size> buffer{};
+            return encode_can_message(buffer, p_message);
+          });
+  measure("encode: encode_binary_frame",
+          messages,
+          [](hal::can_message const& p_message) {
+            std::array<hal::byte, max_binary_frame_size> buffer{};
+            return encode_binary_frame(buffer, { .message = p_message });
+          });
+
+  std::vector<std::string> commands;
+  for (auto const& message : messages) {
+    commands.push_back(reference_encode(message));
+  }
+  measure("decode: from_chars per field (before)",
+          commands,
+          [](std::string const& p_command) {
+            return reference_decode(bytes(p_command))->payload[0];
+          });
+  measure("decode: decode_can_message",
+          commands,
+          [](std::string const& p_command) {
+            return decode_can_message(bytes(p_command))->payload[0];
+          });
+
+  // The receive interrupt filters every frame, so the worst case is a full
+  // filter and extended frames that miss both the set and every mask pair
+  software_filter filter;
+  std::mt19937 random(2);
+  for (std::size_t i = 0; i < software_filter::extended_capacity * 2; i++) {
+    filter.allow_extended(random() & 0x1FFF'FFFF);
+  }
+  for (std::size_t i = 0; i < software_filter::extended_mask_capacity; i++) {
+    filter.allow_extended_mask(random() & 0x1FFF'FFFF, 0x1FFF'FFFF);
+  }
+  for (hal::u32 id = 0; id < 0x800; id += 3) {
+    filter.allow_standard(id);
+  }
+  measure("filter: software_filter::accepts, full",
+          messages,
+          [&filter](hal::can_message const& p_message) {
+            return filter.accepts(p_message);
+          });
+}
@@ -0,0 +1,111 @@
+// Copyright 2024 Khalil Estell
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <random>
+#include <vector>
+
+#include <app/periodic_scheduler.hpp>
+
+#include <boost/ut.hpp>
+
+namespace {
+hal::can_message message_with_id(hal::u32 p_id)
+{
+  hal::can_message message{};
+  message.id(p_id);
+  return message;
+}
+}  // namespace
+
+void periodic_scheduler_test()
+{
+  using namespace boost::ut;
+
+  "a message is sent at its offset and then every period"_test = []() {
+    periodic_scheduler schedule;
+    expect(schedule.empty() and not schedule.next_due());
+    expect(schedule.set(3, message_with_id(0x123), 100, 50, 1000));
+    expect(schedule.next_due() == hal::u64{ 1050 });
+
+    expect(not schedule.poll(1049));
+    auto const first = schedule.poll(1050);
+    expect(first and first->id() == 0x123);
+    expect(not schedule.poll(1050));
+    expect(not schedule.poll(1149));
+    expect(schedule.poll(1150).has_value());
+    // Late by most of a period, the next one stays in phase
+    expect(schedule.poll(1249 + 90).has_value());
+    expect(schedule.next_due() == hal::u64{ 1350 });
+  };
+
+  "missed periods are skipped rather than sent in a burst"_test = []() {
+    periodic_scheduler schedule;
+    expect(schedule.set(0, message_with_id(1), 10, 0, 0));
+    expect(schedule.poll(0).has_value());
+    expect(schedule.poll(95).has_value());
+    expect(not schedule.poll(95));
+    expect(schedule.next_due() == hal::u64{ 100 });
+  };
+
+  "the earliest due message comes first"_test = []() {
+    // Every slot with its own period and offset, polled on a simulated clock
+    // against the times each one should be sent at
+    std::mt19937 random(8);
+    periodic_scheduler schedule;
+    std::vector<hal::u64> due(periodic_scheduler::slot_count);
+    std::vector<hal::u64> period(periodic_scheduler::slot_count);
+    for (std::size_t slot = 0; slot < due.size(); slot++) {
+      period[slot] = 1 + random() % 1000;
+      due[slot] = random() % 1000;
+      expect(schedule.set(
+        slot, message_with_id(slot), period[slot], due[slot], 0));
+    }
+    // Replacing a slot moves it in the heap
+    period[7] = 3;
+    due[7] = 2;
+    expect(schedule.set(7, message_with_id(7), 3, 2, 0));
+    expect(schedule.remove(9));
+    expect(not schedule.remove(9));
+
+    std::size_t wrong = 0;
+    std::size_t sent = 0;
+    for (hal::u64 now = 0; now < 20'000; now++) {
+      while (auto const message = schedule.poll(now)) {
+        auto const slot = message->id();
+        if (slot == 9 or due[slot] != now) {
+          wrong++;
+        }
+        due[slot] += period[slot];
+        sent++;
+      }
+    }
+    expect(wrong == 0) << wrong << " messages sent at the wrong time";
+    expect(sent > 5'000) << sent;
+  };
+
+  "slots and periods out of range are refused"_test = []() {
+    periodic_scheduler schedule;
+    expect(not schedule.set(periodic_scheduler::slot_count,
+                            message_with_id(1), 10, 0, 0));
+    expect(not schedule.set(0, message_with_id(1), 0, 0, 0));
+    expect(not schedule.remove(periodic_scheduler::slot_count));
+    expect(schedule.empty());
+
+    expect(schedule.set(0, message_with_id(1), 10, 0, 0));
+    expect(schedule.set(1, message_with_id(2), 10, 0, 0));
+    schedule.clear();
+    expect(schedule.empty() and not schedule.poll(100));
+    expect(not schedule.remove(0));
+  };
+}
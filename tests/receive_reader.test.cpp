@@ -0,0 +1,240 @@
+// Copyright 2024 Khalil Estell
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <thread>
+#include <vector>
+
+#include <app/receive_reader.hpp>
+
+#include <boost/ut.hpp>
+
+namespace {
+constexpr std::size_t buffer_depth = 16;
+
+// Frames rejected by the acceptance filter in these tests
+bool accepted(std::size_t p_index)
+{
+  return p_index % 5 != 0;
+}
+
+// Every payload byte carries part of the frame's index, so a frame copied
+// while the transceiver was rewriting its slot mixes two indexes
+hal::can_message indexed_message(std::size_t p_index)
+{
+  hal::can_message message{};
+  message.id(p_index & 0x7FF).length = 8;
+  for (std::size_t i = 0; i < message.payload.size(); i++) {
+    message.payload[i] = static_cast<hal::byte>(p_index >> (i * 8));
+  }
+  return message;
+}
+
+bool intact(received_message const& p_frame)
+{
+  return p_frame.uptime == p_frame.index and
+         p_frame.message.id() == (p_frame.index & 0x7FF) and
+         p_frame.message.payload == indexed_message(p_frame.index).payload;
+}
+
+/// Stands in for the transceiver and its receive interrupt
+struct fake_transceiver
+{
+  void receive(std::size_t p_index)
+  {
+    buffer[cursor] = indexed_message(p_index);
+    cursor = (cursor + 1) % size;
+    reader.received(accepted(p_index), p_index);
+  }
+
+  bool attach()
+  {
+    return reader.attach(std::span(buffer).first(size), cursor);
+  }
+
+  std::array<hal::can_message, buffer_depth> buffer{};
+  // Slots of the buffer in use, transceivers are not limited to powers of two
+  std::size_t size = buffer_depth;
+  std::size_t cursor = 5;
+  receive_reader<buffer_depth> reader{};
+};
+}  // namespace
+
+void receive_reader_test()
+{
+  using namespace boost::ut;
+
+  "attach rejects buffers it cannot read"_test = []() {
+    std::array<hal::can_message, buffer_depth + 1> buffer{};
+    receive_reader<buffer_depth> reader{};
+    expect(not reader.attach(buffer, 0));
+    expect(not reader.attach(std::span(buffer).first(1), 0));
+    expect(reader.attach(std::span(buffer).first(2), 0));
+  };
+
+  "accepted frames are read in order from the cursor"_test = []() {
+    fake_transceiver transceiver;
+    auto& reader = transceiver.reader;
+    expect(transceiver.attach());
+    expect(not reader.pop());
+
+    for (std::size_t i = 0; i < 40; i++) {
+      transceiver.receive(i);
+      if (i % 3 != 2) {
+        continue;
+      }
+      while (auto const frame = reader.pop()) {
+        expect(intact(*frame) and accepted(frame->index));
+      }
+      expect(reader.empty());
+    }
+    expect(reader.overflow_count() == 0);
+  };
+
+  "frames the transceiver laps are counted as overflows"_test = []() {
+    fake_transceiver transceiver;
+    auto& reader = transceiver.reader;
+    expect(transceiver.attach());
+
+    constexpr std::size_t written = (buffer_depth * 2) + 3;
+    for (std::size_t i = 0; i < written; i++) {
+      transceiver.receive(i);
+    }
+    expect(reader.full());
+
+    // The oldest slot may be mid rewrite, so only the newest buffer_depth - 1
+    // frames are read
+    std::size_t const first = written - buffer_depth + 1;
+    std::size_t expected = first;
+    while (auto const frame = reader.pop()) {
+      while (not accepted(expected)) {
+        expected++;
+      }
+      expect(frame->index == expected and intact(*frame));
+      expected++;
+    }
+    expect(expected == written);
+    expect(reader.overflow_count() == first);
+  };
+
+  "a buffer of any size is read in order across many laps"_test = []() {
+    fake_transceiver transceiver;
+    transceiver.size = buffer_depth - 3;
+    auto& reader = transceiver.reader;
+    expect(transceiver.attach());
+
+    // Read in bursts that sometimes let the transceiver lap the reader
+    std::size_t written = 0;
+    std::size_t expected = 0;
+    std::size_t overwritten = 0;
+    for (std::size_t burst = 0; burst < 200; burst++) {
+      auto const count = (burst * 7) % (transceiver.size * 2);
+      for (std::size_t i = 0; i < count; i++) {
+        transceiver.receive(written++);
+      }
+      if (written - expected >= transceiver.size) {
+        overwritten += written - transceiver.size + 1 - expected;
+        expected = written - transceiver.size + 1;
+      }
+      while (auto const frame = reader.pop()) {
+        while (not accepted(expected)) {
+          expected++;
+        }
+        expect(frame->index == expected and intact(*frame));
+        expected++;
+      }
+      expect(reader.empty());
+      // Rejected frames after the last accepted one have been read too
+      expected = written;
+    }
+    expect(overwritten > 0 and reader.overflow_count() == overwritten);
+  };
+
+  "a transceiver thread and a reader thread never tear a frame"_test = []() {
+    constexpr std::size_t frame_count = 200'000;
+
+    for (bool const throttled : { true, false }) {
+      fake_transceiver transceiver;
+      auto& reader = transceiver.reader;
+      expect(transceiver.attach());
+
+      std::atomic<bool> done = false;
+      // Index after the last frame the reader returned
+      std::atomic<std::size_t> consumed = 0;
+
+      std::thread interrupt([&]() {
+        for (std::size_t i = 0; i < frame_count; i++) {
+          // Throttled, the transceiver stays well within a buffer of the
+          // reader so nothing may be lost
+          while (throttled and
+                 i - consumed.load(std::memory_order_acquire) >
+                   buffer_depth / 2) {
+            std::this_thread::yield();
+          }
+          transceiver.receive(i);
+        }
+        done.store(true, std::memory_order_release);
+      });
+
+      std::vector<bool> seen(frame_count, false);
+      std::size_t torn = 0;
+      std::size_t out_of_order = 0;
+      std::size_t read = 0;
+      std::size_t next_index = 0;
+      while (true) {
+        bool const finished = done.load(std::memory_order_acquire);
+        bool idle = true;
+        while (auto const frame = reader.pop()) {
+          idle = false;
+          if (not intact(*frame) or not accepted(frame->index)) {
+            torn++;
+          }
+          if (frame->index < next_index) {
+            out_of_order++;
+          }
+          next_index = frame->index + 1;
+          seen[frame->index] = true;
+          read++;
+          consumed.store(next_index, std::memory_order_release);
+        }
+        if (finished) {
+          break;
+        }
+        if (idle) {
+          std::this_thread::yield();
+        }
+      }
+      interrupt.join();
+
+      std::size_t missing = 0;
+      for (std::size_t i = 0; i < frame_count; i++) {
+        if (accepted(i) and not seen[i]) {
+          missing++;
+        }
+      }
+
+      expect(torn == 0) << torn << " frames torn";
+      expect(out_of_order == 0) << out_of_order << " frames out of order";
+      expect(missing <= reader.overflow_count())
+        << missing << " frames lost without an overflow";
+      expect(read + reader.overflow_count() <= frame_count);
+      if (throttled) {
+        expect(missing == 0 and reader.overflow_count() == 0);
+      }
+      expect(read > 0);
+    }
+  };
+}
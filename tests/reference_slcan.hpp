@@ -0,0 +1,148 @@
+// Copyright 2024 Khalil Estell
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// The slcan formatter and parser the table driven encoder and decoder in
+// app/slcan.hpp replaced, kept as the reference the tests and the
+// microbenchmark compare against.
+
+#pragma once
+
+#include <array>
+#include <charconv>
+#include <cstdio>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+
+#include <libhal/can.hpp>
+#include <libhal/units.hpp>
+
+/**
+ * @brief Encode a CAN message the way print_encoded_can_message() did
+ *
+ * Every field goes through its own snprintf call, as hal::print made them.
+ *
+ * @param p_message - message to encode, with a length of at most 8
+ * @return std::string - the encoded frame including its '\r'
+ */
+inline std::string reference_encode(hal::can_message const& p_message)
+{
+  std::string output;
+  auto const print = [&output](char const* p_format, auto p_value) {
+    std::array<char, 16> buffer{};
+    auto const length =
+      std::snprintf(buffer.data(), buffer.size(), p_format, p_value);
+    output.append(buffer.data(), length);
+  };
+
+  bool const standard = not p_message.extended();
+
+  if (standard and not p_message.remote_request()) {
+    print("t%03X", p_message.id());
+  } else if (not standard and not p_message.remote_request()) {
+    print("T%08X", p_message.id());
+  } else if (standard and p_message.remote_request()) {
+    print("r%03X", p_message.id());
+  } else {
+    print("R%08X", p_message.id());
+  }
+
+  if (not p_message.remote_request()) {
+    print("%X", int(p_message.length));
+    for (std::size_t i = 0; i < p_message.length; i++) {
+      print("%02X", int(p_message.payload[i]));
+    }
+  }
+
+  output += '\r';
+  return output;
+}
+
+/**
+ * @brief Decode a transmit command the way string_to_can_message() did
+ *
+ * The ID and every payload byte go through their own std::from_chars call,
+ * which stops at the first character that is not a hex digit. The final
+ * character is taken to be the '\r' without looking at it.
+ *
+ * @param p_command - the command including its terminating '\r'
+ * @return std::optional<hal::can_message> - the message or std::nullopt if the
+ * command was rejected
+ */
+inline std::optional<hal::can_message> reference_decode(
+  std::span<hal::byte const> p_command)
+{
+  if (p_command.empty()) {
+    return std::nullopt;
+  }
+
+  hal::can_message message{};
+  std::size_t format_size = 0;
+  std::size_t id_byte_length = 0;
+  auto const command = p_command[0];
+  std::string_view command_chars(
+    reinterpret_cast<char const*>(p_command.data()), p_command.size());
+
+  if (command == 'r' or command == 't') {
+    constexpr std::string_view format = "tiiil\r";
+    format_size = format.size();
+    id_byte_length = 3;
+    message.extended(false);
+  } else if (command == 'R' or command == 'T') {
+    constexpr std::string_view format = "Tiiiiiiiil\r";
+    format_size = format.size();
+    id_byte_length = 8;
+    message.extended(true);
+  }
+
+  if (command_chars.size() < format_size) {
+    return std::nullopt;
+  }
+
+  message.remote_request(command == 'r' or command == 'R');
+
+  // Skip the command character
+  command_chars.remove_prefix(1);
+
+  hal::u32 id = 0;
+  auto const id_status = std::from_chars(
+    command_chars.data(), command_chars.data() + id_byte_length, id, 16);
+  if (id_status.ec != std::errc{}) {
+    return std::nullopt;
+  }
+  message.id(id);
+
+  command_chars.remove_prefix(id_byte_length);
+  std::size_t const payload_length = command_chars[0] - '0';
+  command_chars.remove_prefix(1);
+
+  // (+ 1) for the '\r' character
+  if (payload_length > 8 or
+      command_chars.size() != (payload_length * 2) + 1) {
+    return std::nullopt;
+  }
+
+  message.length = payload_length;
+  for (std::size_t i = 0; i < payload_length; i++) {
+    auto const* first = command_chars.data() + (i * 2);
+    auto const status =
+      std::from_chars(first, first + 2, message.payload[i], 16);
+    if (status.ec != std::errc{}) {
+      return std::nullopt;
+    }
+  }
+
+  return message;
+}
@@ -0,0 +1,244 @@
+// Copyright 2024 Khalil Estell
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Runs the whole application against a scripted console and a simulated bus
+// and checks what it answers and sends. The scenario to run is named by
+// CAN_OPENER_SCENARIO, each one is its own ctest test. The process exits with
+// success once a scenario's checks pass. Time is simulated, so a scenario can
+// check exactly when things happen however busy the host is.
+
+#include <algorithm>
+#include <array>
+#include <cstdio>
+#include <cstdlib>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <libhal/serial.hpp>
+
+#include <app/config.hpp>
+#include <app/resource_list.hpp>
+
+#include "host/simulation.hpp"
+
+namespace {
+/// Console that types commands and collects every answer line
+class scripted_console : public hal::serial
+{
+public:
+  void type(std::string_view p_input)
+  {
+    m_input.append(p_input);
+  }
+
+  std::size_t write_nonblocking(std::span<hal::byte const> p_data)
+  {
+    for (auto const byte : p_data) {
+      if (byte == '\r' or byte == '\a') {
+        m_line.push_back(static_cast<char>(byte));
+        lines.push_back(m_line);
+        m_line.clear();
+      } else {
+        m_line.push_back(static_cast<char>(byte));
+      }
+    }
+    return p_data.size();
+  }
+
+  /// Lines written so far, each with its CR or BELL
+  std::vector<std::string> lines;
+
+private:
+  void driver_configure(settings const&) override
+  {
+  }
+
+  write_t driver_write(std::span<hal::byte const> p_data) override
+  {
+    return { .data = p_data.first(write_nonblocking(p_data)) };
+  }
+
+  read_t driver_read(std::span<hal::byte> p_data) override
+  {
+    auto const count = std::min(p_data.size(), m_input.size() - m_read);
+    std::copy_n(m_input.begin() + m_read, count, p_data.begin());
+    m_read += count;
+    return {
+      .data = p_data.first(count),
+      .available = m_input.size() - m_read,
+      .capacity = m_input.capacity(),
+    };
+  }
+
+  void driver_flush() override
+  {
+    m_read = m_input.size();
+  }
+
+  std::string m_input;
+  std::size_t m_read = 0;
+  std::string m_line;
+};
+
+struct sent_frame
+{
+  hal::u64 time;
+  hal::can_message message;
+};
+
+host_clock uptime;
+scripted_console console;
+std::vector<sent_frame> sent;
+bool passed = true;
+
+/// Longest a pass of the main loop takes on the simulated clock
+constexpr hal::u64 pass_time = 10 * host_clock::read_cost;
+
+void check(bool p_condition, char const* p_what)
+{
+  if (not p_condition) {
+    std::printf("FAILED: %s\n", p_what);
+    passed = false;
+  }
+}
+
+[[noreturn]] void finish()
+{
+  std::printf("%s\n", passed ? "passed" : "failed");
+  std::exit(passed ? EXIT_SUCCESS : EXIT_FAILURE);
+}
+
+/**
+ * @brief A 'Y' command schedules a frame that is then sent every period
+ * until 'y' removes it
+ *
+ * @param p_now - simulated time in nanoseconds
+ * @return hal::u64 - time to be called again by, at the latest
+ */
+hal::u64 periodic_scenario(hal::u64 p_now)
+{
+  constexpr hal::u64 millisecond = 1'000'000;
+  // Slot 01 every 10 ms (0x2710 us), first after 5 ms (0x1388 us)
+  constexpr std::string_view schedule = "Y010000271000001388t1232AABB\r";
+  static std::size_t sent_before_removal = 0;
+  static int step = 0;
+
+  if (step == 0) {
+    console.type("S8\rO\r");
+    console.type(schedule);
+    step++;
+  } else if (step == 1 and p_now >= 100 * millisecond) {
+    console.type("y01\r");
+    sent_before_removal = sent.size();
+    step++;
+  } else if (step == 2 and p_now >= 150 * millisecond) {
+    check(console.lines.size() == 4, "every command is answered");
+    for (auto const& line : console.lines) {
+      check(line == "\r", "every command is accepted");
+    }
+
+    // Sent at 5, 15, ... 95 ms, each by the pass after it was due
+    check(sent_before_removal == 10, "the frame is sent every period");
+    check(sent.size() == sent_before_removal, "'y' stops the frame");
+    for (std::size_t i = 0; i < sent.size(); i++) {
+      auto const& message = sent[i].message;
+      check(message.id() == 0x123 and not message.extended() and
+              message.length == 2 and message.payload[0] == 0xAA and
+              message.payload[1] == 0xBB,
+            "the scheduled frame is sent");
+      auto const due = (5 + (i * 10)) * millisecond;
+      check(sent[i].time >= due and sent[i].time - due <= pass_time,
+            "the frame is sent when it is due");
+    }
+    finish();
+  }
+  return step == 1 ? 100 * millisecond : 150 * millisecond;
+}
+
+struct scenario
+{
+  std::string_view name;
+  hal::u64 (*step)(hal::u64 p_now);
+};
+
+constexpr std::array scenarios{
+  scenario{ "periodic", periodic_scenario },
+};
+}  // namespace
+
+void initialize_platform(resource_list& p_map)
+{
+  static host_led led;
+  static std::array<std::array<hal::can_message, receive_depth>, channel_count>
+    can_receive_buffers{};
+  static std::array<std::optional<simulated_can_bus>, channel_count> buses{};
+
+  static hal::u64 (*step)(hal::u64) = nullptr;
+  auto const* name = std::getenv("CAN_OPENER_SCENARIO");
+  for (auto const& entry : scenarios) {
+    if (name != nullptr and entry.name == name) {
+      step = entry.step;
+    }
+  }
+  if (step == nullptr) {
+    std::printf("CAN_OPENER_SCENARIO must name a scenario\n");
+    std::exit(EXIT_FAILURE);
+  }
+
+  p_map.reset = +[]() { std::exit(EXIT_FAILURE); };
+  p_map.red_led = &led;
+  p_map.clock = &uptime;
+  p_map.console = &console;
+  p_map.console_write_nonblocking =
+    [](std::span<hal::byte const> p_data) -> std::size_t {
+    return console.write_nonblocking(p_data);
+  };
+
+  for (std::size_t i = 0; i < channel_count; i++) {
+    auto& bus = buses[i].emplace(can_receive_buffers[i],
+                                 frame_generator_settings{});
+    bus.on_sent([](hal::can_message const& p_message) {
+      sent.push_back({ .time = uptime.now(), .message = p_message });
+    });
+    auto& can = p_map.can_channels[i];
+    can.transceiver = &bus;
+    can.bus_manager = &bus;
+    can.interrupt = &bus;
+    can.error_state = [&bus]() { return bus.error_state(); };
+  }
+
+  p_map.wait_for_work = [](hal::callback<bool()> p_has_work) {
+    auto const now = uptime.now();
+    for (auto& bus : buses) {
+      bus->deliver(now);
+    }
+    auto next = step(now);
+    // Give up on a scenario that never reaches its checks
+    if (now > 10'000'000'000) {
+      check(false, "the scenario finishes in time");
+      finish();
+    }
+    if (p_has_work()) {
+      return;
+    }
+
+    // Skip ahead to the next frame or the scenario's next step
+    for (auto const& bus : buses) {
+      next = std::min(next, bus->next_arrival().value_or(next));
+    }
+    uptime.advance_to(next);
+  };
+}
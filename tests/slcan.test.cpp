@@ -0,0 +1,323 @@
+// Copyright 2024 Khalil Estell
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <array>
+#include <cstdio>
+#include <optional>
+#include <random>
+#include <span>
+#include <string>
+#include <string_view>
+
+#include <app/slcan.hpp>
+
+#include <boost/ut.hpp>
+
+#include "reference_slcan.hpp"
+
+namespace {
+hal::can_message random_message(std::mt19937& p_random)
+{
+  hal::can_message message{};
+  bool const extended = p_random() & 1;
+  message.extended(extended);
+  message.remote_request((p_random() & 3) == 0);
+  message.id(p_random() & (extended ? 0x1FFF'FFFF : 0x7FF));
+  message.length = p_random() % 9;
+  for (auto& byte : message.payload) {
+    byte = static_cast<hal::byte>(p_random());
+  }
+  return message;
+}
+
+std::string encode(hal::can_message const& p_message,
+                   timestamp_mode p_timestamp_mode = timestamp_mode::off,
+                   hal::u64 p_microseconds = 0)
+{
+  std::array<hal::byte, max_encoded_message_size> buffer{};
+  auto const length =
+    encode_can_message(buffer, p_message, p_timestamp_mode, p_microseconds);
+  return { reinterpret_cast<char const*>(buffer.data()), length };
+}
+
+std::span<hal::byte const> bytes(std::string_view p_text)
+{
+  return { reinterpret_cast<hal::byte const*>(p_text.data()), p_text.size() };
+}
+
+std::optional<hal::can_message> decode(std::string_view p_command)
+{
+  return decode_can_message(bytes(p_command));
+}
+
+bool same_message(hal::can_message const& p_left,
+                  hal::can_message const& p_right)
+{
+  if (p_left.id() != p_right.id() or
+      p_left.extended() != p_right.extended() or
+      p_left.remote_request() != p_right.remote_request() or
+      p_left.length != p_right.length) {
+    return false;
+  }
+  for (std::size_t i = 0; i < p_left.length; i++) {
+    if (p_left.payload[i] != p_right.payload[i]) {
+      return false;
+    }
+  }
+  return true;
+}
+
+/**
+ * @brief Make a transmit command to feed both decoders
+ *
+ * Mostly well formed commands with a few characters changed, inserted or
+ * removed, so inputs reach every check of the decoders rather than failing
+ * on the first character.
+ */
+std::string fuzz_command(std::mt19937& p_random)
+{
+  using namespace std::literals;
+  // Includes a NUL, which the sv literal keeps
+  constexpr auto alphabet = "0123456789ABCDEFabcdefGgXx-+ \r\0"sv;
+
+  auto message = random_message(p_random);
+  // Remote requests are sent with a length, like data frames
+  auto const remote_request = message.remote_request();
+  message.remote_request(false);
+  auto command = encode(message);
+  if (remote_request) {
+    command[0] = message.extended() ? 'R' : 'r';
+  }
+
+  auto const mutations = p_random() % 4;
+  for (std::size_t i = 0; i < mutations and not command.empty(); i++) {
+    auto const position = p_random() % command.size();
+    auto const character = alphabet[p_random() % alphabet.size()];
+    switch (p_random() % 4) {
+      case 0: {
+        command[position] = character;
+        break;
+      }
+      case 1: {
+        command.insert(command.begin() + position, character);
+        break;
+      }
+      case 2: {
+        command.erase(position, 1);
+        break;
+      }
+      case 3: {
+        command.resize(position);
+        break;
+      }
+    }
+  }
+  return command;
+}
+}  // namespace
+
+void slcan_test()
+{
+  using namespace boost::ut;
+
+  "encode_can_message matches the snprintf formatter"_test = []() {
+    std::mt19937 random(1);
+    std::size_t mismatches = 0;
+    for (int i = 0; i < 100'000; i++) {
+      auto const message = random_message(random);
+      if (encode(message) != reference_encode(message)) {
+        mismatches++;
+      }
+    }
+    expect(mismatches == 0) << mismatches << " frames differ";
+  };
+
+  "encode_can_message edge frames"_test = []() {
+    hal::can_message message{};
+    expect(encode(message) == "t0000\r");
+    expect(encode(message) == reference_encode(message));
+
+    message.id(0x7FF).length = 8;
+    message.payload = { 0x00, 0x01, 0x7F, 0x80, 0xA5, 0x5A, 0xFE, 0xFF };
+    expect(encode(message) == "t7FF800017F80A55AFEFF\r");
+    expect(encode(message) == reference_encode(message));
+
+    message.extended(true).id(0x1FFF'FFFF);
+    expect(encode(message) == "T1FFFFFFF800017F80A55AFEFF\r");
+    expect(encode(message) == reference_encode(message));
+
+    // Remote requests carry no length or payload
+    message.remote_request(true);
+    expect(encode(message) == "R1FFFFFFF\r");
+    message.extended(false).id(0x123);
+    expect(encode(message) == "r123\r");
+    expect(encode(message) == reference_encode(message));
+  };
+
+  "encode_can_message clamps the length to the payload"_test = []() {
+    hal::can_message message{};
+    message.id(0x1).length = 15;
+    auto const encoded = encode(message);
+    expect(encoded == "t0018" + std::string(16, '0') + "\r");
+  };
+
+  "encode_can_message appends timestamps"_test = []() {
+    hal::can_message message{};
+    message.id(0x456).length = 1;
+    message.payload[0] = 0xAB;
+
+    // Milliseconds wrap at 60000 like the Lawicel timestamp
+    hal::u64 const microseconds = 61'234'567;
+    std::array<char, 16> expected{};
+    std::snprintf(expected.data(),
+                  expected.size(),
+                  "%04X",
+                  static_cast<unsigned>((microseconds / 1'000) % 60'000));
+    expect(encode(message, timestamp_mode::milliseconds, microseconds) ==
+           std::string("t4561AB") + expected.data() + "\r");
+
+    expect(encode(message, timestamp_mode::microseconds, 0x1'2345'6789) ==
+           "t4561AB23456789\r");
+  };
+
+  "the largest frame fits max_encoded_message_size"_test = []() {
+    hal::can_message message{};
+    message.extended(true).id(0x1FFF'FFFF).length = 8;
+    auto const encoded =
+      encode(message, timestamp_mode::microseconds, 0xFFFF'FFFF);
+    expect(encoded.size() == max_encoded_message_size);
+  };
+
+  "decode_can_message agrees with the from_chars parser"_test = []() {
+    // The decoder may only be stricter than the parser it replaced: it
+    // rejects IDs and payload bytes with a non hex character anywhere, and
+    // commands that don't end in '\r'. Everything the old parser rejected is
+    // still rejected, and anything both accept decodes the same.
+    std::mt19937 random(2);
+    std::size_t accepted = 0;
+    std::size_t newly_rejected = 0;
+    std::size_t newly_accepted = 0;
+    std::size_t mismatches = 0;
+    for (int i = 0; i < 500'000; i++) {
+      auto const command = fuzz_command(random);
+      auto const message = decode(command);
+      auto const reference = reference_decode(bytes(command));
+      if (message and not reference) {
+        newly_accepted++;
+      } else if (reference and not message) {
+        newly_rejected++;
+      } else if (message and reference) {
+        accepted++;
+        if (not same_message(*message, *reference)) {
+          mismatches++;
+        }
+      }
+    }
+    expect(newly_accepted == 0) << newly_accepted << " commands accepted";
+    expect(mismatches == 0) << mismatches << " commands differ";
+    // Make sure the inputs exercise both outcomes
+    expect(accepted > 100'000);
+    expect(newly_rejected > 0);
+  };
+
+  "decode_can_message edge cases"_test = []() {
+    auto const standard = decode("t1230\r");
+    expect(standard.has_value());
+    expect(standard->id() == 0x123 and standard->length == 0);
+    expect(not standard->extended() and not standard->remote_request());
+
+    auto const extended = decode("T1FFFFFFF81122334455667788\r");
+    expect(extended.has_value());
+    expect(extended->id() == 0x1FFF'FFFF and extended->extended());
+    expect(extended->length == 8 and extended->payload[7] == 0x88);
+
+    auto const lower_case = decode("t7ff2abcd\r");
+    expect(lower_case.has_value());
+    expect(lower_case->id() == 0x7FF and lower_case->payload[0] == 0xAB);
+
+    auto const remote = decode("R000001230\r");
+    expect(remote.has_value());
+    expect(remote->remote_request() and remote->extended());
+    expect(remote->id() == 0x123 and remote->length == 0);
+
+    // Missing or wrong terminator
+    expect(not decode("t1230"));
+    expect(not decode("t1230\n"));
+    expect(not decode("t12301\r"));
+    // Too short for the ID and length
+    expect(not decode(""));
+    expect(not decode("\r"));
+    expect(not decode("t12\r"));
+    expect(not decode("T1234567\r"));
+    // Lengths out of range, including characters just outside '0'-'9'
+    expect(not decode("t1239" + std::string(18, '0') + "\r"));
+    expect(not decode("t123:\r"));
+    expect(not decode("t123/\r"));
+    // Payload too short, too long or not hex
+    expect(not decode("t12320\r"));
+    expect(not decode("t1231000\r"));
+    expect(not decode("t1231G0\r"));
+    expect(not decode("t1231 1\r"));
+    // Non hex IDs, anywhere in the field
+    expect(not decode("tG230\r"));
+    expect(not decode("t12G0\r"));
+    expect(not decode("T1234567G0\r"));
+    // Not a frame command
+    expect(not decode("x1230\r"));
+  };
+
+  "decode_hex fields"_test = []() {
+    expect(decode_hex<8>(bytes("1234ABcd").data()) == 0x1234'ABCD);
+    expect(decode_hex<3>(bytes("7FF").data()) == 0x7FF);
+    expect(decode_hex<1>(bytes("f").data()) == 0xF);
+    for (std::size_t i = 0; i < 8; i++) {
+      std::string field(8, '0');
+      field[i] = 'g';
+      expect(not decode_hex<8>(bytes(field).data()));
+    }
+
+    expect(decode_hex(bytes("1")) == 1);
+    expect(decode_hex(bytes("FFFFFFFF")) == 0xFFFF'FFFF);
+    expect(not decode_hex(bytes("")));
+    expect(not decode_hex(bytes("123456789")));
+    expect(not decode_hex(bytes("12 4")));
+  };
+
+  "encoded_frame_length reads the header only"_test = []() {
+    expect(encoded_frame_length(bytes("t1230")) == 5);
+    expect(encoded_frame_length(bytes("t12380011223344556677")) == 21);
+    expect(encoded_frame_length(bytes("T123456781AA")) == 12);
+    expect(encoded_frame_length(bytes("r1232")) == 9);
+    expect(not encoded_frame_length(bytes("t123")));
+    expect(not encoded_frame_length(bytes("t1239")));
+    expect(not encoded_frame_length(bytes("x1230")));
+    expect(not encoded_frame_length(bytes("")));
+  };
+
+  "decode_can_message reads back what encode_can_message writes"_test = []() {
+    std::mt19937 random(3);
+    std::size_t mismatches = 0;
+    for (int i = 0; i < 100'000; i++) {
+      auto message = random_message(random);
+      // Remote requests are encoded without a length, which transmit commands
+      // need
+      message.remote_request(false);
+      auto const decoded = decode(encode(message));
+      if (not decoded or not same_message(*decoded, message)) {
+        mismatches++;
+      }
+    }
+    expect(mismatches == 0) << mismatches << " frames differ";
+  };
+}
@@ -0,0 +1,154 @@
+// Copyright 2024 Khalil Estell
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <random>
+#include <set>
+
+#include <app/software_filter.hpp>
+
+#include <boost/ut.hpp>
+
+namespace {
+hal::can_message standard(hal::u32 p_id)
+{
+  hal::can_message message{};
+  message.id(p_id);
+  return message;
+}
+
+hal::can_message extended(hal::u32 p_id)
+{
+  hal::can_message message{};
+  message.extended(true).id(p_id);
+  return message;
+}
+}  // namespace
+
+void software_filter_test()
+{
+  using namespace boost::ut;
+
+  "an empty filter accepts every frame"_test = []() {
+    software_filter filter;
+    expect(not filter.enabled());
+    expect(filter.accepts(standard(0x123)));
+    expect(filter.accepts(extended(0x1234'5678)));
+  };
+
+  "standard IDs are looked up in the bitmap"_test = []() {
+    software_filter filter;
+    expect(filter.allow_standard(0x000));
+    expect(filter.allow_standard(0x123));
+    expect(filter.allow_standard(0x7FF));
+    expect(not filter.allow_standard(0x800));
+    expect(filter.enabled());
+
+    for (hal::u32 id = 0; id <= 0x7FF; id++) {
+      bool const allowed = id == 0x000 or id == 0x123 or id == 0x7FF;
+      expect(filter.accepts(standard(id)) == allowed) << id;
+    }
+    // Standard rules never let an extended frame through
+    expect(not filter.accepts(extended(0x123)));
+  };
+
+  "standard masks set every matching ID"_test = []() {
+    software_filter filter;
+    expect(filter.allow_standard_mask(0x120, 0x7F0));
+    expect(filter.allow_standard_mask(0x005, 0x00F));
+    expect(not filter.allow_standard_mask(0x800, 0x7FF));
+    expect(not filter.allow_standard_mask(0x000, 0xFFF));
+
+    for (hal::u32 id = 0; id <= 0x7FF; id++) {
+      bool const allowed = (id & 0x7F0) == 0x120 or (id & 0x00F) == 0x005;
+      expect(filter.accepts(standard(id)) == allowed) << id;
+    }
+  };
+
+  "extended IDs agree with a reference set"_test = []() {
+    std::mt19937 random(6);
+    std::size_t mismatches = 0;
+    std::size_t refused_early = 0;
+    for (int round = 0; round < 200; round++) {
+      software_filter filter;
+      std::set<hal::u32> allowed;
+      for (std::size_t i = 0; i < software_filter::extended_capacity * 2;
+           i++) {
+        auto const id = random() & 0x1FFF'FFFF;
+        if (filter.allow_extended(id)) {
+          allowed.insert(id);
+        }
+      }
+      expect(allowed.size() <= software_filter::extended_capacity);
+      if (allowed.size() < software_filter::extended_capacity) {
+        // Only IDs clustered beyond max_probes are refused before it is full
+        refused_early++;
+      }
+
+      for (auto const id : allowed) {
+        if (not filter.accepts(extended(id))) {
+          mismatches++;
+        }
+        // Re-adding an ID already present succeeds, even when the set is full
+        if (not filter.allow_extended(id)) {
+          mismatches++;
+        }
+      }
+      for (int i = 0; i < 1000; i++) {
+        auto const id = random() & 0x1FFF'FFFF;
+        if (filter.accepts(extended(id)) != allowed.contains(id)) {
+          mismatches++;
+        }
+      }
+    }
+    expect(mismatches == 0) << mismatches << " IDs filtered wrong";
+    expect(refused_early < 20) << refused_early << " sets refused IDs early";
+  };
+
+  "extended ranges and capacities are enforced"_test = []() {
+    software_filter filter;
+    expect(not filter.allow_extended(0x2000'0000));
+    expect(not filter.allow_extended_mask(0x2000'0000, 0));
+    expect(not filter.allow_extended_mask(0, 0x2000'0000));
+    expect(not filter.enabled());
+
+    for (std::size_t i = 0; i < software_filter::extended_mask_capacity; i++) {
+      expect(filter.allow_extended_mask(i << 8, 0x1FFF'FF00));
+    }
+    expect(not filter.allow_extended_mask(0x1000'0000, 0x1FFF'FFFF));
+
+    for (hal::u32 id = 0; id < 0x1000; id++) {
+      bool const allowed = id < software_filter::extended_mask_capacity << 8;
+      expect(filter.accepts(extended(id)) == allowed) << id;
+    }
+    expect(not filter.accepts(extended(0x1000'0000)));
+    expect(not filter.accepts(standard(0x001)));
+  };
+
+  "clear accepts every frame again"_test = []() {
+    software_filter filter;
+    expect(filter.allow_standard(0x100));
+    expect(filter.allow_extended(0x100));
+    expect(filter.allow_extended_mask(0x200, 0x1FFF'FFFF));
+    expect(not filter.accepts(standard(0x101)));
+
+    filter.clear();
+    expect(not filter.enabled());
+    expect(filter.accepts(standard(0x101)));
+
+    expect(filter.allow_standard(0x101));
+    expect(not filter.accepts(standard(0x100)));
+    expect(not filter.accepts(extended(0x100)));
+    expect(not filter.accepts(extended(0x200)));
+  };
+}
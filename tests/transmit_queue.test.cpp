@@ -0,0 +1,154 @@
+// Copyright 2024 Khalil Estell
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <algorithm>
+#include <random>
+#include <vector>
+
+#include <app/transmit_queue.hpp>
+
+#include <boost/ut.hpp>
+
+namespace {
+constexpr std::size_t queue_depth = 32;
+
+hal::can_message message(hal::u32 p_id,
+                         bool p_extended = false,
+                         bool p_remote_request = false)
+{
+  hal::can_message message{};
+  message.extended(p_extended).remote_request(p_remote_request).id(p_id);
+  return message;
+}
+
+/// Tells queued copies of the same frame apart
+hal::can_message tagged(hal::u32 p_id, hal::byte p_tag)
+{
+  auto tagged_message = message(p_id);
+  tagged_message.length = 1;
+  tagged_message.payload[0] = p_tag;
+  return tagged_message;
+}
+}  // namespace
+
+void transmit_queue_test()
+{
+  using namespace boost::ut;
+
+  "arbitration_priority follows the bits on the bus"_test = []() {
+    // Same base ID: standard data, standard remote, then extended frames
+    auto const standard = arbitration_priority(message(0x123));
+    auto const remote = arbitration_priority(message(0x123, false, true));
+    auto const extended =
+      arbitration_priority(message(0x123 << 18, true, false));
+    auto const extended_remote =
+      arbitration_priority(message(0x123 << 18, true, true));
+    expect(standard < remote);
+    expect(remote < extended);
+    expect(extended < extended_remote);
+
+    // The base ID decides before the frame type
+    expect(arbitration_priority(message(0x122 << 18, true)) < standard);
+    expect(standard < arbitration_priority(message(0x124)));
+    // Then the ID extension
+    expect(arbitration_priority(message((0x123 << 18) | 1, true)) >
+           extended);
+  };
+
+  "the highest priority frame never waits behind queued frames"_test = []() {
+    // The worst case for a FIFO: a full queue of the lowest priority frames
+    // ahead of the most urgent one, which would wait queue_depth - 1 frames
+    priority_transmit_queue<queue_depth> queue;
+    for (std::size_t i = 0; i < queue_depth - 1; i++) {
+      expect(queue.push(message(0x1FFF'FFFF, true, true)));
+    }
+    expect(queue.push(message(0x000)));
+    expect(queue.full());
+    expect(not queue.push(message(0x000)));
+
+    expect(queue.front().id() == 0x000);
+    expect(queue.pop()->id() == 0x000);
+  };
+
+  "frames wait only for frames that win arbitration over them"_test = []() {
+    // Frames arrive and leave at random. A frame may only be sent after
+    // another one queued with it if that one has a higher priority, or the
+    // same priority and was queued earlier. That bounds how long each frame
+    // waits by the higher priority traffic alone.
+    std::mt19937 random(9);
+    priority_transmit_queue<queue_depth> queue;
+
+    struct queued
+    {
+      hal::u32 priority;
+      hal::u32 order;
+    };
+    std::vector<queued> waiting;
+    hal::u32 order = 0;
+    std::size_t wrong = 0;
+    std::size_t worst_wait = 0;
+    std::vector<std::size_t> waited(1 << 20, 0);
+
+    for (int i = 0; i < 200'000; i++) {
+      if (random() % 2 and not queue.full()) {
+        // Few distinct IDs so equal priorities are common
+        auto frame = message(random() % 16);
+        frame.length = 4;
+        for (std::size_t byte = 0; byte < 4; byte++) {
+          frame.payload[byte] = static_cast<hal::byte>(order >> (byte * 8));
+        }
+        expect(queue.push(frame));
+        waiting.push_back({ arbitration_priority(frame), order++ });
+      } else if (auto const sent = queue.pop()) {
+        hal::u32 sent_order = 0;
+        for (std::size_t byte = 0; byte < 4; byte++) {
+          sent_order |= hal::u32{ sent->payload[byte] } << (byte * 8);
+        }
+        auto const best = std::min_element(
+          waiting.begin(), waiting.end(), [](auto const& p_a, auto const& p_b) {
+            if (p_a.priority != p_b.priority) {
+              return p_a.priority < p_b.priority;
+            }
+            return p_a.order < p_b.order;
+          });
+        if (best->order != sent_order) {
+          wrong++;
+        }
+        waiting.erase(best);
+        for (auto const& frame : waiting) {
+          worst_wait = std::max(worst_wait, ++waited[frame.order]);
+        }
+      }
+    }
+    expect(wrong == 0) << wrong << " frames sent out of priority order";
+    // Low priority frames do wait longer than the queue is deep, that is the
+    // cost of never blocking the high priority ones
+    expect(worst_wait > queue_depth) << worst_wait;
+  };
+
+  "frames of equal priority leave in the order they were queued"_test = []() {
+    priority_transmit_queue<queue_depth> queue;
+    // Many rounds, so entries move all over the heap
+    for (int round = 0; round < 40; round++) {
+      for (hal::byte tag = 0; tag < queue_depth; tag++) {
+        expect(queue.push(tagged(0x100, tag)));
+      }
+      for (hal::byte tag = 0; tag < queue_depth; tag++) {
+        auto const sent = queue.pop();
+        expect(sent and sent->payload[0] == tag);
+      }
+      expect(queue.empty() and not queue.pop());
+    }
+  };
+}
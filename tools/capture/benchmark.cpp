@@ -0,0 +1,177 @@
+// Copyright 2024 Khalil Estell
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Measures how fast capture files are written, read back as transmit
+// commands and seeked. The default of 100 million frames makes a file of
+// about 2.5 GB. Frames are spaced like a fully loaded 1 Mbit/s bus.
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+
+#include <unistd.h>
+
+#include "capture_file.hpp"
+#include "slcan_line.hpp"
+
+namespace {
+/// Time between frames, an 8 byte standard frame on a 1 Mbit/s bus
+constexpr std::uint64_t frame_spacing = 111'000;
+constexpr int seek_count = 100'000;
+
+[[noreturn]] void fail(char const* p_what)
+{
+  std::perror(p_what);
+  std::exit(EXIT_FAILURE);
+}
+
+void usage(char const* p_program)
+{
+  std::fprintf(stderr,
+               "usage: %s [-n frames] [-i index interval] [-k] file\n"
+               "  -k keeps the file afterwards\n",
+               p_program);
+  std::exit(EXIT_FAILURE);
+}
+
+double seconds_since(std::chrono::steady_clock::time_point p_start)
+{
+  std::chrono::duration<double> const elapsed =
+    std::chrono::steady_clock::now() - p_start;
+  return elapsed.count();
+}
+
+void report(char const* p_name,
+            std::uint64_t p_frames,
+            std::uint64_t p_bytes,
+            double p_seconds)
+{
+  std::printf("%-8s %12.0f frames/s %10.1f MB/s %8.2f s\n",
+              p_name,
+              p_frames / p_seconds,
+              p_bytes / p_seconds / 1e6,
+              p_seconds);
+}
+}  // namespace
+
+int main(int p_argc, char** p_argv)
+{
+  std::uint64_t frames = 100'000'000;
+  std::uint32_t index_interval = 4096;
+  bool keep = false;
+
+  int option = 0;
+  while ((option = getopt(p_argc, p_argv, "n:i:k")) != -1) {
+    switch (option) {
+      case 'n':
+        frames = std::strtoull(optarg, nullptr, 0);
+        break;
+      case 'i':
+        index_interval = std::strtoul(optarg, nullptr, 0);
+        break;
+      case 'k':
+        keep = true;
+        break;
+      default:
+        usage(p_argv[0]);
+    }
+  }
+  if (optind + 1 != p_argc or frames == 0 or index_interval == 0) {
+    usage(p_argv[0]);
+  }
+  auto const* path = p_argv[optind];
+  auto const file_bytes = sizeof(capture_header) +
+                          (frames + ((frames + index_interval - 1) /
+                                     index_interval)) *
+                            sizeof(capture_slot);
+
+  {
+    capture_writer writer;
+    if (not writer.create(path, index_interval, 0)) {
+      fail(path);
+    }
+    slcan_frame frame{};
+    frame.length = 8;
+    auto const start = std::chrono::steady_clock::now();
+    for (std::uint64_t i = 0; i < frames; i++) {
+      frame.id = 0x100 + (i % 16);
+      frame.payload[0] = i;
+      if (not writer.append(frame, i * frame_spacing)) {
+        fail(path);
+      }
+    }
+    if (not writer.close()) {
+      fail(path);
+    }
+    report("write", frames, file_bytes, seconds_since(start));
+  }
+
+  capture_reader reader;
+  if (not reader.open(path)) {
+    fail(path);
+  }
+  if (reader.frame_count() != frames) {
+    std::fprintf(stderr,
+                 "read back %llu frames\n",
+                 static_cast<unsigned long long>(reader.frame_count()));
+    return EXIT_FAILURE;
+  }
+
+  {
+    // Format every frame the way the replayer does
+    reader.sequential();
+    std::array<char, max_frame_line> line{};
+    std::uint64_t text_bytes = 0;
+    auto const start = std::chrono::steady_clock::now();
+    for (std::uint64_t i = 0; i < frames; i++) {
+      text_bytes += format_frame(to_frame(reader.slot(i)), line);
+    }
+    report("replay", frames, file_bytes, seconds_since(start));
+    if (text_bytes == 0) {
+      return EXIT_FAILURE;
+    }
+  }
+
+  {
+    std::mt19937_64 random(1);
+    std::uniform_int_distribution<std::uint64_t> times(
+      0, frames * frame_spacing);
+    auto const start = std::chrono::steady_clock::now();
+    for (int i = 0; i < seek_count; i++) {
+      auto const time = times(random);
+      auto const found = reader.seek(time);
+      // Frames are evenly spaced, so the answer is known
+      auto const expected =
+        std::min(frames, (time + frame_spacing - 1) / frame_spacing);
+      if (found != expected) {
+        std::fprintf(stderr,
+                     "seek to %llu ns found frame %llu\n",
+                     static_cast<unsigned long long>(time),
+                     static_cast<unsigned long long>(found));
+        return EXIT_FAILURE;
+      }
+    }
+    auto const seconds = seconds_since(start);
+    std::printf("seek     %12.2f us each\n", seconds * 1e6 / seek_count);
+  }
+
+  if (not keep) {
+    ::unlink(path);
+  }
+  return EXIT_SUCCESS;
+}
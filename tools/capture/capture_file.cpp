@@ -0,0 +1,274 @@
+// Copyright 2024 Khalil Estell
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "capture_file.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <new>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+/// First size of a new file, it doubles from there up to growth_limit a step
+constexpr std::size_t initial_size = 16 << 20;
+constexpr std::size_t growth_limit = 1 << 30;
+
+/// Slot holding a frame, past the index slots of its block and earlier ones
+std::uint64_t frame_slot(std::uint64_t p_frame, std::uint32_t p_interval)
+{
+  return (p_frame / p_interval) * (p_interval + 1) + 1 + (p_frame % p_interval);
+}
+}  // namespace
+
+slcan_frame to_frame(capture_slot const& p_slot)
+{
+  slcan_frame frame{};
+  frame.id = p_slot.key & ~(1U << 31);
+  frame.extended = p_slot.key & (1U << 31);
+  frame.remote_request = p_slot.flags & capture_slot::remote_request_flag;
+  frame.length = p_slot.length;
+  frame.payload = p_slot.payload;
+  if (p_slot.flags & capture_slot::channel_flag) {
+    frame.channel = p_slot.channel;
+  }
+  return frame;
+}
+
+capture_writer::~capture_writer()
+{
+  close();
+}
+
+bool capture_writer::create(char const* p_path,
+                            std::uint32_t p_index_interval,
+                            std::uint64_t p_start_time)
+{
+  if (m_file >= 0 or p_index_interval == 0) {
+    errno = EINVAL;
+    return false;
+  }
+
+  m_file = ::open(p_path, O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+  if (m_file < 0) {
+    return false;
+  }
+  if (not grow(initial_size)) {
+    return false;
+  }
+
+  m_header = new (m_mapping) capture_header{};
+  m_header->slot_size = sizeof(capture_slot);
+  m_header->index_interval = p_index_interval;
+  m_header->start_time = p_start_time;
+  m_next_slot = 0;
+  return true;
+}
+
+bool capture_writer::append(slcan_frame const& p_frame, std::uint64_t p_time)
+{
+  auto const interval = m_header->index_interval;
+  auto const count = m_header->frame_count;
+  bool const block_start = count % interval == 0;
+
+  auto const slots_needed = m_next_slot + (block_start ? 2 : 1);
+  auto const size_needed =
+    sizeof(capture_header) + (slots_needed * sizeof(capture_slot));
+  if (size_needed > m_mapped and
+      not grow(m_mapped + std::min(m_mapped, growth_limit))) {
+    return false;
+  }
+
+  if (block_start) {
+    slots()[m_next_slot++] = capture_slot{
+      .time = p_time,
+      .key = static_cast<std::uint32_t>(count / interval),
+      .flags = capture_slot::index_flag,
+    };
+  }
+
+  std::uint8_t flags = 0;
+  if (p_frame.remote_request) {
+    flags |= capture_slot::remote_request_flag;
+  }
+  if (p_frame.channel) {
+    flags |= capture_slot::channel_flag;
+  }
+  slots()[m_next_slot++] = capture_slot{
+    .time = p_time,
+    .key = p_frame.id | (p_frame.extended ? 1U << 31 : 0),
+    .flags = flags,
+    .length = p_frame.length,
+    .channel = p_frame.channel.value_or(0),
+    .payload = p_frame.payload,
+  };
+
+  // Publish the frame only once it has been written
+  m_header->frame_count = count + 1;
+  return true;
+}
+
+bool capture_writer::close()
+{
+  if (m_file < 0) {
+    return true;
+  }
+
+  auto const used =
+    sizeof(capture_header) + (m_next_slot * sizeof(capture_slot));
+  munmap(m_mapping, m_mapped);
+  bool const trimmed = ftruncate(m_file, used) == 0;
+  ::close(m_file);
+
+  m_file = -1;
+  m_mapping = nullptr;
+  m_mapped = 0;
+  m_header = nullptr;
+  return trimmed;
+}
+
+bool capture_writer::grow(std::size_t p_size)
+{
+  if (ftruncate(m_file, p_size) != 0) {
+    return false;
+  }
+
+  void* mapping = nullptr;
+  if (m_mapping) {
+    mapping = mremap(m_mapping, m_mapped, p_size, MREMAP_MAYMOVE);
+  } else {
+    mapping =
+      mmap(nullptr, p_size, PROT_READ | PROT_WRITE, MAP_SHARED, m_file, 0);
+  }
+  if (mapping == MAP_FAILED) {
+    return false;
+  }
+
+  m_mapping = static_cast<std::byte*>(mapping);
+  m_mapped = p_size;
+  m_header = reinterpret_cast<capture_header*>(m_mapping);
+  return true;
+}
+
+capture_slot* capture_writer::slots() const
+{
+  return reinterpret_cast<capture_slot*>(m_mapping + sizeof(capture_header));
+}
+
+capture_reader::~capture_reader()
+{
+  if (m_mapping) {
+    munmap(const_cast<std::byte*>(m_mapping), m_mapped);
+  }
+}
+
+bool capture_reader::open(char const* p_path)
+{
+  int const file = ::open(p_path, O_RDONLY | O_CLOEXEC);
+  if (file < 0) {
+    return false;
+  }
+
+  struct stat status{};
+  if (fstat(file, &status) != 0) {
+    ::close(file);
+    return false;
+  }
+  auto const size = static_cast<std::size_t>(status.st_size);
+  if (size < sizeof(capture_header)) {
+    ::close(file);
+    errno = EINVAL;
+    return false;
+  }
+
+  void* mapping = mmap(nullptr, size, PROT_READ, MAP_SHARED, file, 0);
+  ::close(file);
+  if (mapping == MAP_FAILED) {
+    return false;
+  }
+  m_mapping = static_cast<std::byte const*>(mapping);
+  m_mapped = size;
+  m_header = reinterpret_cast<capture_header const*>(m_mapping);
+
+  if (m_header->magic != capture_magic or
+      m_header->version != capture_version or
+      m_header->slot_size != sizeof(capture_slot) or
+      m_header->index_interval == 0) {
+    errno = EINVAL;
+    return false;
+  }
+
+  // Trust the header's count only as far as the file holds the frames
+  auto const interval = m_header->index_interval;
+  auto const slot_count =
+    (size - sizeof(capture_header)) / sizeof(capture_slot);
+  auto const full_blocks = slot_count / (interval + 1);
+  auto const partial = slot_count % (interval + 1);
+  auto const stored = (full_blocks * interval) + (partial ? partial - 1 : 0);
+  m_frame_count = std::min<std::uint64_t>(m_header->frame_count, stored);
+  return true;
+}
+
+capture_slot const& capture_reader::slot(std::uint64_t p_frame) const
+{
+  return slots()[frame_slot(p_frame, m_header->index_interval)];
+}
+
+std::uint64_t capture_reader::seek(std::uint64_t p_time) const
+{
+  auto const interval = m_header->index_interval;
+  auto const blocks = (m_frame_count + interval - 1) / interval;
+  auto const index_time = [this, interval](std::uint64_t p_block) {
+    return slots()[p_block * (interval + 1)].time;
+  };
+
+  // Find the first block starting at or after the time. Frames share times,
+  // so the end of the block before it may hold the frame.
+  std::uint64_t low = 0;
+  std::uint64_t high = blocks;
+  while (low < high) {
+    auto const middle = low + ((high - low) / 2);
+    if (index_time(middle) < p_time) {
+      low = middle + 1;
+    } else {
+      high = middle;
+    }
+  }
+  if (low == 0) {
+    return 0;
+  }
+
+  auto const first = (low - 1) * interval;
+  auto const end = std::min<std::uint64_t>(first + interval, m_frame_count);
+  for (auto frame = first; frame < end; frame++) {
+    if (slot(frame).time >= p_time) {
+      return frame;
+    }
+  }
+  return end;
+}
+
+void capture_reader::sequential() const
+{
+  madvise(const_cast<std::byte*>(m_mapping), m_mapped, MADV_SEQUENTIAL);
+}
+
+capture_slot const* capture_reader::slots() const
+{
+  return reinterpret_cast<capture_slot const*>(m_mapping +
+                                               sizeof(capture_header));
+}
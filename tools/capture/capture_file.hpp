@@ -0,0 +1,195 @@
+// Copyright 2024 Khalil Estell
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+#include "slcan_line.hpp"
+
+// Capture files start with a capture_header, followed by fixed size slots.
+// Frames are grouped into blocks of `index_interval` frames, and each block
+// starts with an index slot holding the time of the block's first frame. Any
+// frame is found by its number alone, and any time by a binary search over
+// the index slots followed by a short scan of one block.
+
+constexpr std::array<char, 8> capture_magic{ 'C', 'A', 'N', 'O',
+                                             'P', 'C', 'A', 'P' };
+constexpr std::uint32_t capture_version = 1;
+
+struct capture_header
+{
+  std::array<char, 8> magic = capture_magic;
+  std::uint32_t version = capture_version;
+  std::uint32_t slot_size = 0;
+  /// Frames in each block
+  std::uint32_t index_interval = 0;
+  std::uint32_t reserved = 0;
+  /// Frames in the file, kept current as frames are appended
+  std::uint64_t frame_count = 0;
+  /// Wall clock time the capture started, in nanoseconds since the Unix epoch
+  std::uint64_t start_time = 0;
+  std::array<std::uint8_t, 24> padding{};
+};
+
+struct capture_slot
+{
+  /// Flag set in `flags` for index slots
+  static constexpr std::uint8_t index_flag = 1 << 7;
+  /// Flag set in `flags` for remote request frames
+  static constexpr std::uint8_t remote_request_flag = 1 << 0;
+  /// Flag set in `flags` for frames recorded with the channel they arrived on
+  static constexpr std::uint8_t channel_flag = 1 << 1;
+
+  /// Nanoseconds since the capture started, never decreasing
+  std::uint64_t time = 0;
+  /// ID with bit 31 set for extended frames, or the block number for index
+  /// slots
+  std::uint32_t key = 0;
+  std::uint8_t flags = 0;
+  std::uint8_t length = 0;
+  /// Channel the frame was received on, if `channel_flag` is set
+  std::uint8_t channel = 0;
+  std::uint8_t reserved = 0;
+  std::array<std::uint8_t, 8> payload{};
+};
+
+static_assert(sizeof(capture_header) == 64);
+static_assert(sizeof(capture_slot) == 24);
+
+/// Frame stored in a slot
+slcan_frame to_frame(capture_slot const& p_slot);
+
+/**
+ * @brief Appends frames to a capture file through a memory mapping
+ *
+ * The file grows in large steps and is trimmed to its contents when closed.
+ * The frame count in the header is updated with every frame, so a capture
+ * cut short by a crash can still be read up to its last frame.
+ */
+class capture_writer
+{
+public:
+  capture_writer() = default;
+  ~capture_writer();
+
+  capture_writer(capture_writer const&) = delete;
+  capture_writer& operator=(capture_writer const&) = delete;
+
+  /**
+   * @brief Create a capture file, replacing any file at the path
+   *
+   * @param p_path - where to create the file
+   * @param p_index_interval - frames in each block
+   * @param p_start_time - wall clock start time in nanoseconds since the
+   * Unix epoch
+   * @return true - the file is ready for frames
+   * @return false - the file could not be created, errno says why
+   */
+  bool create(char const* p_path,
+              std::uint32_t p_index_interval,
+              std::uint64_t p_start_time);
+
+  /**
+   * @brief Append a frame
+   *
+   * @param p_frame - the frame
+   * @param p_time - nanoseconds since the capture started, not less than the
+   * time of the previous frame
+   * @return true - the frame was appended
+   * @return false - the file could not grow, errno says why
+   */
+  bool append(slcan_frame const& p_frame, std::uint64_t p_time);
+
+  /**
+   * @brief Trim the file to its contents and close it
+   *
+   * @return true - the file was closed cleanly
+   * @return false - trimming failed, errno says why
+   */
+  bool close();
+
+  std::uint64_t frame_count() const
+  {
+    return m_header ? m_header->frame_count : 0;
+  }
+
+private:
+  bool grow(std::size_t p_size);
+  capture_slot* slots() const;
+
+  int m_file = -1;
+  std::byte* m_mapping = nullptr;
+  std::size_t m_mapped = 0;
+  capture_header* m_header = nullptr;
+  std::uint64_t m_next_slot = 0;
+};
+
+/**
+ * @brief Reads a capture file through a read only memory mapping
+ */
+class capture_reader
+{
+public:
+  capture_reader() = default;
+  ~capture_reader();
+
+  capture_reader(capture_reader const&) = delete;
+  capture_reader& operator=(capture_reader const&) = delete;
+
+  /**
+   * @brief Open a capture file
+   *
+   * @param p_path - the file
+   * @return true - the file is a capture and ready to read
+   * @return false - the file could not be opened or is not a capture, errno
+   * says why
+   */
+  bool open(char const* p_path);
+
+  capture_header const& header() const
+  {
+    return *m_header;
+  }
+
+  std::uint64_t frame_count() const
+  {
+    return m_frame_count;
+  }
+
+  /// The slot holding frame number p_frame
+  capture_slot const& slot(std::uint64_t p_frame) const;
+
+  /**
+   * @brief Find the first frame at or after a time
+   *
+   * @param p_time - nanoseconds since the capture started
+   * @return std::uint64_t - frame number, frame_count() if every frame is
+   * earlier
+   */
+  std::uint64_t seek(std::uint64_t p_time) const;
+
+  /// Tell the kernel frames will be read in order from here on
+  void sequential() const;
+
+private:
+  capture_slot const* slots() const;
+
+  std::byte const* m_mapping = nullptr;
+  std::size_t m_mapped = 0;
+  capture_header const* m_header = nullptr;
+  std::uint64_t m_frame_count = 0;
+};
@@ -0,0 +1,173 @@
+// Copyright 2024 Khalil Estell
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Records the frames a device forwards into a capture file, timed by when
+// they reached this machine. Frames from firmware built with more than one
+// channel are recorded with their channel. Stops on SIGINT or SIGTERM, or
+// when the device goes away.
+
+#include <array>
+#include <cerrno>
+#include <csignal>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <string>
+#include <string_view>
+
+#include <unistd.h>
+
+#include "capture_file.hpp"
+#include "device.hpp"
+#include "slcan_line.hpp"
+
+namespace {
+volatile std::sig_atomic_t stop_requested = 0;
+
+void request_stop(int)
+{
+  stop_requested = 1;
+}
+
+[[noreturn]] void fail(char const* p_what)
+{
+  std::perror(p_what);
+  std::exit(EXIT_FAILURE);
+}
+
+void usage(char const* p_program)
+{
+  std::fprintf(stderr,
+               "usage: %s [-b baud] [-c setup commands] [-i index interval] "
+               "device file\n"
+               "  setup commands are separated by commas, the default is "
+               "\"O\"\n",
+               p_program);
+  std::exit(EXIT_FAILURE);
+}
+
+std::uint64_t clock_nanoseconds(clockid_t p_clock)
+{
+  timespec now{};
+  clock_gettime(p_clock, &now);
+  return (static_cast<std::uint64_t>(now.tv_sec) * 1'000'000'000) +
+         now.tv_nsec;
+}
+
+void write_all(int p_device, std::string_view p_bytes)
+{
+  while (not p_bytes.empty()) {
+    auto const written = ::write(p_device, p_bytes.data(), p_bytes.size());
+    if (written < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      fail("write");
+    }
+    p_bytes.remove_prefix(written);
+  }
+}
+}  // namespace
+
+int main(int p_argc, char** p_argv)
+{
+  speed_t baud_rate = B115200;
+  std::string setup = "O";
+  std::uint32_t index_interval = 4096;
+
+  int option = 0;
+  while ((option = getopt(p_argc, p_argv, "b:c:i:")) != -1) {
+    switch (option) {
+      case 'b':
+        baud_rate = baud_rate_constant(std::atol(optarg));
+        if (baud_rate == 0) {
+          usage(p_argv[0]);
+        }
+        break;
+      case 'c':
+        setup = optarg;
+        break;
+      case 'i':
+        index_interval = std::strtoul(optarg, nullptr, 0);
+        break;
+      default:
+        usage(p_argv[0]);
+    }
+  }
+  if (optind + 2 != p_argc or index_interval == 0) {
+    usage(p_argv[0]);
+  }
+  auto const* device_path = p_argv[optind];
+  auto const* file_path = p_argv[optind + 1];
+
+  int const device = open_device(device_path, baud_rate, false);
+  if (device < 0) {
+    fail(device_path);
+  }
+
+  capture_writer capture;
+  if (not capture.create(
+        file_path, index_interval, clock_nanoseconds(CLOCK_REALTIME))) {
+    fail(file_path);
+  }
+  auto const start = clock_nanoseconds(CLOCK_MONOTONIC);
+
+  // Without SA_RESTART a signal interrupts the blocking read below
+  struct sigaction action{};
+  action.sa_handler = request_stop;
+  sigaction(SIGINT, &action, nullptr);
+  sigaction(SIGTERM, &action, nullptr);
+
+  for (auto& character : setup) {
+    if (character == ',') {
+      character = '\r';
+    }
+  }
+  setup += '\r';
+  write_all(device, setup);
+
+  line_splitter lines;
+  std::array<char, 16 * 1024> buffer{};
+  while (not stop_requested) {
+    auto const received = ::read(device, buffer.data(), buffer.size());
+    if (received < 0 and errno == EINTR) {
+      continue;
+    }
+    if (received <= 0) {
+      std::fprintf(stderr, "device closed\n");
+      break;
+    }
+
+    // Every frame in one read arrived together as far as this machine can
+    // tell
+    auto const now = clock_nanoseconds(CLOCK_MONOTONIC) - start;
+    lines.append(std::string_view(buffer.data(), received));
+    while (auto const line = lines.next()) {
+      auto const frame = parse_frame(*line);
+      if (frame and not capture.append(*frame, now)) {
+        fail(file_path);
+      }
+    }
+  }
+
+  auto const frames = capture.frame_count();
+  if (not capture.close()) {
+    fail(file_path);
+  }
+  std::fprintf(stderr,
+               "recorded %llu frames\n",
+               static_cast<unsigned long long>(frames));
+  return EXIT_SUCCESS;
+}
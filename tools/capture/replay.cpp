@@ -0,0 +1,291 @@
+// Copyright 2024 Khalil Estell
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Sends the frames in a capture file to a device as transmit commands, with
+// the time between frames they were recorded with. Frames recorded with their
+// channel are sent on the same channel, selected with a `J` command whenever
+// it changes. A device of "-" writes the commands to standard output instead.
+
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <csignal>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <optional>
+#include <string>
+#include <string_view>
+
+#include <poll.h>
+#include <unistd.h>
+
+#include "capture_file.hpp"
+#include "device.hpp"
+#include "slcan_line.hpp"
+
+namespace {
+/// Frames due this close together are written to the device in one go
+constexpr std::uint64_t batch_window = 100'000;
+/// Most bytes gathered before they are written
+constexpr std::size_t batch_limit = 32 * 1024;
+/// Time left for the device to answer the setup commands
+constexpr std::uint64_t setup_time = 50'000'000;
+/// Time left for the device to answer the last commands
+constexpr std::uint64_t answer_time = 200'000'000;
+
+volatile std::sig_atomic_t stop_requested = 0;
+
+void request_stop(int)
+{
+  stop_requested = 1;
+}
+
+[[noreturn]] void fail(char const* p_what)
+{
+  std::perror(p_what);
+  std::exit(EXIT_FAILURE);
+}
+
+void usage(char const* p_program)
+{
+  std::fprintf(stderr,
+               "usage: %s [-b baud] [-c setup commands] [-s start seconds] "
+               "[-x speed] file device\n"
+               "  setup commands are separated by commas, the default is "
+               "\"O\"\n",
+               p_program);
+  std::exit(EXIT_FAILURE);
+}
+
+std::uint64_t monotonic_nanoseconds()
+{
+  timespec now{};
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (static_cast<std::uint64_t>(now.tv_sec) * 1'000'000'000) +
+         now.tv_nsec;
+}
+
+void sleep_until(std::uint64_t p_time)
+{
+  timespec const until{
+    .tv_sec = static_cast<time_t>(p_time / 1'000'000'000),
+    .tv_nsec = static_cast<long>(p_time % 1'000'000'000),
+  };
+  while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &until, nullptr) ==
+           EINTR and
+         not stop_requested) {
+    continue;
+  }
+}
+
+/**
+ * @brief The device, or standard output
+ */
+class output
+{
+public:
+  output(int p_descriptor, bool p_answers)
+    : m_descriptor(p_descriptor)
+    , m_answers(p_answers)
+  {
+  }
+
+  void write(std::string_view p_bytes)
+  {
+    while (not p_bytes.empty()) {
+      auto const written =
+        ::write(m_descriptor, p_bytes.data(), p_bytes.size());
+      if (written >= 0) {
+        p_bytes.remove_prefix(written);
+        continue;
+      }
+      if (errno != EAGAIN and errno != EINTR) {
+        fail("write");
+      }
+      // The device is behind, read its answers while waiting for it
+      pollfd ready{ .fd = m_descriptor, .events = POLLOUT, .revents = 0 };
+      poll(&ready, 1, 10);
+      read_answers();
+    }
+    read_answers();
+  }
+
+  /// Count the BELLs the device answered rejected commands with
+  void read_answers()
+  {
+    if (not m_answers) {
+      return;
+    }
+    std::array<char, 4096> buffer{};
+    while (true) {
+      auto const received = ::read(m_descriptor, buffer.data(), buffer.size());
+      if (received <= 0) {
+        return;
+      }
+      m_rejected += std::count(buffer.begin(), buffer.begin() + received, '\a');
+    }
+  }
+
+  std::uint64_t rejected() const
+  {
+    return m_rejected;
+  }
+
+  void forget_rejected()
+  {
+    m_rejected = 0;
+  }
+
+private:
+  int m_descriptor;
+  bool m_answers;
+  std::uint64_t m_rejected = 0;
+};
+}  // namespace
+
+int main(int p_argc, char** p_argv)
+{
+  speed_t baud_rate = B115200;
+  std::string setup = "O";
+  double start_seconds = 0.0;
+  double speed = 1.0;
+
+  int option = 0;
+  while ((option = getopt(p_argc, p_argv, "b:c:s:x:")) != -1) {
+    switch (option) {
+      case 'b':
+        baud_rate = baud_rate_constant(std::atol(optarg));
+        if (baud_rate == 0) {
+          usage(p_argv[0]);
+        }
+        break;
+      case 'c':
+        setup = optarg;
+        break;
+      case 's':
+        start_seconds = std::strtod(optarg, nullptr);
+        break;
+      case 'x':
+        speed = std::strtod(optarg, nullptr);
+        break;
+      default:
+        usage(p_argv[0]);
+    }
+  }
+  if (optind + 2 != p_argc or speed <= 0.0 or start_seconds < 0.0) {
+    usage(p_argv[0]);
+  }
+  auto const* file_path = p_argv[optind];
+  auto const* device_path = p_argv[optind + 1];
+
+  capture_reader capture;
+  if (not capture.open(file_path)) {
+    fail(file_path);
+  }
+
+  bool const to_device = std::string_view(device_path) != "-";
+  int descriptor = STDOUT_FILENO;
+  if (to_device) {
+    descriptor = open_device(device_path, baud_rate, true);
+    if (descriptor < 0) {
+      fail(device_path);
+    }
+  }
+  output device(descriptor, to_device);
+
+  struct sigaction action{};
+  action.sa_handler = request_stop;
+  sigaction(SIGINT, &action, nullptr);
+  sigaction(SIGTERM, &action, nullptr);
+
+  if (to_device) {
+    for (auto& character : setup) {
+      if (character == ',') {
+        character = '\r';
+      }
+    }
+    setup += '\r';
+    device.write(setup);
+    // Only count rejected frames, not rejected setup commands
+    sleep_until(monotonic_nanoseconds() + setup_time);
+    device.read_answers();
+    device.forget_rejected();
+  }
+
+  auto const first =
+    capture.seek(static_cast<std::uint64_t>(start_seconds * 1e9));
+  auto const count = capture.frame_count();
+  if (first == count) {
+    std::fprintf(stderr, "no frames at or after %.3f s\n", start_seconds);
+    return EXIT_FAILURE;
+  }
+  capture.sequential();
+
+  auto const origin = capture.slot(first).time;
+  auto const base = monotonic_nanoseconds();
+  std::string batch;
+  batch.reserve(batch_limit + max_frame_line);
+  std::uint64_t latest = 0;
+  std::uint64_t sent = 0;
+  std::optional<std::uint8_t> selected_channel;
+
+  for (auto frame = first; frame < count and not stop_requested; frame++) {
+    auto const& slot = capture.slot(frame);
+    auto const due =
+      base + static_cast<std::uint64_t>((slot.time - origin) / speed);
+
+    auto now = monotonic_nanoseconds();
+    if (due > now + batch_window) {
+      device.write(batch);
+      batch.clear();
+      sleep_until(due);
+      now = monotonic_nanoseconds();
+    }
+    if (now > due) {
+      latest = std::max(latest, now - due);
+    }
+
+    auto const recorded = to_frame(slot);
+    if (recorded.channel and recorded.channel != selected_channel) {
+      std::array<char, 3> const select{
+        'J', static_cast<char>('0' + *recorded.channel), '\r'
+      };
+      batch.append(select.data(), select.size());
+      selected_channel = recorded.channel;
+    }
+    std::array<char, max_frame_line> line{};
+    auto const length = format_frame(recorded, line);
+    batch.append(line.data(), length);
+    sent++;
+    if (batch.size() >= batch_limit) {
+      device.write(batch);
+      batch.clear();
+    }
+  }
+  device.write(batch);
+
+  if (to_device) {
+    sleep_until(monotonic_nanoseconds() + answer_time);
+    device.read_answers();
+  }
+  std::fprintf(stderr,
+               "sent %llu frames, %llu rejected by the device, "
+               "at most %.3f ms late\n",
+               static_cast<unsigned long long>(sent),
+               static_cast<unsigned long long>(device.rejected()),
+               latest / 1e6);
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,122 @@
+// Copyright 2024 Khalil Estell
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Records frames from a pseudo terminal standing in for the device with
+// can-opener-record, replays the capture into another one with
+// can-opener-replay and checks that the same frames come out. The two tools
+// to run are the arguments.
+
+#include <array>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <thread>
+
+#include <unistd.h>
+
+#include "slcan_line.hpp"
+#include "stand_in_device.hpp"
+
+namespace {
+bool passed = true;
+
+void check(bool p_condition, char const* p_what)
+{
+  if (not p_condition) {
+    std::printf("FAILED: %s\n", p_what);
+    passed = false;
+  }
+}
+
+struct round_trip
+{
+  /// Line the device forwards
+  std::string_view forwarded;
+  /// Commands replay sends for it, separated by carriage returns
+  std::string_view replayed;
+};
+
+constexpr std::array frames{
+  round_trip{ "t1232AABB", "t1232AABB" },
+  round_trip{ "T1FFFFFFF3010203", "T1FFFFFFF3010203" },
+  // Remote frames with and without their length
+  round_trip{ "r7FF4", "r7FF4" },
+  round_trip{ "r123", "r1230" },
+  round_trip{ "R12345678", "R123456780" },
+  // A timestamp after the payload is not part of the frame
+  round_trip{ "t00011100AB", "t000111" },
+  // Frames from firmware with several channels go back to their channel
+  round_trip{ "1t1232AABB", "J1\rt1232AABB" },
+  round_trip{ "1r7FF0", "r7FF0" },
+  round_trip{ "0R12345678", "J0\rR123456780" },
+};
+}  // namespace
+
+int main(int p_argc, char** p_argv)
+{
+  if (p_argc != 3) {
+    std::fprintf(
+      stderr, "usage: %s can-opener-record can-opener-replay\n", p_argv[0]);
+    return EXIT_FAILURE;
+  }
+  auto const file_path =
+    "/tmp/can-opener-capture-test-" + std::to_string(::getpid()) + ".cap";
+
+  {
+    stand_in_device device;
+    child_process record({ p_argv[1], device.path(), file_path });
+    check(device.read_line() == "O", "record sends its setup command");
+    device.write("\r");
+    for (auto const& frame : frames) {
+      device.write(std::string(frame.forwarded) + '\r');
+    }
+    // Answers are not frames and are not recorded
+    device.write("z\r\a");
+    // Give the recorder time to read everything before stopping it
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+    check(record.stop() == EXIT_SUCCESS, "record stops cleanly");
+  }
+
+  {
+    stand_in_device device;
+    child_process replay({ p_argv[2], file_path, device.path() });
+    check(device.read_line() == "O", "replay sends its setup command");
+    device.write("\r");
+    for (auto const& frame : frames) {
+      line_splitter expected;
+      expected.append(frame.replayed);
+      expected.append("\r");
+      while (auto const command = expected.next()) {
+        auto const line = device.read_line();
+        check(line == command, "each recorded frame is replayed");
+        if (line != command) {
+          std::printf("  expected %s, got %s\n",
+                      command->c_str(),
+                      line ? line->c_str() : "nothing");
+        }
+        device.write("\r");
+      }
+    }
+    check(not device.read_line(std::chrono::milliseconds(300)),
+          "nothing else is replayed");
+    check(replay.stop() == EXIT_SUCCESS, "replay stops cleanly");
+  }
+
+  ::unlink(file_path.c_str());
+  std::printf("%s\n", passed ? "passed" : "failed");
+  return passed ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,101 @@
+// Copyright 2024 Khalil Estell
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "device.hpp"
+
+#include <cerrno>
+#include <cstring>
+
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+speed_t baud_rate_constant(long p_baud_rate)
+{
+  switch (p_baud_rate) {
+    case 9600:
+      return B9600;
+    case 19200:
+      return B19200;
+    case 38400:
+      return B38400;
+    case 57600:
+      return B57600;
+    case 115200:
+      return B115200;
+    case 230400:
+      return B230400;
+    case 460800:
+      return B460800;
+    case 921600:
+      return B921600;
+    default:
+      return 0;
+  }
+}
+
+namespace {
+int connect_socket(char const* p_path, int p_flags)
+{
+  sockaddr_un address{};
+  address.sun_family = AF_UNIX;
+  if (std::strlen(p_path) >= sizeof(address.sun_path)) {
+    errno = ENAMETOOLONG;
+    return -1;
+  }
+  std::strcpy(address.sun_path, p_path);
+
+  int const socket = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  if (socket < 0) {
+    return -1;
+  }
+  auto const* generic = reinterpret_cast<sockaddr const*>(&address);
+  if (::connect(socket, generic, sizeof(address)) != 0) {
+    ::close(socket);
+    return -1;
+  }
+  if (p_flags & O_NONBLOCK) {
+    fcntl(socket, F_SETFL, fcntl(socket, F_GETFL) | O_NONBLOCK);
+  }
+  return socket;
+}
+}  // namespace
+
+int open_device(char const* p_path, speed_t p_baud_rate, bool p_nonblocking)
+{
+  int const flags = p_nonblocking ? O_NONBLOCK : 0;
+
+  struct stat status{};
+  if (::stat(p_path, &status) == 0 and S_ISSOCK(status.st_mode)) {
+    return connect_socket(p_path, flags);
+  }
+
+  int const device = ::open(p_path, O_RDWR | O_NOCTTY | O_CLOEXEC | flags);
+  if (device < 0) {
+    return -1;
+  }
+
+  // Pseudo terminals standing in for the device accept these settings too
+  termios settings{};
+  if (tcgetattr(device, &settings) == 0) {
+    cfmakeraw(&settings);
+    cfsetispeed(&settings, p_baud_rate);
+    cfsetospeed(&settings, p_baud_rate);
+    tcsetattr(device, TCSANOW, &settings);
+    tcflush(device, TCIOFLUSH);
+  }
+  return device;
+}
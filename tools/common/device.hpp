@@ -0,0 +1,39 @@
+// Copyright 2024 Khalil Estell
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <termios.h>
+
+/**
+ * @brief Convert a baud rate to its termios constant
+ *
+ * @param p_baud_rate - bits per second
+ * @return speed_t - the constant or 0 if the rate is not supported
+ */
+speed_t baud_rate_constant(long p_baud_rate);
+
+/**
+ * @brief Open a connection to a device
+ *
+ * Serial ports and pseudo terminals are put in raw mode at the given baud
+ * rate and flushed. A path naming a Unix socket, such as the one served by
+ * can-opener-fanout, is connected to instead.
+ *
+ * @param p_path - serial port, pseudo terminal or socket
+ * @param p_baud_rate - termios baud rate constant for serial ports
+ * @param p_nonblocking - whether reads and writes should not block
+ * @return int - the descriptor, or -1 with errno set on failure
+ */
+int open_device(char const* p_path, speed_t p_baud_rate, bool p_nonblocking);
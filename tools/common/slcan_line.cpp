@@ -0,0 +1,208 @@
+// Copyright 2024 Khalil Estell
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "slcan_line.hpp"
+
+void line_splitter::append(std::string_view p_bytes)
+{
+  // Drop consumed bytes before growing so the buffer stays small
+  if (m_start > 0 and m_start >= m_buffer.size() / 2) {
+    m_buffer.erase(0, m_start);
+    m_start = 0;
+  }
+  m_buffer.append(p_bytes);
+}
+
+std::optional<std::string> line_splitter::next()
+{
+  while (true) {
+    auto const remaining = std::string_view(m_buffer).substr(m_start);
+    auto const end = remaining.find_first_of("\r\n\a");
+    if (end == std::string_view::npos) {
+      return std::nullopt;
+    }
+
+    if (remaining[end] == '\a') {
+      // A BELL is an answer on its own, even without a carriage return
+      if (end == 0) {
+        m_start++;
+        return std::string(1, '\a');
+      }
+      // Hand out what came before it first
+      m_start += end;
+      return std::string(remaining.substr(0, end));
+    }
+
+    m_start += end + 1;
+    // Skip the empty line between a carriage return and a line feed
+    if (end == 0 and remaining[0] == '\n') {
+      continue;
+    }
+    return std::string(remaining.substr(0, end));
+  }
+}
+
+namespace {
+bool hex_value(char p_digit, std::uint32_t& p_value)
+{
+  if (p_digit >= '0' and p_digit <= '9') {
+    p_value = p_digit - '0';
+  } else if (p_digit >= 'A' and p_digit <= 'F') {
+    p_value = p_digit - 'A' + 10;
+  } else if (p_digit >= 'a' and p_digit <= 'f') {
+    p_value = p_digit - 'a' + 10;
+  } else {
+    return false;
+  }
+  return true;
+}
+
+bool hex_number(std::string_view p_digits, std::uint32_t& p_value)
+{
+  p_value = 0;
+  for (auto const digit : p_digits) {
+    std::uint32_t value = 0;
+    if (not hex_value(digit, value)) {
+      return false;
+    }
+    p_value = (p_value << 4) | value;
+  }
+  return true;
+}
+
+/// ID digits of a frame line, or 0 if the line is not a frame
+/// Remove a leading channel digit, returning the channel
+std::optional<std::uint8_t> take_channel_tag(std::string_view& p_line)
+{
+  if (not has_channel_tag(p_line)) {
+    return std::nullopt;
+  }
+  auto const channel = static_cast<std::uint8_t>(p_line[0] - '0');
+  p_line.remove_prefix(1);
+  return channel;
+}
+
+std::size_t id_digits(std::string_view p_line)
+{
+  if (p_line.empty()) {
+    return 0;
+  }
+  switch (p_line[0]) {
+    case 't':
+    case 'r':
+      return 3;
+    case 'T':
+    case 'R':
+      return 8;
+    default:
+      return 0;
+  }
+}
+}  // namespace
+
+std::optional<std::uint32_t> frame_key(std::string_view p_line)
+{
+  take_channel_tag(p_line);
+  auto const digits = id_digits(p_line);
+  std::uint32_t id = 0;
+  if (digits == 0 or p_line.size() < 1 + digits or
+      not hex_number(p_line.substr(1, digits), id)) {
+    return std::nullopt;
+  }
+  return digits == 8 ? id | (1U << 31) : id;
+}
+
+bool is_error_event(std::string_view p_line)
+{
+  constexpr std::string_view format = "esttrraaaabbbb";
+
+  take_channel_tag(p_line);
+  std::uint32_t fields = 0;
+  return p_line.size() >= format.size() and p_line[0] == 'e' and
+         hex_number(p_line.substr(1, format.size() - 1), fields);
+}
+
+std::optional<slcan_frame> parse_frame(std::string_view p_line)
+{
+  auto const channel = take_channel_tag(p_line);
+  auto const digits = id_digits(p_line);
+  if (digits == 0 or p_line.size() < 1 + digits) {
+    return std::nullopt;
+  }
+
+  slcan_frame frame{};
+  frame.channel = channel;
+  frame.extended = digits == 8;
+  frame.remote_request = p_line[0] == 'r' or p_line[0] == 'R';
+  if (not hex_number(p_line.substr(1, digits), frame.id)) {
+    return std::nullopt;
+  }
+
+  // Remote frames may leave out their length, which is then 0
+  if (p_line.size() == 1 + digits) {
+    return frame.remote_request ? std::optional(frame) : std::nullopt;
+  }
+
+  std::uint32_t length = 0;
+  if (not hex_value(p_line[1 + digits], length) or length > 8) {
+    return std::nullopt;
+  }
+  frame.length = length;
+
+  if (frame.remote_request) {
+    return frame;
+  }
+
+  auto const payload = p_line.substr(1 + digits + 1);
+  if (payload.size() < length * 2) {
+    return std::nullopt;
+  }
+  for (std::size_t i = 0; i < length; i++) {
+    std::uint32_t byte = 0;
+    if (not hex_number(payload.substr(i * 2, 2), byte)) {
+      return std::nullopt;
+    }
+    frame.payload[i] = byte;
+  }
+  return frame;
+}
+
+std::size_t format_frame(slcan_frame const& p_frame,
+                         std::span<char, max_frame_line> p_line)
+{
+  constexpr std::string_view digits = "0123456789ABCDEF";
+
+  std::size_t position = 0;
+  if (p_frame.remote_request) {
+    p_line[position++] = p_frame.extended ? 'R' : 'r';
+  } else {
+    p_line[position++] = p_frame.extended ? 'T' : 't';
+  }
+
+  int const id_digits = p_frame.extended ? 8 : 3;
+  for (int shift = (id_digits - 1) * 4; shift >= 0; shift -= 4) {
+    p_line[position++] = digits[(p_frame.id >> shift) & 0xF];
+  }
+
+  std::size_t const length = p_frame.length > 8 ? 8 : p_frame.length;
+  p_line[position++] = digits[length];
+  if (not p_frame.remote_request) {
+    for (std::size_t i = 0; i < length; i++) {
+      p_line[position++] = digits[p_frame.payload[i] >> 4];
+      p_line[position++] = digits[p_frame.payload[i] & 0xF];
+    }
+  }
+  p_line[position++] = '\r';
+  return position;
+}
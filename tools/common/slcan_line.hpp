@@ -0,0 +1,148 @@
+// Copyright 2024 Khalil Estell
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+
+/**
+ * @brief Splits a byte stream into slcan lines
+ *
+ * Lines end at a carriage return. A BELL also ends a line and is kept as the
+ * whole line, since the device answers a failed command with a lone BELL.
+ * Line feeds are treated like carriage returns so people can type at the
+ * daemon with line based tools.
+ */
+class line_splitter
+{
+public:
+  /// Add bytes to the stream
+  void append(std::string_view p_bytes);
+
+  /**
+   * @brief Take the next complete line, without its terminator
+   *
+   * @return std::optional<std::string> - the line or std::nullopt if no
+   * complete line has arrived
+   */
+  std::optional<std::string> next();
+
+  /// Bytes held that do not yet form a line
+  std::size_t pending() const
+  {
+    return m_buffer.size() - m_start;
+  }
+
+private:
+  std::string m_buffer;
+  std::size_t m_start = 0;
+};
+
+/**
+ * @brief Whether a line starts with the channel digit firmware built with
+ * more than one channel puts in front of each forwarded frame
+ *
+ * @param p_line - line without its terminator
+ */
+inline bool has_channel_tag(std::string_view p_line)
+{
+  return not p_line.empty() and p_line[0] >= '0' and p_line[0] <= '9';
+}
+
+/**
+ * @brief Key of a frame forwarded by the device
+ *
+ * The key is the frame's ID with bit 31 set for extended frames, matching the
+ * key used by the device's capture trigger. A channel digit in front of the
+ * frame is skipped, the key is the same on every channel.
+ *
+ * @param p_line - line without its terminator
+ * @return std::optional<std::uint32_t> - the key or std::nullopt if the line
+ * is not a `t`, `T`, `r` or `R` frame
+ */
+std::optional<std::uint32_t> frame_key(std::string_view p_line);
+
+/**
+ * @brief Whether a line is an error event
+ *
+ * The device streams `esttrraaaabbbb` lines, with a channel digit in front in
+ * firmware built with more than one channel, once `E1iiii` enables them. They
+ * answer no command.
+ *
+ * @param p_line - line without its terminator
+ */
+bool is_error_event(std::string_view p_line);
+
+/**
+ * @brief Whether a line asks the device to transmit a frame
+ *
+ * Only the shape of the ID is checked, the device validates the rest.
+ * Transmit commands never carry a channel digit, they go to the channel
+ * selected with `J`.
+ *
+ * @param p_line - line without its terminator
+ */
+inline bool is_transmit_command(std::string_view p_line)
+{
+  return not has_channel_tag(p_line) and frame_key(p_line).has_value();
+}
+
+/**
+ * @brief A CAN frame as written in an slcan line
+ */
+struct slcan_frame
+{
+  std::uint32_t id = 0;
+  bool extended = false;
+  bool remote_request = false;
+  std::uint8_t length = 0;
+  std::array<std::uint8_t, 8> payload{};
+  /// Channel the frame was received on, for lines with a channel digit
+  std::optional<std::uint8_t> channel;
+};
+
+/// Longest `t`, `T`, `r` or `R` line, with its carriage return
+constexpr std::size_t max_frame_line = 1 + 8 + 1 + 16 + 1;
+
+/**
+ * @brief Decode a `t`, `T`, `r` or `R` line
+ *
+ * A channel digit in front of the frame is kept in the frame's channel. A
+ * timestamp after the payload is ignored. A remote frame may end right after
+ * its ID, as `riii` or `Riiiiiiii`, and then has a length of 0.
+ *
+ * @param p_line - line without its terminator
+ * @return std::optional<slcan_frame> - the frame or std::nullopt if the line
+ * is not a well formed frame
+ */
+std::optional<slcan_frame> parse_frame(std::string_view p_line);
+
+/**
+ * @brief Encode a frame as a transmit command
+ *
+ * The channel is not written, transmit commands go to the channel selected
+ * with `J`.
+ *
+ * @param p_frame - frame to encode
+ * @param p_line - where to write the line
+ * @return std::size_t - length of the line, including its carriage return
+ */
+std::size_t format_frame(slcan_frame const& p_frame,
+                         std::span<char, max_frame_line> p_line);
@@ -0,0 +1,172 @@
+// Copyright 2024 Khalil Estell
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "stand_in_device.hpp"
+
+#include <array>
+#include <cerrno>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/wait.h>
+#include <termios.h>
+#include <unistd.h>
+
+#include "device.hpp"
+
+namespace {
+[[noreturn]] void fail(char const* p_what)
+{
+  std::perror(p_what);
+  std::exit(EXIT_FAILURE);
+}
+}  // namespace
+
+stand_in_device::stand_in_device()
+  : m_controller(::posix_openpt(O_RDWR | O_NOCTTY | O_CLOEXEC))
+{
+  if (m_controller < 0 or ::grantpt(m_controller) != 0 or
+      ::unlockpt(m_controller) != 0) {
+    fail("posix_openpt");
+  }
+  m_path = ::ptsname(m_controller);
+
+  m_terminal = ::open(m_path.c_str(), O_RDWR | O_NOCTTY | O_CLOEXEC);
+  if (m_terminal < 0) {
+    fail(m_path.c_str());
+  }
+  // Raw from the start, so nothing the test writes early is translated
+  termios settings{};
+  tcgetattr(m_terminal, &settings);
+  cfmakeraw(&settings);
+  tcsetattr(m_terminal, TCSANOW, &settings);
+}
+
+stand_in_device::~stand_in_device()
+{
+  ::close(m_terminal);
+  ::close(m_controller);
+}
+
+std::optional<std::string> stand_in_device::read_line(
+  std::chrono::milliseconds p_timeout)
+{
+  return ::read_line(m_controller, m_input, p_timeout);
+}
+
+void stand_in_device::write(std::string_view p_bytes)
+{
+  if (not write_all(m_controller, p_bytes)) {
+    fail("write");
+  }
+}
+
+std::optional<std::string> read_line(int p_descriptor,
+                                     line_splitter& p_input,
+                                     std::chrono::milliseconds p_timeout)
+{
+  auto const deadline = std::chrono::steady_clock::now() + p_timeout;
+  while (true) {
+    if (auto line = p_input.next()) {
+      return line;
+    }
+
+    using std::chrono::milliseconds;
+    auto const remaining = std::chrono::duration_cast<milliseconds>(
+      deadline - std::chrono::steady_clock::now());
+    if (remaining.count() <= 0) {
+      return std::nullopt;
+    }
+    pollfd ready{ .fd = p_descriptor, .events = POLLIN, .revents = 0 };
+    if (::poll(&ready, 1, static_cast<int>(remaining.count())) <= 0) {
+      continue;
+    }
+
+    std::array<char, 4096> buffer{};
+    auto const received = ::read(p_descriptor, buffer.data(), buffer.size());
+    if (received == 0 or (received < 0 and errno != EAGAIN and
+                          errno != EINTR)) {
+      return std::nullopt;
+    }
+    if (received > 0) {
+      p_input.append(std::string_view(buffer.data(), received));
+    }
+  }
+}
+
+bool write_all(int p_descriptor, std::string_view p_bytes)
+{
+  while (not p_bytes.empty()) {
+    auto const written = ::write(p_descriptor, p_bytes.data(), p_bytes.size());
+    if (written < 0 and errno == EINTR) {
+      continue;
+    }
+    if (written <= 0) {
+      return false;
+    }
+    p_bytes.remove_prefix(written);
+  }
+  return true;
+}
+
+child_process::child_process(std::vector<std::string> const& p_arguments)
+  : m_pid(::fork())
+{
+  if (m_pid < 0) {
+    fail("fork");
+  }
+  if (m_pid == 0) {
+    std::vector<char*> arguments;
+    for (auto const& argument : p_arguments) {
+      arguments.push_back(const_cast<char*>(argument.c_str()));
+    }
+    arguments.push_back(nullptr);
+    ::execv(arguments[0], arguments.data());
+    std::perror(arguments[0]);
+    ::_exit(127);
+  }
+}
+
+child_process::~child_process()
+{
+  stop();
+}
+
+int child_process::stop()
+{
+  if (m_pid <= 0) {
+    return -1;
+  }
+  ::kill(m_pid, SIGTERM);
+  int status = 0;
+  ::waitpid(m_pid, &status, 0);
+  m_pid = -1;
+  return WIFEXITED(status) ? WEXITSTATUS(status) : -1;
+}
+
+int connect_when_ready(char const* p_path)
+{
+  for (int attempt = 0; attempt < 200; attempt++) {
+    int const socket = open_device(p_path, B115200, false);
+    if (socket >= 0) {
+      return socket;
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+  return -1;
+}
@@ -0,0 +1,124 @@
+// Copyright 2024 Khalil Estell
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <chrono>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <sys/types.h>
+
+#include "slcan_line.hpp"
+
+/**
+ * @brief A pseudo terminal standing in for a Can Opener in the tools' tests
+ *
+ * The tool under test opens path() as its device, the test plays the device
+ * on the other end by reading the commands the tool sends and writing
+ * answers and frames back.
+ */
+class stand_in_device
+{
+public:
+  stand_in_device();
+  ~stand_in_device();
+
+  stand_in_device(stand_in_device const&) = delete;
+  stand_in_device& operator=(stand_in_device const&) = delete;
+
+  /// Path of the terminal the tool opens
+  char const* path() const
+  {
+    return m_path.c_str();
+  }
+
+  /**
+   * @brief Wait for the next line the tool sends
+   *
+   * @param p_timeout - how long to wait
+   * @return std::optional<std::string> - the line without its terminator or
+   * std::nullopt if none arrived in time
+   */
+  std::optional<std::string> read_line(
+    std::chrono::milliseconds p_timeout = std::chrono::seconds(2));
+
+  /// Send bytes to the tool as the device would
+  void write(std::string_view p_bytes);
+
+private:
+  int m_controller;
+  // Held open so the terminal stays usable while the tool reopens it
+  int m_terminal;
+  std::string m_path;
+  line_splitter m_input;
+};
+
+/**
+ * @brief Wait for the next line on a descriptor
+ *
+ * @param p_descriptor - where to read from
+ * @param p_input - splitter holding what was read before
+ * @param p_timeout - how long to wait
+ * @return std::optional<std::string> - the line without its terminator or
+ * std::nullopt if none arrived in time or the descriptor closed
+ */
+std::optional<std::string> read_line(
+  int p_descriptor,
+  line_splitter& p_input,
+  std::chrono::milliseconds p_timeout = std::chrono::seconds(2));
+
+/**
+ * @brief Write all bytes to a descriptor
+ *
+ * @return true - everything was written
+ * @return false - the descriptor broke
+ */
+bool write_all(int p_descriptor, std::string_view p_bytes);
+
+/**
+ * @brief A tool run by a test, stopped with SIGTERM when destroyed
+ */
+class child_process
+{
+public:
+  /**
+   * @param p_arguments - program to run followed by its arguments
+   */
+  explicit child_process(std::vector<std::string> const& p_arguments);
+  ~child_process();
+
+  child_process(child_process const&) = delete;
+  child_process& operator=(child_process const&) = delete;
+
+  /**
+   * @brief Send SIGTERM and wait for the program to exit
+   *
+   * @return int - its exit status, or -1 if it did not exit normally
+   */
+  int stop();
+
+private:
+  pid_t m_pid;
+};
+
+/**
+ * @brief Connect to a socket a tool serves, retrying while it starts up
+ *
+ * @param p_path - socket path
+ * @return int - the connected descriptor or -1 if the tool never listened
+ */
+int connect_when_ready(char const* p_path);
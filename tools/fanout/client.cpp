@@ -0,0 +1,134 @@
+// Copyright 2024 Khalil Estell
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "client.hpp"
+
+#include <array>
+#include <cerrno>
+#include <charconv>
+
+#include <sys/socket.h>
+#include <unistd.h>
+
+client::client(int p_socket, std::size_t p_queue_limit)
+  : m_socket(p_socket)
+  , m_queue_limit(p_queue_limit)
+{
+}
+
+client::~client()
+{
+  ::close(m_socket);
+}
+
+bool client::accepts(std::uint32_t p_key) const
+{
+  if (m_filter_count == 0) {
+    return true;
+  }
+  for (std::size_t i = 0; i < m_filter_count; i++) {
+    auto const& filter = m_filters[i];
+    if (((p_key ^ filter.key) & filter.mask) == 0) {
+      return true;
+    }
+  }
+  return false;
+}
+
+bool client::filter_command(std::string_view p_command)
+{
+  constexpr std::string_view format = "fkkkkkkkkmmmmmmmm";
+
+  if (p_command.size() == 1) {
+    m_filter_count = 0;
+    return true;
+  }
+  if (p_command.size() != format.size() or m_filter_count == max_filters) {
+    return false;
+  }
+
+  auto const parse = [](std::string_view p_hex, std::uint32_t& p_value) {
+    auto const* end = p_hex.data() + p_hex.size();
+    auto const result = std::from_chars(p_hex.data(), end, p_value, 16);
+    return result.ec == std::errc{} and result.ptr == end;
+  };
+
+  key_filter filter{};
+  if (not parse(p_command.substr(1, 8), filter.key) or
+      not parse(p_command.substr(9, 8), filter.mask)) {
+    return false;
+  }
+  m_filters[m_filter_count++] = filter;
+  return true;
+}
+
+bool client::queue(std::string_view p_line)
+{
+  return append(p_line, m_queue_limit);
+}
+
+bool client::answer(std::string_view p_line)
+{
+  return append(p_line, m_queue_limit * 2);
+}
+
+bool client::append(std::string_view p_line, std::size_t p_limit)
+{
+  if (m_sent > 0 and m_sent == m_output.size()) {
+    m_output.clear();
+    m_sent = 0;
+  }
+
+  if (m_output.size() - m_sent + p_line.size() > p_limit) {
+    m_dropped++;
+    return false;
+  }
+  m_output.append(p_line);
+  return true;
+}
+
+bool client::flush()
+{
+  while (pending()) {
+    auto const remaining = m_output.size() - m_sent;
+    auto const written =
+      ::send(m_socket, m_output.data() + m_sent, remaining, MSG_NOSIGNAL);
+    if (written < 0) {
+      return errno == EAGAIN or errno == EWOULDBLOCK or errno == EINTR;
+    }
+    m_sent += static_cast<std::size_t>(written);
+  }
+
+  // Reclaim the written bytes once they outweigh what is left
+  if (m_sent > m_queue_limit / 2) {
+    m_output.erase(0, m_sent);
+    m_sent = 0;
+  }
+  return true;
+}
+
+bool client::receive()
+{
+  std::array<char, 1024> buffer{};
+  while (true) {
+    auto const received = ::recv(m_socket, buffer.data(), buffer.size(), 0);
+    if (received == 0) {
+      return false;
+    }
+    if (received < 0) {
+      return errno == EAGAIN or errno == EWOULDBLOCK or errno == EINTR;
+    }
+    m_input.append(std::string_view(buffer.data(), received));
+  }
+}
@@ -0,0 +1,143 @@
+// Copyright 2024 Khalil Estell
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+#include "slcan_line.hpp"
+
+/**
+ * @brief Frames whose key matches `key` in the bits set in `mask` pass
+ */
+struct key_filter
+{
+  std::uint32_t key = 0;
+  std::uint32_t mask = 0;
+};
+
+/**
+ * @brief One connection to the daemon
+ *
+ * Owns the socket and a bounded queue of lines waiting to be written to it.
+ * Lines that do not fit are dropped and counted, so a client that stops
+ * reading only loses its own frames.
+ */
+class client
+{
+public:
+  static constexpr std::size_t max_filters = 16;
+
+  /**
+   * @param p_socket - connected, non-blocking socket, closed with the client
+   * @param p_queue_limit - most bytes waiting to be written to the socket
+   */
+  client(int p_socket, std::size_t p_queue_limit);
+  ~client();
+
+  client(client const&) = delete;
+  client& operator=(client const&) = delete;
+
+  int socket() const
+  {
+    return m_socket;
+  }
+
+  /// Whether a frame with this key passes the client's filters
+  bool accepts(std::uint32_t p_key) const;
+
+  /**
+   * @brief Handle an `f` command
+   *
+   * `fkkkkkkkkmmmmmmmm` adds a filter, `f` clears them all. With no filters
+   * every frame passes.
+   *
+   * @param p_command - line without its terminator
+   * @return true - the filters were changed
+   * @return false - the command is malformed or there is no room for another
+   * filter
+   */
+  bool filter_command(std::string_view p_command);
+
+  /**
+   * @brief Queue a frame, with its terminator, to be written to the client
+   *
+   * @param p_line - bytes to write
+   * @return true - the frame was queued
+   * @return false - the queue is full and the frame was dropped
+   */
+  bool queue(std::string_view p_line);
+
+  /**
+   * @brief Queue the answer to one of the client's commands
+   *
+   * Answers may use twice the queue limit, so a client that is behind on
+   * frames still learns what happened to its commands.
+   *
+   * @param p_line - bytes to write
+   * @return true - the answer was queued
+   * @return false - the queue is full and the answer was dropped
+   */
+  bool answer(std::string_view p_line);
+
+  /**
+   * @brief Write as much of the queue as the socket takes
+   *
+   * @return true - the connection is still usable
+   * @return false - the connection broke
+   */
+  bool flush();
+
+  /// Whether there are bytes waiting to be written
+  bool pending() const
+  {
+    return m_sent < m_output.size();
+  }
+
+  /**
+   * @brief Read whatever the client sent
+   *
+   * @return true - the connection is still usable
+   * @return false - the client disconnected or the connection broke
+   */
+  bool receive();
+
+  /// Lines received from the client
+  line_splitter& input()
+  {
+    return m_input;
+  }
+
+  /// Frames and answers dropped because the queue was full
+  std::uint32_t dropped() const
+  {
+    return m_dropped;
+  }
+
+private:
+  bool append(std::string_view p_line, std::size_t p_limit);
+
+  int m_socket;
+  std::size_t m_queue_limit;
+  std::string m_output;
+  std::size_t m_sent = 0;
+  std::uint32_t m_dropped = 0;
+  line_splitter m_input;
+  std::array<key_filter, max_filters> m_filters{};
+  std::size_t m_filter_count = 0;
+};
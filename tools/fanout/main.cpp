@@ -0,0 +1,484 @@
+// Copyright 2024 Khalil Estell
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Shares one Can Opener between several programs. The daemon owns the serial
+// port, splits what the device sends into frames once and hands each frame to
+// every connected client whose filters pass it. Clients talk slcan over a Unix
+// stream socket:
+//
+//   t/T/r/R...  transmit a frame, answered by the device's carriage return
+//               or BELL
+//   fkkkkkkkkmmmmmmmm
+//               only receive frames whose key (ID, bit 31 set for extended)
+//               matches kkkkkkkk in the bits set in mmmmmmmm, up to 16
+//   f           receive every frame again
+//   q           report frames dropped for this client as `qnnnnnnnn`
+//
+// Anything else is answered with a BELL. Each client has its own bounded
+// queue, so a client that stops reading only loses its own frames. Frames
+// from firmware built with more than one channel keep their channel digit,
+// and filters match them on every channel. Error events (`e` lines) go to
+// every client, whatever its filters.
+
+#include <array>
+#include <cerrno>
+#include <csignal>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <map>
+#include <memory>
+#include <string>
+#include <string_view>
+
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "client.hpp"
+#include "device.hpp"
+#include "slcan_line.hpp"
+
+namespace {
+struct options
+{
+  char const* device = nullptr;
+  char const* socket_path = "/tmp/can-opener.sock";
+  speed_t baud_rate = B115200;
+  std::string setup = "O\r";
+  std::size_t queue_limit = 64 * 1024;
+};
+
+/// Most bytes of transmit commands waiting for the device
+constexpr std::size_t device_queue_limit = 64 * 1024;
+/// Longest line accepted from a client
+constexpr std::size_t max_command_length = 64;
+
+// epoll tags, clients count up from first_client
+constexpr std::uint64_t listener_tag = 0;
+constexpr std::uint64_t device_tag = 1;
+constexpr std::uint64_t first_client = 2;
+
+volatile std::sig_atomic_t stop_requested = 0;
+
+[[noreturn]] void fail(char const* p_what)
+{
+  std::perror(p_what);
+  std::exit(EXIT_FAILURE);
+}
+
+void usage(char const* p_program)
+{
+  std::fprintf(stderr,
+               "usage: %s [-s socket] [-b baud] [-q queue bytes] "
+               "[-c setup commands] device\n"
+               "  setup commands are separated by commas and sent once the\n"
+               "  device is open, the default is \"O\"\n",
+               p_program);
+  std::exit(EXIT_FAILURE);
+}
+
+options parse_options(int p_argc, char** p_argv)
+{
+  options result{};
+  int option = 0;
+  while ((option = getopt(p_argc, p_argv, "s:b:q:c:")) != -1) {
+    switch (option) {
+      case 's':
+        result.socket_path = optarg;
+        break;
+      case 'b':
+        result.baud_rate = baud_rate_constant(std::atol(optarg));
+        if (result.baud_rate == 0) {
+          usage(p_argv[0]);
+        }
+        break;
+      case 'q':
+        result.queue_limit = std::strtoul(optarg, nullptr, 0);
+        break;
+      case 'c':
+        result.setup = optarg;
+        for (auto& character : result.setup) {
+          if (character == ',') {
+            character = '\r';
+          }
+        }
+        result.setup += '\r';
+        break;
+      default:
+        usage(p_argv[0]);
+    }
+  }
+  if (optind + 1 != p_argc or result.queue_limit < max_command_length) {
+    usage(p_argv[0]);
+  }
+  result.device = p_argv[optind];
+  return result;
+}
+
+int open_listener(char const* p_path)
+{
+  int const listener =
+    ::socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+  if (listener < 0) {
+    fail("socket");
+  }
+
+  sockaddr_un address{};
+  address.sun_family = AF_UNIX;
+  if (std::strlen(p_path) >= sizeof(address.sun_path)) {
+    std::fprintf(stderr, "socket path is too long\n");
+    std::exit(EXIT_FAILURE);
+  }
+  std::strcpy(address.sun_path, p_path);
+
+  // Replace a socket left behind by a daemon that did not shut down cleanly
+  ::unlink(p_path);
+  auto const* generic = reinterpret_cast<sockaddr const*>(&address);
+  if (::bind(listener, generic, sizeof(address)) != 0) {
+    fail(p_path);
+  }
+  if (::listen(listener, 16) != 0) {
+    fail("listen");
+  }
+  return listener;
+}
+
+/**
+ * @brief Everything the daemon juggles
+ */
+class daemon_state
+{
+public:
+  daemon_state(options const& p_options)
+    : m_options(p_options)
+    , m_device(open_device(p_options.device, p_options.baud_rate, true))
+    , m_listener(open_listener(p_options.socket_path))
+    , m_epoll(epoll_create1(EPOLL_CLOEXEC))
+  {
+    if (m_device < 0) {
+      fail(p_options.device);
+    }
+    if (m_epoll < 0) {
+      fail("epoll");
+    }
+    watch(m_listener, listener_tag, EPOLLIN);
+    watch(m_device, device_tag, EPOLLIN);
+
+    // Answers to the setup commands belong to nobody
+    for (auto const character : p_options.setup) {
+      if (character == '\r') {
+        m_answer_owners.push_back(listener_tag);
+      }
+    }
+    m_device_output = p_options.setup;
+    flush_device();
+  }
+
+  ~daemon_state()
+  {
+    m_clients.clear();
+    ::close(m_listener);
+    ::unlink(m_options.socket_path);
+    ::close(m_device);
+    ::close(m_epoll);
+  }
+
+  void run()
+  {
+    std::array<epoll_event, 32> events{};
+    while (not stop_requested) {
+      int const count = epoll_wait(m_epoll, events.data(), events.size(), -1);
+      if (count < 0) {
+        if (errno == EINTR) {
+          continue;
+        }
+        fail("epoll_wait");
+      }
+
+      for (int i = 0; i < count; i++) {
+        auto const tag = events[i].data.u64;
+        auto const flags = events[i].events;
+        if (tag == listener_tag) {
+          accept_clients();
+        } else if (tag == device_tag) {
+          device_ready(flags);
+        } else {
+          client_ready(tag, flags);
+        }
+      }
+    }
+  }
+
+private:
+  void watch(int p_descriptor, std::uint64_t p_tag, std::uint32_t p_events)
+  {
+    epoll_event event{ .events = p_events, .data = { .u64 = p_tag } };
+    if (epoll_ctl(m_epoll, EPOLL_CTL_ADD, p_descriptor, &event) != 0) {
+      fail("epoll_ctl");
+    }
+  }
+
+  void rewatch(int p_descriptor, std::uint64_t p_tag, bool p_writing)
+  {
+    epoll_event event{
+      .events = EPOLLIN | (p_writing ? EPOLLOUT : 0U),
+      .data = { .u64 = p_tag },
+    };
+    epoll_ctl(m_epoll, EPOLL_CTL_MOD, p_descriptor, &event);
+  }
+
+  void accept_clients()
+  {
+    while (true) {
+      int const socket =
+        ::accept4(m_listener, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+      if (socket < 0) {
+        return;
+      }
+      auto const tag = m_next_client++;
+      m_clients.emplace(
+        tag, std::make_unique<client>(socket, m_options.queue_limit));
+      watch(socket, tag, EPOLLIN);
+      std::fprintf(stderr, "client %llu connected\n", as_number(tag));
+    }
+  }
+
+  void disconnect(std::uint64_t p_tag)
+  {
+    auto const found = m_clients.find(p_tag);
+    if (found == m_clients.end()) {
+      return;
+    }
+    std::fprintf(stderr,
+                 "client %llu disconnected, %u frames dropped\n",
+                 as_number(p_tag),
+                 found->second->dropped());
+    epoll_ctl(m_epoll, EPOLL_CTL_DEL, found->second->socket(), nullptr);
+    m_clients.erase(found);
+  }
+
+  void device_ready(std::uint32_t p_flags)
+  {
+    if (p_flags & EPOLLOUT) {
+      flush_device();
+    }
+    if (p_flags & (EPOLLIN | EPOLLHUP | EPOLLERR)) {
+      read_device();
+    }
+  }
+
+  void read_device()
+  {
+    std::array<char, 4096> buffer{};
+    while (true) {
+      auto const received = ::read(m_device, buffer.data(), buffer.size());
+      if (received == 0 or (received < 0 and errno != EAGAIN)) {
+        std::fprintf(stderr, "device closed\n");
+        stop_requested = 1;
+        return;
+      }
+      if (received < 0) {
+        break;
+      }
+      m_device_input.append(std::string_view(buffer.data(), received));
+    }
+
+    while (auto const line = m_device_input.next()) {
+      device_line(*line);
+    }
+    flush_clients();
+  }
+
+  void device_line(std::string_view p_line)
+  {
+    if (auto const key = frame_key(p_line)) {
+      // Frames are parsed once and copied to each client that wants them
+      std::string terminated(p_line);
+      terminated += '\r';
+      for (auto& [tag, connection] : m_clients) {
+        if (connection->accepts(*key)) {
+          connection->queue(terminated);
+        }
+      }
+      return;
+    }
+
+    if (is_error_event(p_line)) {
+      // Error events concern every client and answer no command
+      std::string terminated(p_line);
+      terminated += '\r';
+      for (auto& [tag, connection] : m_clients) {
+        connection->queue(terminated);
+      }
+      return;
+    }
+
+    // Anything else answers the oldest command sent to the device
+    if (m_answer_owners.empty()) {
+      return;
+    }
+    auto const owner = m_answer_owners.front();
+    m_answer_owners.pop_front();
+    if (auto const found = m_clients.find(owner); found != m_clients.end()) {
+      found->second->answer(p_line == "\a" ? std::string(p_line)
+                                          : std::string(p_line) + '\r');
+    }
+  }
+
+  void client_ready(std::uint64_t p_tag, std::uint32_t p_flags)
+  {
+    auto const found = m_clients.find(p_tag);
+    if (found == m_clients.end()) {
+      return;
+    }
+    auto& connection = *found->second;
+
+    if (p_flags & (EPOLLIN | EPOLLHUP | EPOLLERR)) {
+      if (not connection.receive()) {
+        disconnect(p_tag);
+        return;
+      }
+      while (auto const line = connection.input().next()) {
+        client_command(p_tag, connection, *line);
+      }
+      if (connection.input().pending() > max_command_length) {
+        disconnect(p_tag);
+        return;
+      }
+    }
+
+    flush_device();
+    flush_client(p_tag, connection);
+  }
+
+  void client_command(std::uint64_t p_tag,
+                      client& p_connection,
+                      std::string_view p_command)
+  {
+    if (p_command.empty()) {
+      return;
+    }
+
+    if (is_transmit_command(p_command)) {
+      if (m_device_output.size() + p_command.size() >= device_queue_limit) {
+        p_connection.answer("\a");
+        return;
+      }
+      // Whole commands are appended, so commands from different clients
+      // never interleave
+      m_device_output.append(p_command);
+      m_device_output += '\r';
+      m_answer_owners.push_back(p_tag);
+      return;
+    }
+
+    switch (p_command[0]) {
+      case 'f':
+        p_connection.answer(p_connection.filter_command(p_command) ? "\r"
+                                                                   : "\a");
+        return;
+      case 'q':
+        if (p_command.size() == 1) {
+          std::array<char, 16> response{};
+          std::snprintf(response.data(),
+                        response.size(),
+                        "q%08X\r",
+                        p_connection.dropped());
+          p_connection.answer(response.data());
+          return;
+        }
+        break;
+      default:
+        break;
+    }
+    p_connection.answer("\a");
+  }
+
+  void flush_device()
+  {
+    while (not m_device_output.empty()) {
+      auto const written =
+        ::write(m_device, m_device_output.data(), m_device_output.size());
+      if (written <= 0) {
+        break;
+      }
+      m_device_output.erase(0, written);
+    }
+    rewatch(m_device, device_tag, not m_device_output.empty());
+  }
+
+  void flush_client(std::uint64_t p_tag, client& p_connection)
+  {
+    if (not p_connection.flush()) {
+      disconnect(p_tag);
+      return;
+    }
+    rewatch(p_connection.socket(), p_tag, p_connection.pending());
+  }
+
+  void flush_clients()
+  {
+    for (auto it = m_clients.begin(); it != m_clients.end();) {
+      auto const tag = it->first;
+      auto& connection = *it->second;
+      it++;
+      flush_client(tag, connection);
+    }
+  }
+
+  static unsigned long long as_number(std::uint64_t p_tag)
+  {
+    return p_tag - first_client;
+  }
+
+  options m_options;
+  int m_device;
+  int m_listener;
+  int m_epoll;
+  std::uint64_t m_next_client = first_client;
+  std::map<std::uint64_t, std::unique_ptr<client>> m_clients;
+  line_splitter m_device_input;
+  std::string m_device_output;
+  // Who each pending device answer goes to, oldest first
+  std::deque<std::uint64_t> m_answer_owners;
+};
+
+void request_stop(int)
+{
+  stop_requested = 1;
+}
+}  // namespace
+
+int main(int p_argc, char** p_argv)
+{
+  auto const options = parse_options(p_argc, p_argv);
+
+  struct sigaction action{};
+  action.sa_handler = request_stop;
+  sigaction(SIGINT, &action, nullptr);
+  sigaction(SIGTERM, &action, nullptr);
+  std::signal(SIGPIPE, SIG_IGN);
+
+  daemon_state state(options);
+  std::fprintf(stderr,
+               "serving %s on %s\n",
+               options.device,
+               options.socket_path);
+  state.run();
+  return EXIT_SUCCESS;
+}
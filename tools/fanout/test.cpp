@@ -0,0 +1,156 @@
+// Copyright 2024 Khalil Estell
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Runs can-opener-fanout against a pseudo terminal standing in for the
+// device, with two clients connected, and checks that the answer to each
+// command goes back to the client that sent it while frames, with or without
+// a channel digit, go to both. The daemon to run is the only argument.
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <optional>
+#include <string>
+#include <string_view>
+
+#include <unistd.h>
+
+#include "slcan_line.hpp"
+#include "stand_in_device.hpp"
+
+namespace {
+bool passed = true;
+
+void check(bool p_condition, char const* p_what)
+{
+  if (not p_condition) {
+    std::printf("FAILED: %s\n", p_what);
+    passed = false;
+  }
+}
+
+/**
+ * @brief A program sharing the device through the daemon
+ */
+class test_client
+{
+public:
+  explicit test_client(char const* p_socket_path)
+    : m_socket(connect_when_ready(p_socket_path))
+  {
+    if (m_socket < 0) {
+      std::perror(p_socket_path);
+      std::exit(EXIT_FAILURE);
+    }
+  }
+
+  ~test_client()
+  {
+    ::close(m_socket);
+  }
+
+  test_client(test_client const&) = delete;
+  test_client& operator=(test_client const&) = delete;
+
+  void send(std::string_view p_bytes)
+  {
+    write_all(m_socket, p_bytes);
+  }
+
+  std::optional<std::string> read_line(
+    std::chrono::milliseconds p_timeout = std::chrono::seconds(2))
+  {
+    return ::read_line(m_socket, m_input, p_timeout);
+  }
+
+private:
+  int m_socket;
+  line_splitter m_input;
+};
+}  // namespace
+
+int main(int p_argc, char** p_argv)
+{
+  if (p_argc != 2) {
+    std::fprintf(stderr, "usage: %s can-opener-fanout\n", p_argv[0]);
+    return EXIT_FAILURE;
+  }
+
+  stand_in_device device;
+  auto const socket_path =
+    "/tmp/can-opener-fanout-test-" + std::to_string(::getpid()) + ".sock";
+  child_process daemon({ p_argv[1], "-s", socket_path, device.path() });
+
+  check(device.read_line() == "O", "the setup command reaches the device");
+  device.write("\r");
+
+  test_client first(socket_path.c_str());
+  test_client second(socket_path.c_str());
+  // Answered by the daemon itself, so both clients are known to it after
+  for (auto* connection : { &first, &second }) {
+    connection->send("q\r");
+    check(connection->read_line() == "q00000000", "clients are accepted");
+  }
+
+  // Both clients' commands are waiting for the device when it answers
+  first.send("t1230\r");
+  check(device.read_line() == "t1230", "the first command reaches the device");
+  second.send("t4561FF\r");
+  check(device.read_line() == "t4561FF",
+        "the second command reaches the device");
+  // The first command fails and a frame arrives between the answers
+  device.write("\at7772AABB\r\r");
+
+  check(first.read_line() == "\a", "the first client gets its own answer");
+  check(first.read_line() == "t7772AABB", "the first client gets the frame");
+  check(second.read_line() == "t7772AABB", "the second client gets the frame");
+  check(second.read_line() == "", "the second client gets its own answer");
+
+  // Firmware with several channels tags each frame with its channel digit,
+  // which makes it no less a frame
+  first.send("t1230\r");
+  check(device.read_line() == "t1230", "the command reaches the device");
+  device.write("1t7772AABB\r\r");
+  check(first.read_line() == "1t7772AABB",
+        "the first client gets the tagged frame");
+  check(first.read_line() == "",
+        "the answer is not taken by the tagged frame");
+  check(second.read_line() == "1t7772AABB",
+        "the second client gets the tagged frame");
+  // Transmit commands go to the channel selected with 'J' instead
+  second.send("1t1230\r");
+  check(second.read_line() == "\a", "tagged transmit commands are refused");
+
+  // Error events reach every client, past filters, and answer no command
+  second.send("f00000999000007FF\r");
+  check(second.read_line() == "", "the filter is added");
+  first.send("t1230\r");
+  check(device.read_line() == "t1230", "the command reaches the device");
+  device.write("e2800000000003\r1e30000000100011234\r\r");
+  for (auto* connection : { &first, &second }) {
+    check(connection->read_line() == "e2800000000003",
+          "error events reach every client");
+    check(connection->read_line() == "1e30000000100011234",
+          "tagged error events with timestamps reach every client");
+  }
+  check(first.read_line() == "", "the answer is not taken by error events");
+
+  constexpr auto quiet = std::chrono::milliseconds(100);
+  check(not first.read_line(quiet) and not second.read_line(quiet),
+        "nothing is delivered twice");
+
+  check(daemon.stop() == EXIT_SUCCESS, "the daemon shuts down cleanly");
+  std::printf("%s\n", passed ? "passed" : "failed");
+  return passed ? EXIT_SUCCESS : EXIT_FAILURE;
+}
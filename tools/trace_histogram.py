@@ -0,0 +1,149 @@
+#!/usr/bin/env python3
+# Copyright 2024 Khalil Estell
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#      http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+
+"""Turn an 'H' trace dump into per stage latency histograms.
+
+The dump is read from a file holding the raw response to 'H', or fetched
+directly from the device with --port (requires pyserial). Firmware must be
+built with the `trace` option for 'H' to be accepted.
+"""
+
+import argparse
+import struct
+import sys
+from collections import defaultdict
+
+STAGES = [
+    "interrupt entry",
+    "interrupt exit",
+    "dequeued",
+    "encoded",
+    "console queued",
+    "console written",
+]
+
+HEADER_SIZE = 17
+EVENT_SIZE = 8
+
+
+def parse_dump(data):
+    start = data.find(b"H")
+    if start < 0 or len(data) < start + HEADER_SIZE:
+        raise ValueError("no trace dump header found")
+
+    header = data[start:start + HEADER_SIZE].decode("ascii")
+    interrupt_count = int(header[1:5], 16)
+    loop_count = int(header[5:9], 16)
+    frequency = int(header[9:17], 16)
+
+    body = data[start + HEADER_SIZE:]
+    total = interrupt_count + loop_count
+    if len(body) < total * EVENT_SIZE:
+        raise ValueError("trace dump is truncated")
+
+    events = []
+    for i in range(total):
+        ticks, frame, stage, _ = struct.unpack_from(
+            "<IHBB", body, i * EVENT_SIZE)
+        events.append((ticks, frame, stage))
+    return frequency, events
+
+
+def stage_latencies(frequency, events):
+    # Keep the latest time each frame reached each stage
+    frames = defaultdict(dict)
+    for ticks, frame, stage in events:
+        frames[frame][stage] = ticks
+
+    latencies = defaultdict(list)
+    for stages in frames.values():
+        reached = sorted(stages)
+        for before, after in zip(reached, reached[1:]):
+            if after != before + 1:
+                continue
+            ticks = (stages[after] - stages[before]) & 0xFFFFFFFF
+            latencies[(before, after)].append(ticks * 1e6 / frequency)
+        first, last = reached[0], reached[-1]
+        if first == 0 and last == len(STAGES) - 1:
+            ticks = (stages[last] - stages[first]) & 0xFFFFFFFF
+            latencies[(first, last)].append(ticks * 1e6 / frequency)
+    return latencies
+
+
+def print_histogram(name, samples):
+    samples = sorted(samples)
+    count = len(samples)
+    print(f"{name}: {count} frames, min {samples[0]:.1f} us, "
+          f"median {samples[count // 2]:.1f} us, "
+          f"p99 {samples[min(count - 1, (count * 99) // 100)]:.1f} us, "
+          f"max {samples[-1]:.1f} us")
+
+    # Power of two buckets in microseconds
+    buckets = defaultdict(int)
+    for sample in samples:
+        bucket = 1
+        while bucket < sample:
+            bucket *= 2
+        buckets[bucket] += 1
+
+    widest = max(buckets.values())
+    for bucket in sorted(buckets):
+        bar = "#" * max(1, (buckets[bucket] * 50) // widest)
+        print(f"  <= {bucket:>8} us {buckets[bucket]:>6} {bar}")
+    print()
+
+
+def read_from_port(port, baud_rate):
+    import serial
+
+    with serial.Serial(port, baud_rate, timeout=1) as device:
+        device.reset_input_buffer()
+        device.write(b"H\r")
+        header = device.read_until(b"H")[-1:] + device.read(HEADER_SIZE - 1)
+        if len(header) != HEADER_SIZE:
+            raise ValueError("device did not answer 'H', is tracing enabled?")
+        total = int(header[1:5], 16) + int(header[5:9], 16)
+        return header + device.read(total * EVENT_SIZE)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__)
+    source = parser.add_mutually_exclusive_group(required=True)
+    source.add_argument("dump", nargs="?", help="file holding an 'H' dump")
+    source.add_argument("--port", help="serial port of the device")
+    parser.add_argument("--baud-rate", type=int, default=115200)
+    args = parser.parse_args()
+
+    if args.port:
+        data = read_from_port(args.port, args.baud_rate)
+    else:
+        with open(args.dump, "rb") as dump:
+            data = dump.read()
+
+    frequency, events = parse_dump(data)
+    latencies = stage_latencies(frequency, events)
+    if not latencies:
+        print("no complete stage pairs in the dump", file=sys.stderr)
+        return 1
+
+    # Stage to stage first, then end to end
+    for before, after in sorted(latencies, key=lambda k: (k[1] - k[0], k)):
+        print_histogram(f"{STAGES[before]} -> {STAGES[after]}",
+                        latencies[(before, after)])
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())